@@ -0,0 +1,335 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ *
+ * Large topology benchmark for the datapath callback dispatch.
+ * Two hosts connected by a chain of OpenFlow switches (5000 by default), all
+ * managed by the same controller over dedicated point-to-point channels. The
+ * controller installs the rules forwarding packets along the chain, and once
+ * all switches are ready, host 0 sends UDP packets to host 1. The wall-clock
+ * time to set up the network and the time per packet and per switch hop are
+ * reported.
+ *
+ *                          Benchmark Controller
+ *                                   |
+ *                +----------+             +------------+
+ *     Host 0 === | Switch 0 | === ... === | Switch N-1 | === Host 1
+ *                +----------+             +------------+
+ *
+ * Every packet crosses all switches, so the per hop time includes the
+ * library callbacks dispatched to the device of each switch in the chain.
+ *
+ * The resident memory growth per switch (read from /proc/self/status, so only
+ * on Linux) is also reported when the switches are installed, and when their
+ * flow tables are ready. It includes the switch node, its CSMA ports and its
+ * OpenFlow channel. The per-device timer wheel and buffer ring are only
+ * allocated when used, so, by default, no switch allocates them. With the
+ * --timeouts option, the forwarding rules are installed with a hard timeout
+ * and every switch allocates its timer wheel, just like all of them did
+ * before the lazy allocation. The difference between the two runs at the
+ * ready time is the memory saved per switch by the lazy timer wheel.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/csma-module.h>
+#include <ns3/internet-module.h>
+#include <ns3/ofswitch13-module.h>
+
+using namespace ns3;
+
+/** Controller installing the forwarding rules along the switch chain. */
+class BenchmarkController : public OFSwitch13Controller
+{
+public:
+  /**
+   * Constructor.
+   * \param timeouts Install the forwarding rules with a hard timeout.
+   */
+  BenchmarkController (bool timeouts);
+
+protected:
+  // Inherited from OFSwitch13Controller
+  void HandshakeSuccessful (Ptr<const RemoteSwitch> swtch);
+
+private:
+  bool m_timeouts;  //!< Install rules with a hard timeout.
+};
+
+/**
+ * Get the resident memory of this process.
+ * \return The resident memory (KiB), or 0 when it's not available.
+ */
+uint64_t GetResidentMemory (void);
+
+/** The benchmark run for a chain of switches. */
+class BenchmarkRun
+{
+public:
+  BenchmarkRun (uint32_t switches, uint32_t packets, bool timeouts);
+
+  /**
+   * Run the simulation and print the wall-clock times.
+   * \param simTime The maximum simulation time.
+   */
+  void Run (Time simTime);
+
+private:
+  void CheckTables (void);
+  void SendPacket (void);
+  void ReceivePacket (Ptr<Socket> socket);
+
+  typedef std::chrono::steady_clock Clock_t;
+
+  uint32_t                  m_switches;
+  uint32_t                  m_packets;
+  uint32_t                  m_sent;
+  uint32_t                  m_received;
+  bool                      m_timeouts;
+  uint64_t                  m_memStart;
+  uint64_t                  m_memInstalled;
+  uint64_t                  m_memReady;
+  OFSwitch13DeviceContainer m_devices;
+  Ptr<Socket>               m_txSocket;
+  Ptr<Socket>               m_rxSocket;
+  Clock_t::time_point       m_start;
+  Clock_t::time_point       m_ready;
+  Clock_t::time_point       m_firstRx;
+  Clock_t::time_point       m_lastRx;
+};
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t switches = 5000;
+  uint32_t packets = 100;
+  uint16_t simTime = 100;
+  bool timeouts = false;
+
+  // Configure command line parameters
+  CommandLine cmd;
+  cmd.AddValue ("switches", "Number of switches in the chain", switches);
+  cmd.AddValue ("packets", "Number of packets sent by host 0", packets);
+  cmd.AddValue ("simTime", "Maximum simulation time (seconds)", simTime);
+  cmd.AddValue ("timeouts", "Install rules with a hard timeout", timeouts);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (switches == 0, "At least one switch is required.");
+
+  // Enable checksum computations (required by OFSwitch13 module)
+  GlobalValue::Bind ("ChecksumEnabled", BooleanValue (true));
+
+  BenchmarkRun run (switches, packets, timeouts);
+  run.Run (Seconds (simTime));
+}
+
+uint64_t
+GetResidentMemory (void)
+{
+  std::ifstream status ("/proc/self/status");
+  std::string field;
+  while (status >> field)
+    {
+      if (field == "VmRSS:")
+        {
+          uint64_t kib = 0;
+          status >> kib;
+          return kib;
+        }
+      status.ignore (256, '\n');
+    }
+  return 0;
+}
+
+BenchmarkController::BenchmarkController (bool timeouts)
+  : m_timeouts (timeouts)
+{
+}
+
+void
+BenchmarkController::HandshakeSuccessful (Ptr<const RemoteSwitch> swtch)
+{
+  // Port 1 connects the switch to the previous node in the chain, and port 2
+  // to the next one. The hard timeout is longer than any simulation.
+  std::string cmd = m_timeouts ?
+    "flow-mod cmd=add,table=0,hard=3600,prio=1 " :
+    "flow-mod cmd=add,table=0,prio=1 ";
+  DpctlExecute (swtch, cmd + "in_port=1 write:output=2");
+  DpctlExecute (swtch, cmd + "in_port=2 write:output=1");
+}
+
+BenchmarkRun::BenchmarkRun (uint32_t switches, uint32_t packets,
+                            bool timeouts)
+  : m_switches (switches),
+  m_packets (packets),
+  m_sent (0),
+  m_received (0),
+  m_timeouts (timeouts),
+  m_memStart (0),
+  m_memInstalled (0),
+  m_memReady (0)
+{
+}
+
+void
+BenchmarkRun::Run (Time simTime)
+{
+  m_start = Clock_t::now ();
+  m_memStart = GetResidentMemory ();
+
+  // Create two host nodes and the switch nodes
+  NodeContainer hosts;
+  hosts.Create (2);
+  NodeContainer switchNodes;
+  switchNodes.Create (m_switches);
+
+  // Use the CsmaHelper to connect the nodes along the chain
+  CsmaHelper csmaHelper;
+  csmaHelper.SetChannelAttribute ("DataRate", DataRateValue (DataRate ("1Gbps")));
+  std::vector<NetDeviceContainer> switchPorts (m_switches);
+  NetDeviceContainer hostDevices;
+  NetDeviceContainer link;
+  link = csmaHelper.Install (NodeContainer (hosts.Get (0), switchNodes.Get (0)));
+  hostDevices.Add (link.Get (0));
+  switchPorts [0].Add (link.Get (1));
+  for (uint32_t i = 1; i < m_switches; i++)
+    {
+      NodeContainer pair (switchNodes.Get (i - 1), switchNodes.Get (i));
+      link = csmaHelper.Install (pair);
+      switchPorts [i - 1].Add (link.Get (0));
+      switchPorts [i].Add (link.Get (1));
+    }
+  link = csmaHelper.Install (
+      NodeContainer (switchNodes.Get (m_switches - 1), hosts.Get (1)));
+  switchPorts [m_switches - 1].Add (link.Get (0));
+  hostDevices.Add (link.Get (1));
+
+  // Configure the OpenFlow network domain
+  Ptr<Node> controllerNode = CreateObject<Node> ();
+  Ptr<OFSwitch13InternalHelper> of13Helper = CreateObject<OFSwitch13InternalHelper> ();
+  of13Helper->SetChannelType (OFSwitch13Helper::DEDICATEDP2P);
+  of13Helper->SetDeviceAttribute ("PipelineTables", UintegerValue (1));
+  of13Helper->InstallController (
+    controllerNode, CreateObject<BenchmarkController> (m_timeouts));
+  for (uint32_t i = 0; i < m_switches; i++)
+    {
+      m_devices.Add (
+        of13Helper->InstallSwitch (switchNodes.Get (i), switchPorts [i]));
+    }
+  of13Helper->CreateOpenFlowChannels ();
+  m_memInstalled = GetResidentMemory ();
+
+  // Install the TCP/IP stack into hosts nodes
+  InternetStackHelper internet;
+  internet.Install (hosts);
+  Ipv4AddressHelper ipv4helpr;
+  ipv4helpr.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer hostIpIfaces = ipv4helpr.Assign (hostDevices);
+
+  // UDP sockets between hosts
+  TypeId udpFactory = UdpSocketFactory::GetTypeId ();
+  m_rxSocket = Socket::CreateSocket (hosts.Get (1), udpFactory);
+  m_rxSocket->Bind (InetSocketAddress (Ipv4Address::GetAny (), 9));
+  m_rxSocket->SetRecvCallback (MakeCallback (&BenchmarkRun::ReceivePacket, this));
+  m_txSocket = Socket::CreateSocket (hosts.Get (0), udpFactory);
+  m_txSocket->Connect (InetSocketAddress (hostIpIfaces.GetAddress (1), 9));
+
+  // Run the simulation
+  Simulator::Schedule (MilliSeconds (100), &BenchmarkRun::CheckTables, this);
+  Simulator::Stop (simTime);
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  std::chrono::duration<double> setup = m_ready - m_start;
+  std::chrono::duration<double, std::micro> elapsed = m_lastRx - m_firstRx;
+  std::cout << "Switches:          " << m_switches << std::endl;
+  std::cout << std::fixed << std::setprecision (3);
+  if (m_received < m_packets + 1)
+    {
+      std::cout << "Received packets:  " << m_received << " (incomplete)"
+                << std::endl;
+      return;
+    }
+  std::cout << "Setup time (s):    " << setup.count () << std::endl;
+  std::cout << "Time/packet (us):  " << elapsed.count () / m_packets
+            << std::endl;
+  std::cout << "Time/hop (us):     "
+            << elapsed.count () / m_packets / m_switches << std::endl;
+  if (m_memStart)
+    {
+      std::cout << "Memory/switch (KiB) when installed: "
+                << static_cast<double> (m_memInstalled - m_memStart) / m_switches
+                << std::endl;
+      std::cout << "Memory/switch (KiB) when ready:     "
+                << static_cast<double> (m_memReady - m_memStart) / m_switches
+                << std::endl;
+    }
+}
+
+void
+BenchmarkRun::CheckTables (void)
+{
+  for (auto it = m_devices.Begin (); it != m_devices.End (); ++it)
+    {
+      if ((*it)->GetFlowTableEntries (0) < 2)
+        {
+          Simulator::Schedule (MilliSeconds (100),
+                               &BenchmarkRun::CheckTables, this);
+          return;
+        }
+    }
+
+  // A warm-up packet resolves the host addresses, so it's not measured.
+  m_ready = Clock_t::now ();
+  m_memReady = GetResidentMemory ();
+  m_txSocket->Send (Create<Packet> (64));
+  Simulator::Schedule (MilliSeconds (10), &BenchmarkRun::SendPacket, this);
+}
+
+void
+BenchmarkRun::SendPacket (void)
+{
+  m_txSocket->Send (Create<Packet> (64));
+  if (++m_sent < m_packets)
+    {
+      Simulator::Schedule (MicroSeconds (10), &BenchmarkRun::SendPacket, this);
+    }
+}
+
+void
+BenchmarkRun::ReceivePacket (Ptr<Socket> socket)
+{
+  // The measurement starts when the warm-up packet is received.
+  while (socket->Recv ())
+    {
+      m_lastRx = Clock_t::now ();
+      if (m_received++ == 0)
+        {
+          m_firstRx = m_lastRx;
+        }
+    }
+  if (m_received == m_packets + 1)
+    {
+      Simulator::Stop ();
+    }
+}
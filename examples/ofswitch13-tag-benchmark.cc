@@ -0,0 +1,334 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ *
+ * Packet tag handling benchmark for packets modified by the switch.
+ * Two hosts connected to a single OpenFlow switch. The controller installs a
+ * rule pushing a VLAN header into the IPv4 packets from host 0 to host 1, so
+ * every packet is modified by the pipeline and the switch must keep its tags
+ * on the packet sent to host 1. Host 0 sends UDP packets carrying 0, 3, and 10
+ * byte tags, and the wall-clock time per packet is measured for each case.
+ *
+ *                      Benchmark Controller
+ *                                |
+ *                       +-----------------+
+ *            Host 0 === | OpenFlow switch | === Host 1
+ *                       +-----------------+
+ *
+ * Host 1 discards the VLAN tagged packets, which are counted at its device.
+ * The time per packet also includes the simulation of hosts and links, so the
+ * difference among the cases gives the cost of the packet tags.
+ *
+ * The tag copy itself is also measured out of the simulation, by copying the
+ * tags of a packet with 0, 3, and 10 byte tags into new packets with the
+ * OFSwitch13Device::CopyTags () function (using cached tag instances), and
+ * with a copy creating a tag object for each tag through its TypeId
+ * constructor, for comparison.
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/csma-module.h>
+#include <ns3/internet-module.h>
+#include <ns3/ofswitch13-module.h>
+
+using namespace ns3;
+
+/** Controller installing the VLAN push rule for the benchmark. */
+class BenchmarkController : public OFSwitch13Controller
+{
+protected:
+  // Inherited from OFSwitch13Controller
+  void HandshakeSuccessful (Ptr<const RemoteSwitch> swtch);
+};
+
+/**
+ * Copy all tags from srcPkt to dstPkt creating a tag object for each tag.
+ * \param srcPkt The source packet.
+ * \param dstPkt The destination packet.
+ */
+void
+CopyTagsConstructed (Ptr<const Packet> srcPkt, Ptr<const Packet> dstPkt)
+{
+  PacketTagIterator pktIt = srcPkt->GetPacketTagIterator ();
+  while (pktIt.HasNext ())
+    {
+      PacketTagIterator::Item item = pktIt.Next ();
+      Callback<ObjectBase *> constructor = item.GetTypeId ().GetConstructor ();
+      Tag *tag = dynamic_cast<Tag *> (constructor ());
+      item.GetTag (*tag);
+      dstPkt->AddPacketTag (*tag);
+      delete tag;
+    }
+
+  ByteTagIterator bytIt = srcPkt->GetByteTagIterator ();
+  while (bytIt.HasNext ())
+    {
+      ByteTagIterator::Item item = bytIt.Next ();
+      Callback<ObjectBase *> constructor = item.GetTypeId ().GetConstructor ();
+      Tag *tag = dynamic_cast<Tag *> (constructor ());
+      item.GetTag (*tag);
+      dstPkt->AddByteTag (*tag);
+      delete tag;
+    }
+}
+
+/**
+ * Measure the wall-clock time to copy the tags of a packet.
+ * \param tags The number of byte tags in the packet.
+ * \param copies The number of copies.
+ * \param cached Use the CopyTags () function with cached tag instances.
+ * \return The time per copy (in nanoseconds).
+ */
+double
+MeasureCopyTags (uint32_t tags, uint32_t copies, bool cached)
+{
+  typedef std::chrono::steady_clock Clock_t;
+
+  Ptr<Packet> srcPkt = Create<Packet> (64);
+  for (uint32_t i = 0; i < tags; i++)
+    {
+      srcPkt->AddByteTag (FlowIdTag (i));
+    }
+
+  // The destination packets are created in advance, so only the tag copy is
+  // measured.
+  std::vector<Ptr<Packet> > dstPkts (copies);
+  for (auto &dstPkt : dstPkts)
+    {
+      dstPkt = Create<Packet> (64);
+    }
+
+  Clock_t::time_point start = Clock_t::now ();
+  for (auto const &dstPkt : dstPkts)
+    {
+      if (cached)
+        {
+          OFSwitch13Device::CopyTags (srcPkt, dstPkt);
+        }
+      else
+        {
+          CopyTagsConstructed (srcPkt, dstPkt);
+        }
+    }
+  std::chrono::duration<double, std::nano> elapsed = Clock_t::now () - start;
+  return elapsed.count () / copies;
+}
+
+/** A benchmark run for a number of tags per packet. */
+class BenchmarkRun
+{
+public:
+  BenchmarkRun (uint32_t tags, uint32_t packets);
+
+  /**
+   * Run the simulation and get the wall-clock time per packet.
+   * \return The time per packet (in microseconds), or a negative value when
+   *         not all packets were received.
+   */
+  double Run (Time simTime);
+
+private:
+  void SendWarmUp (void);
+  void SendPacket (void);
+  void ReceivePacket (Ptr<const Packet> packet);
+
+  typedef std::chrono::steady_clock Clock_t;
+
+  uint32_t                m_tags;
+  uint32_t                m_packets;
+  uint32_t                m_sent;
+  uint32_t                m_received;
+  Ptr<Socket>             m_txSocket;
+  Clock_t::time_point     m_firstRx;
+  Clock_t::time_point     m_lastRx;
+};
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t packets = 100000;
+  uint32_t copies = 100000;
+  uint16_t simTime = 100;
+
+  // Configure command line parameters
+  CommandLine cmd;
+  cmd.AddValue ("packets", "Number of packets sent by host 0", packets);
+  cmd.AddValue ("copies", "Number of tag copies for each case", copies);
+  cmd.AddValue ("simTime", "Maximum simulation time (seconds)", simTime);
+  cmd.Parse (argc, argv);
+
+  // Enable checksum computations (required by OFSwitch13 module)
+  GlobalValue::Bind ("ChecksumEnabled", BooleanValue (true));
+
+  std::cout << std::setw (10) << "Tags" << std::setw (16) << "us/packet"
+            << std::endl;
+
+  uint32_t tags [] = {0, 3, 10};
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      BenchmarkRun run (tags [i], packets);
+      double usPerPacket = run.Run (Seconds (simTime));
+      std::cout << std::setw (10) << tags [i]
+                << std::setw (16) << std::fixed << std::setprecision (3);
+      if (usPerPacket < 0)
+        {
+          std::cout << "incomplete" << std::endl;
+          continue;
+        }
+      std::cout << usPerPacket << std::endl;
+    }
+
+  std::cout << std::endl << std::setw (10) << "Tags"
+            << std::setw (16) << "ns/copy"
+            << std::setw (20) << "ns/copy (no cache)" << std::endl;
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      double cached = MeasureCopyTags (tags [i], copies, true);
+      double constructed = MeasureCopyTags (tags [i], copies, false);
+      std::cout << std::setw (10) << tags [i]
+                << std::setw (16) << std::fixed << std::setprecision (1)
+                << cached << std::setw (20) << constructed << std::endl;
+    }
+}
+
+void
+BenchmarkController::HandshakeSuccessful (Ptr<const RemoteSwitch> swtch)
+{
+  // Forwarding rules between hosts 0 and 1 (ports 1 and 2), pushing a VLAN
+  // header into IPv4 packets from host 0.
+  DpctlExecute (swtch, "flow-mod cmd=add,table=0,prio=1 in_port=1 write:output=2");
+  DpctlExecute (swtch, "flow-mod cmd=add,table=0,prio=1 in_port=2 write:output=1");
+  DpctlExecute (swtch, "flow-mod cmd=add,table=0,prio=2 in_port=1,eth_type=0x800 "
+                "apply:push_vlan=0x8100,output=2");
+}
+
+BenchmarkRun::BenchmarkRun (uint32_t tags, uint32_t packets)
+  : m_tags (tags),
+  m_packets (packets),
+  m_sent (0),
+  m_received (0)
+{
+}
+
+double
+BenchmarkRun::Run (Time simTime)
+{
+  // Create two host nodes and the switch node
+  NodeContainer hosts;
+  hosts.Create (2);
+  Ptr<Node> switchNode = CreateObject<Node> ();
+
+  // Use the CsmaHelper to connect host nodes to the switch node
+  CsmaHelper csmaHelper;
+  csmaHelper.SetChannelAttribute ("DataRate", DataRateValue (DataRate ("1Gbps")));
+  NetDeviceContainer hostDevices;
+  NetDeviceContainer switchPorts;
+  for (size_t i = 0; i < hosts.GetN (); i++)
+    {
+      NodeContainer pair (hosts.Get (i), switchNode);
+      NetDeviceContainer link = csmaHelper.Install (pair);
+      hostDevices.Add (link.Get (0));
+      switchPorts.Add (link.Get (1));
+    }
+
+  // Configure the OpenFlow network domain
+  Ptr<Node> controllerNode = CreateObject<Node> ();
+  Ptr<OFSwitch13InternalHelper> of13Helper = CreateObject<OFSwitch13InternalHelper> ();
+  of13Helper->InstallController (controllerNode,
+                                 CreateObject<BenchmarkController> ());
+  of13Helper->InstallSwitch (switchNode, switchPorts);
+  of13Helper->CreateOpenFlowChannels ();
+
+  // Install the TCP/IP stack into hosts nodes
+  InternetStackHelper internet;
+  internet.Install (hosts);
+  Ipv4AddressHelper ipv4helpr;
+  ipv4helpr.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer hostIpIfaces = ipv4helpr.Assign (hostDevices);
+
+  // UDP socket from host 0, and the packets received by host 1 device
+  m_txSocket = Socket::CreateSocket (hosts.Get (0),
+                                     UdpSocketFactory::GetTypeId ());
+  m_txSocket->Connect (InetSocketAddress (hostIpIfaces.GetAddress (1), 9));
+  hostDevices.Get (1)->TraceConnectWithoutContext (
+    "MacRx", MakeCallback (&BenchmarkRun::ReceivePacket, this));
+
+  // Run the simulation
+  Simulator::Schedule (Seconds (1), &BenchmarkRun::SendWarmUp, this);
+  Simulator::Stop (simTime);
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  m_txSocket = 0;
+  if (m_received < m_packets + 1)
+    {
+      return -1.0;
+    }
+  std::chrono::duration<double, std::micro> elapsed = m_lastRx - m_firstRx;
+  return elapsed.count () / m_packets;
+}
+
+void
+BenchmarkRun::SendWarmUp (void)
+{
+  // A warm-up packet resolves the host addresses, so it's not measured.
+  m_txSocket->Send (Create<Packet> (64));
+  Simulator::Schedule (MilliSeconds (10), &BenchmarkRun::SendPacket, this);
+}
+
+void
+BenchmarkRun::SendPacket (void)
+{
+  Ptr<Packet> packet = Create<Packet> (64);
+  for (uint32_t i = 0; i < m_tags; i++)
+    {
+      packet->AddByteTag (FlowIdTag (i));
+    }
+  m_txSocket->Send (packet);
+  if (++m_sent < m_packets)
+    {
+      Simulator::Schedule (MicroSeconds (10), &BenchmarkRun::SendPacket, this);
+    }
+}
+
+void
+BenchmarkRun::ReceivePacket (Ptr<const Packet> packet)
+{
+  // Only the VLAN tagged IPv4 packets are counted (not the ARP packets). The
+  // measurement starts when the warm-up packet is received.
+  EthernetHeader header;
+  packet->PeekHeader (header);
+  if (header.GetLengthType () != 0x8100)
+    {
+      return;
+    }
+  m_lastRx = Clock_t::now ();
+  if (m_received++ == 0)
+    {
+      m_firstRx = m_lastRx;
+    }
+  if (m_received == m_packets + 1)
+    {
+      Simulator::Stop ();
+    }
+}
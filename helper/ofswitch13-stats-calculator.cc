@@ -21,6 +21,8 @@
 #include <ns3/simulator.h>
 #include <ns3/log.h>
 #include <ns3/config.h>
+#include <algorithm>
+#include <cmath>
 #include <iomanip>
 #include <iostream>
 #include <numeric>
@@ -37,6 +39,7 @@ OFSwitch13StatsCalculator::OFSwitch13StatsCalculator ()
   : m_device (0),
   m_wrapper (0),
   m_lastUpdate (Simulator::Now ()),
+  m_lastSample (Simulator::Now ()),
   m_ewmaBufferEntries (0.0),
   m_ewmaCpuLoad (0.0),
   m_ewmaGroupEntries (0.0),
@@ -158,6 +161,7 @@ OFSwitch13StatsCalculator::HookSinks (Ptr<OFSwitch13Device> device)
       Ptr<OFSwitch13StatsCalculator> (this)));
 
   m_ewmaFlowEntries.resize (device->GetNPipelineTables (), 0.0);
+  m_ewmaFlowUsage.resize (device->GetNPipelineTables (), 0.0);
 }
 
 uint32_t
@@ -228,13 +232,9 @@ OFSwitch13StatsCalculator::GetAvgCpuUsage (void) const
 uint32_t
 OFSwitch13StatsCalculator::GetAvgFlowTableUsage (uint8_t tableId) const
 {
-  if (m_device->GetFlowTableSize (tableId) == 0)
-    {
-      return 0;
-    }
-  return std::round (
-    static_cast<double> (GetEwmaFlowTableEntries (tableId)) * 100 /
-    static_cast<double> (m_device->GetFlowTableSize (tableId)));
+  // The device usage reflects the TCAM slices used by flow entries when the
+  // flow table has a slice budget.
+  return std::round (m_ewmaFlowUsage.at (tableId) * 100);
 }
 
 uint32_t
@@ -262,12 +262,21 @@ OFSwitch13StatsCalculator::GetAvgMeterTableUsage (void) const
 uint32_t
 OFSwitch13StatsCalculator::GetAvgActFlowTableUsage (void) const
 {
+  // Average usage of active tables, weighted by their capacity (in TCAM
+  // slices when the flow table has a slice budget, in entries otherwise).
+  double sumUsed = 0;
   uint32_t sumSize = 0;
   for (size_t i = 0; i < m_device->GetNPipelineTables (); i++)
     {
       if (m_device->GetFlowTableEntries (i))
         {
-          sumSize += m_device->GetFlowTableSize (i);
+          uint32_t size = m_device->GetFlowTableSlices (i);
+          if (size == 0)
+            {
+              size = m_device->GetFlowTableSize (i);
+            }
+          sumUsed += m_ewmaFlowUsage.at (i) * size;
+          sumSize += size;
         }
     }
 
@@ -275,8 +284,7 @@ OFSwitch13StatsCalculator::GetAvgActFlowTableUsage (void) const
     {
       return 0;
     }
-  return std::round (static_cast<double> (GetEwmaSumFlowEntries ()) * 100 /
-                     static_cast<double> (sumSize));
+  return std::round (sumUsed * 100 / static_cast<double> (sumSize));
 }
 
 void
@@ -311,23 +319,43 @@ OFSwitch13StatsCalculator::NotifyDatapathTimeout (
   NS_LOG_FUNCTION (this);
 
   NS_ASSERT_MSG (m_device == device, "Invalid device pointer.");
-  m_ewmaBufferEntries = m_alpha * m_device->GetBufferEntries ()
-    + (1 - m_alpha) * m_ewmaBufferEntries;
+
+  // Devices without pending work are not visited on datapath timeouts. The
+  // skipped samples had no CPU load and the same table entries (as any table
+  // change wakes the device up), so they are accounted here with the
+  // current values, before the CPU load sample.
+  double skipped = 0;
+  Time interval = m_device->GetDatapathTimeout ();
+  if (interval.IsStrictlyPositive ())
+    {
+      double samples = (Simulator::Now () - m_lastSample).GetSeconds ()
+        / interval.GetSeconds ();
+      skipped = std::max (0.0, std::round (samples) - 1);
+    }
+  m_lastSample = Simulator::Now ();
+  double keep = std::pow (1 - m_alpha, skipped + 1);
+
+  m_ewmaBufferEntries = m_device->GetBufferEntries ()
+    + (m_ewmaBufferEntries - m_device->GetBufferEntries ()) * keep;
   m_ewmaCpuLoad = m_alpha * m_device->GetCpuLoad ().GetBitRate ()
-    + (1 - m_alpha) * m_ewmaCpuLoad;
-  m_ewmaSumFlowEntries = m_alpha * m_device->GetSumFlowEntries ()
-    + (1 - m_alpha) * m_ewmaSumFlowEntries;
-  m_ewmaGroupEntries = m_alpha * m_device->GetGroupTableEntries ()
-    + (1 - m_alpha) * m_ewmaGroupEntries;
-  m_ewmaMeterEntries = m_alpha * m_device->GetMeterTableEntries ()
-    + (1 - m_alpha) * m_ewmaMeterEntries;
-  m_ewmaPipelineDelay = m_alpha * m_device->GetPipelineDelay ().GetDouble ()
-    + (1 - m_alpha) * m_ewmaPipelineDelay;
+    + (1 - m_alpha) * std::pow (1 - m_alpha, skipped) * m_ewmaCpuLoad;
+  m_ewmaSumFlowEntries = m_device->GetSumFlowEntries ()
+    + (m_ewmaSumFlowEntries - m_device->GetSumFlowEntries ()) * keep;
+  m_ewmaGroupEntries = m_device->GetGroupTableEntries ()
+    + (m_ewmaGroupEntries - m_device->GetGroupTableEntries ()) * keep;
+  m_ewmaMeterEntries = m_device->GetMeterTableEntries ()
+    + (m_ewmaMeterEntries - m_device->GetMeterTableEntries ()) * keep;
+  m_ewmaPipelineDelay = m_device->GetPipelineDelay ().GetDouble ()
+    + (m_ewmaPipelineDelay - m_device->GetPipelineDelay ().GetDouble ()) * keep;
 
   for (size_t i = 0; i < m_device->GetNPipelineTables (); i++)
     {
-      m_ewmaFlowEntries.at (i) = m_alpha * m_device->GetFlowTableEntries (i)
-        + (1 - m_alpha) * m_ewmaFlowEntries.at (i);
+      double entries = m_device->GetFlowTableEntries (i);
+      double usage = m_device->GetFlowTableUsage (i);
+      m_ewmaFlowEntries.at (i) = entries
+        + (m_ewmaFlowEntries.at (i) - entries) * keep;
+      m_ewmaFlowUsage.at (i) = usage
+        + (m_ewmaFlowUsage.at (i) - usage) * keep;
     }
 }
 
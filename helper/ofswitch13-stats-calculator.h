@@ -155,6 +155,7 @@ private:
   std::string               m_filename;     //!< Output file name.
   Time                      m_timeout;      //!< Update timeout.
   Time                      m_lastUpdate;   //!< Last update time.
+  Time                      m_lastSample;   //!< Last EWMA sample time.
   double                    m_alpha;        //!< EWMA alpha parameter.
   bool                      m_details;      //!< Pipeline table details.
 
@@ -168,6 +169,7 @@ private:
   double    m_ewmaSumFlowEntries;
 
   std::vector<double> m_ewmaFlowEntries;
+  std::vector<double> m_ewmaFlowUsage;
 
   uint64_t  m_bytes;
   uint64_t  m_lastFlowMods;
@@ -0,0 +1,158 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+
+#include "ofswitch13-buffer-pool.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("OFSwitch13BufferPool");
+
+OFSwitch13BufferPool::OFSwitch13BufferPool (uint32_t maxPerClass)
+  : m_maxPerClass (maxPerClass),
+  m_nIdle (0),
+  m_highWater (0),
+  m_hits (0),
+  m_misses (0)
+{
+  NS_LOG_FUNCTION (this << maxPerClass);
+}
+
+OFSwitch13BufferPool::~OFSwitch13BufferPool ()
+{
+  NS_LOG_FUNCTION (this);
+
+  Clear ();
+}
+
+struct ofpbuf*
+OFSwitch13BufferPool::Get (size_t bodyRoom, size_t headRoom)
+{
+  NS_LOG_FUNCTION (this << bodyRoom << headRoom);
+
+  // Find the smallest size class that fits the requested space.
+  size_t size = bodyRoom + headRoom;
+  size_t classSize = MIN_CLASS_SIZE;
+  uint32_t idx = 0;
+  while (idx < N_CLASSES && classSize < size)
+    {
+      classSize <<= 1;
+      idx++;
+    }
+
+  struct ofpbuf *buffer;
+  if (idx < N_CLASSES && !m_free [idx].empty ())
+    {
+      m_hits++;
+      m_nIdle--;
+      buffer = m_free [idx].back ();
+      m_free [idx].pop_back ();
+
+      // Reset the buffer, keeping its allocated space.
+      ofpbuf_use (buffer, buffer->base, buffer->allocated);
+    }
+  else
+    {
+      m_misses++;
+      buffer = ofpbuf_new (idx < N_CLASSES ? classSize : size);
+    }
+  ofpbuf_reserve (buffer, headRoom);
+  return buffer;
+}
+
+struct ofpbuf*
+OFSwitch13BufferPool::BufferFromPacket (Ptr<const Packet> packet,
+                                        size_t bodyRoom, size_t headRoom)
+{
+  NS_LOG_FUNCTION (this << packet << bodyRoom << headRoom);
+
+  NS_ASSERT (packet->GetSize () <= bodyRoom);
+  uint32_t pktSize = packet->GetSize ();
+  struct ofpbuf *buffer = Get (bodyRoom, headRoom);
+  packet->CopyData ((uint8_t*)ofpbuf_put_uninit (buffer, pktSize), pktSize);
+  return buffer;
+}
+
+void
+OFSwitch13BufferPool::Put (struct ofpbuf *buffer)
+{
+  NS_LOG_FUNCTION (this << buffer);
+
+  if (!buffer)
+    {
+      return;
+    }
+
+  // Find the largest size class that fits in the buffer capacity.
+  size_t classSize = MIN_CLASS_SIZE;
+  uint32_t idx = 0;
+  if (buffer->allocated >= MIN_CLASS_SIZE)
+    {
+      while (idx + 1 < N_CLASSES && (classSize << 1) <= buffer->allocated)
+        {
+          classSize <<= 1;
+          idx++;
+        }
+      if (m_free [idx].size () < m_maxPerClass)
+        {
+          m_free [idx].push_back (buffer);
+          m_nIdle++;
+          m_highWater = std::max (m_highWater, m_nIdle);
+          return;
+        }
+    }
+  ofpbuf_delete (buffer);
+}
+
+void
+OFSwitch13BufferPool::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  for (uint32_t idx = 0; idx < N_CLASSES; idx++)
+    {
+      for (auto &buffer : m_free [idx])
+        {
+          ofpbuf_delete (buffer);
+        }
+      m_free [idx].clear ();
+    }
+  m_nIdle = 0;
+}
+
+uint64_t
+OFSwitch13BufferPool::GetHits (void) const
+{
+  return m_hits;
+}
+
+uint64_t
+OFSwitch13BufferPool::GetMisses (void) const
+{
+  return m_misses;
+}
+
+uint32_t
+OFSwitch13BufferPool::GetHighWater (void) const
+{
+  return m_highWater;
+}
+
+} // namespace ns3
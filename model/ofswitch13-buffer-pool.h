@@ -0,0 +1,109 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+
+#ifndef OFSWITCH13_BUFFER_POOL_H
+#define OFSWITCH13_BUFFER_POOL_H
+
+#include <vector>
+#include "ofswitch13-interface.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup ofswitch13
+ *
+ * Recycled pool of ofsoftswitch13 buffers (struct ofpbuf) used for OpenFlow
+ * messages exchanged over the control channel. Released buffers are kept in
+ * size-classed free lists (power-of-two capacities) and handed out again on
+ * the next request for a buffer that fits in the same size class, avoiding
+ * the malloc/free pair that would otherwise be paid for every message.
+ * Buffers larger than the largest size class are never pooled.
+ */
+class OFSwitch13BufferPool
+{
+public:
+  /**
+   * Complete constructor.
+   * \param maxPerClass The maximum number of idle buffers per size class.
+   */
+  OFSwitch13BufferPool (uint32_t maxPerClass = 32);
+  ~OFSwitch13BufferPool ();  //!< Dummy destructor.
+
+  /**
+   * Get an empty buffer with at least this amount of space.
+   * \param bodyRoom The size to allocate for data.
+   * \param headRoom The size to allocate for headers.
+   * \return The OpenFlow buffer.
+   */
+  struct ofpbuf* Get (size_t bodyRoom, size_t headRoom = 0);
+
+  /**
+   * Create a buffer from the ns-3 packet, loading the packet data into it.
+   * This is the pooled counterpart of ofs::BufferFromPacket ().
+   * \param packet The ns-3 packet.
+   * \param bodyRoom The size to allocate for data.
+   * \param headRoom The size to allocate for headers (left unitialized).
+   * \return The OpenFlow buffer created from the packet.
+   */
+  struct ofpbuf* BufferFromPacket (Ptr<const Packet> packet, size_t bodyRoom,
+                                   size_t headRoom = 0);
+
+  /**
+   * Release a buffer. This is the pooled counterpart of ofpbuf_delete (). Any
+   * buffer allocated with malloc can be released here, including the ones
+   * created by the ofsoftswitch13 library.
+   * \param buffer The OpenFlow buffer.
+   */
+  void Put (struct ofpbuf *buffer);
+
+  /** Free all idle buffers. */
+  void Clear (void);
+
+  /**
+   * \name Pool statistics accessors.
+   * \return The requested value.
+   */
+  //\{
+  uint64_t GetHits      (void) const;
+  uint64_t GetMisses    (void) const;
+  uint32_t GetHighWater (void) const;
+  //\}
+
+private:
+  /** Number of size classes. */
+  static const uint32_t N_CLASSES = 9;
+
+  /** Capacity of the smallest size class. */
+  static const size_t MIN_CLASS_SIZE = 256;
+
+  /** Structure to save a list of idle buffers. */
+  typedef std::vector<struct ofpbuf*> BufferList_t;
+
+  BufferList_t        m_free [N_CLASSES]; //!< Free lists by size class.
+  uint32_t            m_maxPerClass;      //!< Max idle buffers per class.
+  uint32_t            m_nIdle;            //!< Number of idle buffers.
+  uint32_t            m_highWater;        //!< Max number of idle buffers.
+  uint64_t            m_hits;             //!< Requests served from pool.
+  uint64_t            m_misses;           //!< Requests served by malloc.
+}; // Class OFSwitch13BufferPool
+
+} // namespace ns3
+#endif /* OFSWITCH13_BUFFER_POOL_H */
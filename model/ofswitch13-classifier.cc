@@ -0,0 +1,1625 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+#include <algorithm>
+#include <ns3/log.h>
+#include "ofswitch13-classifier.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("OFSwitch13Classifier");
+
+OFSwitch13Classifier::OFSwitch13Classifier ()
+  : m_nEntries (0),
+  m_valid (false)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+OFSwitch13Classifier::~OFSwitch13Classifier ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+OFSwitch13Classifier::Build (struct flow_table *table)
+{
+  NS_LOG_FUNCTION (this << (uint16_t)table->stats->table_id);
+
+  Clear ();
+  struct flow_entry *entry;
+  LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries)
+  {
+    Insert (entry);
+  }
+  DoUpdate ();
+  m_valid = true;
+  NS_LOG_DEBUG ("Classifier built with " << m_nEntries << " entries (" <<
+                m_linear.size () << " searched linearly).");
+}
+
+void
+OFSwitch13Classifier::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  DoClear ();
+  m_linear.clear ();
+  m_nEntries = 0;
+  m_valid = false;
+}
+
+void
+OFSwitch13Classifier::Insert (struct flow_entry *entry)
+{
+  OFSwitch13FlowKey value;
+  OFSwitch13FlowKey mask;
+  if (!GetKeys (entry, value, mask) || !DoInsert (entry, value, mask))
+    {
+      InsertSorted (m_linear, entry);
+    }
+  m_nEntries++;
+}
+
+void
+OFSwitch13Classifier::Remove (struct flow_entry *entry)
+{
+  OFSwitch13FlowKey value;
+  OFSwitch13FlowKey mask;
+  if ((GetKeys (entry, value, mask) && DoRemove (entry, value, mask))
+      || RemoveFrom (m_linear, entry))
+    {
+      m_nEntries--;
+    }
+}
+
+struct flow_entry*
+OFSwitch13Classifier::Find (struct ofl_match_header *match, uint16_t priority)
+{
+  if (match->type != OFPMT_OXM)
+    {
+      return 0;
+    }
+
+  // Indexed entries with the same flow keys are confirmed by the library
+  // strict match function.
+  OFSwitch13FlowKey value;
+  OFSwitch13FlowKey mask;
+  if (value.SetMatch ((struct ofl_match*)match, &mask))
+    {
+      struct flow_entry *entry = DoFind (value, mask, priority);
+      if (entry && StrictMatches (entry, match))
+        {
+          return entry;
+        }
+    }
+  for (auto const &entry : m_linear)
+    {
+      if (entry->stats->priority == priority && StrictMatches (entry, match))
+        {
+          return entry;
+        }
+    }
+  return 0;
+}
+
+struct flow_entry*
+OFSwitch13Classifier::Lookup (struct packet *pkt)
+{
+  if (!pkt->handle_std->valid)
+    {
+      packet_handle_std_validate (pkt->handle_std);
+    }
+
+  // Fields that can't be represented by the flow key are ignored here, as
+  // entries matching them are searched linearly.
+  OFSwitch13FlowKey key;
+  key.SetMatch (&pkt->handle_std->match, 0);
+  return Lookup (pkt, key);
+}
+
+struct flow_entry*
+OFSwitch13Classifier::Lookup (struct packet *pkt, const OFSwitch13FlowKey &key)
+{
+  // The packet match structure is only validated by the library when there
+  // are entries in the linear list that may beat the indexed best match.
+  struct flow_entry *best = DoLookup (key);
+  return SearchSorted (pkt, m_linear, best);
+}
+
+bool
+OFSwitch13Classifier::IsValid (void) const
+{
+  return m_valid;
+}
+
+void
+OFSwitch13Classifier::Update (void)
+{
+  if (m_valid)
+    {
+      DoUpdate ();
+    }
+}
+
+uint32_t
+OFSwitch13Classifier::GetNEntries (void) const
+{
+  return m_nEntries;
+}
+
+uint32_t
+OFSwitch13Classifier::GetNLinear (void) const
+{
+  return m_linear.size ();
+}
+
+void
+OFSwitch13Classifier::DoUpdate (void)
+{
+}
+
+bool
+OFSwitch13Classifier::Matches (struct packet *pkt, struct flow_entry *entry)
+{
+  struct ofl_match_header *m = entry->match ? entry->match :
+    entry->stats->match;
+  if (!pkt->handle_std->valid)
+    {
+      packet_handle_std_validate (pkt->handle_std);
+    }
+  return m->type == OFPMT_OXM
+         && packet_handle_std_match (pkt->handle_std, (struct ofl_match*)m);
+}
+
+bool
+OFSwitch13Classifier::KeyMatches (const OFSwitch13FlowKey &value,
+                                  const OFSwitch13FlowKey &mask,
+                                  const OFSwitch13FlowKey &key)
+{
+  const uint64_t *valueWords = value.GetWords ();
+  const uint64_t *maskWords = mask.GetWords ();
+  const uint64_t *keyWords = key.GetWords ();
+  for (size_t i = 0; i < OFS_FLOW_KEY_WORDS; i++)
+    {
+      if ((keyWords [i] & maskWords [i]) != valueWords [i])
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+bool
+OFSwitch13Classifier::StrictMatches (struct flow_entry *entry,
+                                     struct ofl_match_header *match)
+{
+  struct ofl_match_header *m = entry->match ? entry->match :
+    entry->stats->match;
+  return m->type == OFPMT_OXM
+         && match_std_strict ((struct ofl_match*)m, (struct ofl_match*)match);
+}
+
+bool
+OFSwitch13Classifier::GetKeys (struct flow_entry *entry,
+                               OFSwitch13FlowKey &value,
+                               OFSwitch13FlowKey &mask)
+{
+  // Same match structure used by flow_table_lookup ().
+  struct ofl_match_header *m = entry->match ? entry->match :
+    entry->stats->match;
+  return m->type == OFPMT_OXM && value.SetMatch ((struct ofl_match*)m, &mask);
+}
+
+void
+OFSwitch13Classifier::InsertSorted (EntryList_t &list,
+                                    struct flow_entry *entry)
+{
+  // Search from the end, as entries are usually inserted in priority order.
+  auto it = list.end ();
+  while (it != list.begin ()
+         && (*(it - 1))->stats->priority < entry->stats->priority)
+    {
+      --it;
+    }
+  list.insert (it, entry);
+}
+
+bool
+OFSwitch13Classifier::RemoveFrom (EntryList_t &list, struct flow_entry *entry)
+{
+  auto it = std::find (list.begin (), list.end (), entry);
+  if (it == list.end ())
+    {
+      return false;
+    }
+  list.erase (it);
+  return true;
+}
+
+struct flow_entry*
+OFSwitch13Classifier::SearchSorted (struct packet *pkt,
+                                    const EntryList_t &list,
+                                    struct flow_entry *best)
+{
+  for (auto const &entry : list)
+    {
+      if (best && entry->stats->priority <= best->stats->priority)
+        {
+          break;
+        }
+      if (Matches (pkt, entry))
+        {
+          return entry;
+        }
+    }
+  return best;
+}
+
+/********** OFSwitch13TssClassifier **********/
+OFSwitch13TssClassifier::OFSwitch13TssClassifier ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+OFSwitch13TssClassifier::~OFSwitch13TssClassifier ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint32_t
+OFSwitch13TssClassifier::GetNSubtables (void) const
+{
+  return m_subtables.size ();
+}
+
+bool
+OFSwitch13TssClassifier::DoInsert (struct flow_entry *entry,
+                                   const OFSwitch13FlowKey &value,
+                                   const OFSwitch13FlowKey &mask)
+{
+  uint16_t priority = entry->stats->priority;
+
+  // Find the subtable for this mask, creating a new one when necessary.
+  size_t idx = FindSubtable (mask);
+  if (idx == m_subtables.size ())
+    {
+      NS_LOG_DEBUG ("New classifier subtable.");
+      m_subtables.push_back (Subtable ());
+      m_subtables.back ().mask = mask;
+      m_subtables.back ().maxPriority = priority;
+    }
+  Subtable &subtable = m_subtables [idx];
+  InsertSorted (subtable.entries [value], entry);
+
+  // Keep the subtables sorted by decreasing highest entry priority.
+  if (priority > subtable.maxPriority)
+    {
+      subtable.maxPriority = priority;
+    }
+  while (idx > 0 && m_subtables [idx - 1].maxPriority
+         < m_subtables [idx].maxPriority)
+    {
+      std::swap (m_subtables [idx - 1], m_subtables [idx]);
+      idx--;
+    }
+  return true;
+}
+
+bool
+OFSwitch13TssClassifier::DoRemove (struct flow_entry *entry,
+                                   const OFSwitch13FlowKey &value,
+                                   const OFSwitch13FlowKey &mask)
+{
+  size_t idx = FindSubtable (mask);
+  if (idx == m_subtables.size ())
+    {
+      return false;
+    }
+
+  Subtable &subtable = m_subtables [idx];
+  auto it = subtable.entries.find (value);
+  if (it == subtable.entries.end () || !RemoveFrom (it->second, entry))
+    {
+      return false;
+    }
+
+  // The highest entry priority is kept as an upper bound for the subtable,
+  // so the subtables remain sorted. Empty subtables are removed.
+  if (it->second.empty ())
+    {
+      subtable.entries.erase (it);
+      if (subtable.entries.empty ())
+        {
+          m_subtables.erase (m_subtables.begin () + idx);
+        }
+    }
+  return true;
+}
+
+struct flow_entry*
+OFSwitch13TssClassifier::DoFind (const OFSwitch13FlowKey &value,
+                                 const OFSwitch13FlowKey &mask,
+                                 uint16_t priority)
+{
+  size_t idx = FindSubtable (mask);
+  if (idx == m_subtables.size ())
+    {
+      return 0;
+    }
+
+  auto it = m_subtables [idx].entries.find (value);
+  if (it != m_subtables [idx].entries.end ())
+    {
+      for (auto const &entry : it->second)
+        {
+          if (entry->stats->priority == priority)
+            {
+              return entry;
+            }
+        }
+    }
+  return 0;
+}
+
+struct flow_entry*
+OFSwitch13TssClassifier::DoLookup (const OFSwitch13FlowKey &key)
+{
+  struct flow_entry *best = 0;
+  for (auto const &subtable : m_subtables)
+    {
+      // No entry in this or in the next subtables can beat the best match.
+      if (best && subtable.maxPriority <= best->stats->priority)
+        {
+          break;
+        }
+
+      OFSwitch13FlowKey maskedKey = key;
+      maskedKey.ApplyMask (subtable.mask);
+      auto it = subtable.entries.find (maskedKey);
+      if (it == subtable.entries.end ())
+        {
+          continue;
+        }
+
+      // All entries with the same masked key match the packet, so the first
+      // one in the list (sorted by priority) is the candidate.
+      struct flow_entry *entry = it->second.front ();
+      if (!best || entry->stats->priority > best->stats->priority)
+        {
+          best = entry;
+        }
+    }
+  return best;
+}
+
+void
+OFSwitch13TssClassifier::DoClear (void)
+{
+  m_subtables.clear ();
+}
+
+size_t
+OFSwitch13TssClassifier::FindSubtable (const OFSwitch13FlowKey &mask) const
+{
+  size_t idx = 0;
+  while (idx < m_subtables.size () && !(m_subtables [idx].mask == mask))
+    {
+      idx++;
+    }
+  return idx;
+}
+
+/********** OFSwitch13ExactClassifier **********/
+OFSwitch13ExactClassifier::OFSwitch13ExactClassifier ()
+  : m_free (0),
+  m_nUsed (0),
+  m_hasFields (false)
+{
+  NS_LOG_FUNCTION (this);
+
+  Slot unused = {0, 0, 0};
+  m_slots.push_back (unused);
+}
+
+OFSwitch13ExactClassifier::~OFSwitch13ExactClassifier ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+bool
+OFSwitch13ExactClassifier::SetFields (const std::vector<uint32_t> &fields)
+{
+  NS_LOG_FUNCTION (this << fields.size ());
+
+  Clear ();
+  m_hasFields = false;
+  m_mask = OFSwitch13FlowKey ();
+  if (fields.empty ())
+    {
+      return true;
+    }
+
+  // The mask is built from a match with zeroed values for all fields, just
+  // like the mask of the entries with this field set.
+  uint8_t zeros [16] = {0};
+  struct ofl_match *match =
+    (struct ofl_match*)xmalloc (sizeof (struct ofl_match));
+  ofl_structs_match_init (match);
+  bool valid = true;
+  for (auto const &field : fields)
+    {
+      switch (OXM_LENGTH (field))
+        {
+        case 1:
+          ofl_structs_match_put8 (match, field, 0);
+          break;
+        case 2:
+          ofl_structs_match_put16 (match, field, 0);
+          break;
+        case 4:
+          ofl_structs_match_put32 (match, field, 0);
+          break;
+        case 6:
+          ofl_structs_match_put_eth (match, field, zeros);
+          break;
+        case 8:
+          ofl_structs_match_put64 (match, field, 0);
+          break;
+        case 16:
+          ofl_structs_match_put_ipv6 (match, field, zeros);
+          break;
+        default:
+          valid = false;
+        }
+      if (OXM_HASMASK (field))
+        {
+          valid = false;
+        }
+    }
+  OFSwitch13FlowKey value;
+  OFSwitch13FlowKey mask;
+  valid = valid && value.SetMatch (match, &mask)
+    && !(mask == OFSwitch13FlowKey ());
+  ofl_structs_free_match ((struct ofl_match_header*)match, 0);
+  if (!valid)
+    {
+      NS_LOG_WARN ("Field set not supported by exact-match table.");
+      return false;
+    }
+  m_mask = mask;
+  m_hasFields = true;
+  return true;
+}
+
+ofl_err
+OFSwitch13ExactClassifier::CheckMatch (struct ofl_match_header *match,
+                                       uint16_t priority,
+                                       uint16_t flags) const
+{
+  if (match->type != OFPMT_OXM)
+    {
+      return ofl_error (OFPET_BAD_MATCH, OFPBMC_BAD_TYPE);
+    }
+  if (!m_hasFields)
+    {
+      return 0;
+    }
+
+  struct ofl_match_tlv *tlv;
+  HMAP_FOR_EACH (tlv, struct ofl_match_tlv, hmap_node,
+                 &((struct ofl_match*)match)->match_fields)
+  {
+    if (OXM_HASMASK (tlv->header))
+      {
+        NS_LOG_DEBUG ("Masked field not supported by exact-match table.");
+        return ofl_error (OFPET_BAD_MATCH, OFPBMC_BAD_MASK);
+      }
+  }
+
+  OFSwitch13FlowKey value;
+  OFSwitch13FlowKey mask;
+  if (!value.SetMatch ((struct ofl_match*)match, &mask))
+    {
+      NS_LOG_DEBUG ("Field not supported by exact-match table.");
+      return ofl_error (OFPET_BAD_MATCH, OFPBMC_BAD_FIELD);
+    }
+  if (mask == OFSwitch13FlowKey ())
+    {
+      return 0;
+    }
+  if (!(mask == m_mask))
+    {
+      NS_LOG_DEBUG ("Field set not supported by exact-match table.");
+      return ofl_error (OFPET_BAD_MATCH, OFPBMC_BAD_FIELD);
+    }
+  if (!(flags & OFPFF_CHECK_OVERLAP) || m_buckets.empty ())
+    {
+      return 0;
+    }
+
+  // Entries with the same field values and priority overlap. The chain is
+  // sorted by priority, so the search stops at lower priorities.
+  OFSwitch13FlowKey entryValue;
+  OFSwitch13FlowKey entryMask;
+  size_t hash = value.Hash ();
+  uint32_t idx = m_buckets [hash & (m_buckets.size () - 1)];
+  for (; idx && m_slots [idx].entry->stats->priority >= priority;
+       idx = m_slots [idx].next)
+    {
+      const Slot &slot = m_slots [idx];
+      if (slot.hash == hash && slot.entry->stats->priority == priority
+          && GetKeys (slot.entry, entryValue, entryMask)
+          && entryValue == value)
+        {
+          NS_LOG_DEBUG ("Overlapping entry in exact-match table.");
+          return ofl_error (OFPET_FLOW_MOD_FAILED, OFPFMFC_OVERLAP);
+        }
+    }
+  return 0;
+}
+
+uint32_t
+OFSwitch13ExactClassifier::GetNBuckets (void) const
+{
+  return m_buckets.size ();
+}
+
+uint32_t
+OFSwitch13ExactClassifier::GetNUsedSlots (void) const
+{
+  return m_nUsed;
+}
+
+bool
+OFSwitch13ExactClassifier::DoInsert (struct flow_entry *entry,
+                                     const OFSwitch13FlowKey &value,
+                                     const OFSwitch13FlowKey &mask)
+{
+  // The table-miss entry and entries with other field sets are searched
+  // linearly.
+  if (!m_hasFields || !(mask == m_mask))
+    {
+      return false;
+    }
+
+  // Keep at most one entry per bucket on average.
+  if (m_nUsed + 1 > m_buckets.size ())
+    {
+      Grow ();
+    }
+
+  uint32_t idx = m_free;
+  if (idx)
+    {
+      m_free = m_slots [idx].next;
+    }
+  else
+    {
+      idx = m_slots.size ();
+      m_slots.push_back (Slot ());
+    }
+  m_slots [idx].hash = value.Hash ();
+  m_slots [idx].entry = entry;
+  Link (idx);
+  m_nUsed++;
+  return true;
+}
+
+bool
+OFSwitch13ExactClassifier::DoRemove (struct flow_entry *entry,
+                                     const OFSwitch13FlowKey &value,
+                                     const OFSwitch13FlowKey &mask)
+{
+  if (!m_nUsed || !(mask == m_mask))
+    {
+      return false;
+    }
+
+  uint32_t *link = &m_buckets [value.Hash () & (m_buckets.size () - 1)];
+  while (*link && m_slots [*link].entry != entry)
+    {
+      link = &m_slots [*link].next;
+    }
+  if (!*link)
+    {
+      return false;
+    }
+
+  // Unlink the slot and release it.
+  uint32_t idx = *link;
+  *link = m_slots [idx].next;
+  m_slots [idx].entry = 0;
+  m_slots [idx].next = m_free;
+  m_free = idx;
+  m_nUsed--;
+  return true;
+}
+
+struct flow_entry*
+OFSwitch13ExactClassifier::DoFind (const OFSwitch13FlowKey &value,
+                                   const OFSwitch13FlowKey &mask,
+                                   uint16_t priority)
+{
+  if (!m_nUsed || !(mask == m_mask))
+    {
+      return 0;
+    }
+
+  OFSwitch13FlowKey entryValue;
+  OFSwitch13FlowKey entryMask;
+  size_t hash = value.Hash ();
+  uint32_t idx = m_buckets [hash & (m_buckets.size () - 1)];
+  for (; idx; idx = m_slots [idx].next)
+    {
+      const Slot &slot = m_slots [idx];
+      if (slot.hash == hash && slot.entry->stats->priority == priority
+          && GetKeys (slot.entry, entryValue, entryMask)
+          && entryValue == value)
+        {
+          return slot.entry;
+        }
+    }
+  return 0;
+}
+
+struct flow_entry*
+OFSwitch13ExactClassifier::DoLookup (const OFSwitch13FlowKey &key)
+{
+  if (!m_nUsed)
+    {
+      return 0;
+    }
+
+  OFSwitch13FlowKey maskedKey = key;
+  maskedKey.ApplyMask (m_mask);
+  size_t hash = maskedKey.Hash ();
+  uint32_t idx = m_buckets [hash & (m_buckets.size () - 1)];
+  for (; idx; idx = m_slots [idx].next)
+    {
+      // Slots only save the hash value, so the entry keys are rebuilt from
+      // its match to solve hash collisions. The chain is sorted by priority,
+      // so the first matching entry is the best one.
+      const Slot &slot = m_slots [idx];
+      OFSwitch13FlowKey value;
+      OFSwitch13FlowKey mask;
+      if (slot.hash == hash && GetKeys (slot.entry, value, mask)
+          && value == maskedKey)
+        {
+          return slot.entry;
+        }
+    }
+  return 0;
+}
+
+void
+OFSwitch13ExactClassifier::DoClear (void)
+{
+  m_buckets.clear ();
+  m_slots.resize (1);
+  m_free = 0;
+  m_nUsed = 0;
+}
+
+void
+OFSwitch13ExactClassifier::Link (uint32_t idx)
+{
+  // New entries are placed after those with the same priority, just like
+  // the ofsoftswitch13 flow table does.
+  uint16_t priority = m_slots [idx].entry->stats->priority;
+  uint32_t *link = &m_buckets [m_slots [idx].hash & (m_buckets.size () - 1)];
+  while (*link && m_slots [*link].entry->stats->priority >= priority)
+    {
+      link = &m_slots [*link].next;
+    }
+  m_slots [idx].next = *link;
+  *link = idx;
+}
+
+void
+OFSwitch13ExactClassifier::Grow (void)
+{
+  m_buckets.assign (m_buckets.empty () ? 16 : m_buckets.size () * 2, 0);
+  NS_LOG_DEBUG ("Growing exact-match hash table to " << m_buckets.size () <<
+                " buckets.");
+
+  // Relinking the slots in index order doesn't keep the relative order of
+  // entries with the same priority in a bucket, but these entries have
+  // different field values, so they can't overlap.
+  for (uint32_t idx = 1; idx < m_slots.size (); idx++)
+    {
+      if (m_slots [idx].entry)
+        {
+          Link (idx);
+        }
+    }
+}
+
+/********** OFSwitch13LpmClassifier **********/
+OFSwitch13LpmClassifier::OFSwitch13LpmClassifier ()
+  : m_nPrefixes (0)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_nodes.push_back (0);
+  m_roots [0] = 0;
+  m_roots [1] = 0;
+}
+
+OFSwitch13LpmClassifier::~OFSwitch13LpmClassifier ()
+{
+  NS_LOG_FUNCTION (this);
+
+  DoClear ();
+}
+
+uint32_t
+OFSwitch13LpmClassifier::GetNPrefixes (void) const
+{
+  return m_nPrefixes;
+}
+
+uint32_t
+OFSwitch13LpmClassifier::GetNNodes (void) const
+{
+  return m_nodes.size () - 1 - m_free.size ();
+}
+
+bool
+OFSwitch13LpmClassifier::DoInsert (struct flow_entry *entry,
+                                   const OFSwitch13FlowKey &value,
+                                   const OFSwitch13FlowKey &mask)
+{
+  const uint8_t *addr;
+  uint32_t length;
+  int trie = GetPrefix (value, mask, &addr, length);
+  if (trie < 0)
+    {
+      return OFSwitch13TssClassifier::DoInsert (entry, value, mask);
+    }
+
+  // Walk down the trie up to the node holding the last prefix bit, creating
+  // the missing nodes.
+  uint32_t depth;
+  uint16_t key = GetPrefixKey (addr, length, depth);
+  if (!m_roots [trie])
+    {
+      m_roots [trie] = NewNode ();
+    }
+  Node *node = m_nodes [m_roots [trie]];
+  for (uint32_t d = 0; d < depth; d++)
+    {
+      if (node->children.empty ())
+        {
+          node->children.resize (256, 0);
+        }
+      uint32_t &child = node->children [addr [d]];
+      if (!child)
+        {
+          child = NewNode ();
+          node->nChildren++;
+        }
+      node = m_nodes [child];
+    }
+
+  auto it = node->prefixes.find (key);
+  if (it == node->prefixes.end ())
+    {
+      // Reuse a released position in the list of fronts.
+      Prefix prefix;
+      prefix.index = std::find (node->fronts.begin (), node->fronts.end (),
+                                (struct flow_entry*)0) - node->fronts.begin ();
+      if (prefix.index == node->fronts.size ())
+        {
+          node->fronts.push_back (0);
+        }
+      it = node->prefixes.insert (std::make_pair (key, prefix)).first;
+    }
+  InsertSorted (it->second.entries, entry);
+  node->fronts [it->second.index] = it->second.entries.front ();
+  UpdateSlots (*node, key);
+  m_nPrefixes++;
+  return true;
+}
+
+bool
+OFSwitch13LpmClassifier::DoRemove (struct flow_entry *entry,
+                                   const OFSwitch13FlowKey &value,
+                                   const OFSwitch13FlowKey &mask)
+{
+  const uint8_t *addr;
+  uint32_t length;
+  int trie = GetPrefix (value, mask, &addr, length);
+  if (trie < 0)
+    {
+      return OFSwitch13TssClassifier::DoRemove (entry, value, mask);
+    }
+
+  // Walk down the trie saving the path, so empty nodes can be released.
+  uint32_t depth;
+  uint16_t key = GetPrefixKey (addr, length, depth);
+  uint32_t path [16] = {0};
+  path [0] = m_roots [trie];
+  for (uint32_t d = 0; path [d] && d < depth; d++)
+    {
+      const Node *node = m_nodes [path [d]];
+      path [d + 1] = node->children.empty () ? 0 : node->children [addr [d]];
+    }
+  if (!path [depth])
+    {
+      return false;
+    }
+
+  Node *node = m_nodes [path [depth]];
+  auto it = node->prefixes.find (key);
+  if (it == node->prefixes.end () || !RemoveFrom (it->second.entries, entry))
+    {
+      return false;
+    }
+  if (it->second.entries.empty ())
+    {
+      node->fronts [it->second.index] = 0;
+      node->prefixes.erase (it);
+    }
+  else
+    {
+      node->fronts [it->second.index] = it->second.entries.front ();
+    }
+  UpdateSlots (*node, key);
+  m_nPrefixes--;
+
+  // Release the nodes left without prefixes and children.
+  uint32_t d = depth;
+  while (node->prefixes.empty () && !node->nChildren)
+    {
+      delete node;
+      m_nodes [path [d]] = 0;
+      m_free.push_back (path [d]);
+      if (d == 0)
+        {
+          m_roots [trie] = 0;
+          break;
+        }
+      d--;
+      node = m_nodes [path [d]];
+      node->children [addr [d]] = 0;
+      if (--node->nChildren == 0)
+        {
+          node->children.clear ();
+        }
+    }
+  return true;
+}
+
+struct flow_entry*
+OFSwitch13LpmClassifier::DoFind (const OFSwitch13FlowKey &value,
+                                 const OFSwitch13FlowKey &mask,
+                                 uint16_t priority)
+{
+  const uint8_t *addr;
+  uint32_t length;
+  int trie = GetPrefix (value, mask, &addr, length);
+  if (trie < 0)
+    {
+      return OFSwitch13TssClassifier::DoFind (value, mask, priority);
+    }
+
+  uint32_t depth;
+  uint16_t key = GetPrefixKey (addr, length, depth);
+  uint32_t idx = m_roots [trie];
+  for (uint32_t d = 0; idx && d < depth; d++)
+    {
+      const Node *node = m_nodes [idx];
+      idx = node->children.empty () ? 0 : node->children [addr [d]];
+    }
+  if (!idx)
+    {
+      return 0;
+    }
+
+  auto it = m_nodes [idx]->prefixes.find (key);
+  if (it != m_nodes [idx]->prefixes.end ())
+    {
+      for (auto const &entry : it->second.entries)
+        {
+          if (entry->stats->priority == priority)
+            {
+              return entry;
+            }
+        }
+    }
+  return 0;
+}
+
+struct flow_entry*
+OFSwitch13LpmClassifier::DoLookup (const OFSwitch13FlowKey &key)
+{
+  struct flow_entry *best = 0;
+  const uint8_t *addr = 0;
+  uint32_t levels = 0;
+  uint32_t idx = 0;
+  if (key.ethType == 0x0800)
+    {
+      addr = key.nwDst;
+      levels = 4;
+      idx = m_roots [0];
+    }
+  else if (key.ethType == 0x86dd)
+    {
+      addr = key.ipv6Dst;
+      levels = 16;
+      idx = m_roots [1];
+    }
+
+  // Walk down the trie keeping the highest priority entry. Among entries
+  // with the same priority, the longest prefix wins.
+  for (uint32_t d = 0; idx && d < levels; d++)
+    {
+      const Node *node = m_nodes [idx];
+      uint16_t slot = node->best [addr [d]];
+      if (slot)
+        {
+          struct flow_entry *entry = node->fronts [slot - 1];
+          if (!best || entry->stats->priority >= best->stats->priority)
+            {
+              best = entry;
+            }
+        }
+      idx = node->children.empty () ? 0 : node->children [addr [d]];
+    }
+
+  struct flow_entry *other = OFSwitch13TssClassifier::DoLookup (key);
+  if (other && (!best || other->stats->priority > best->stats->priority))
+    {
+      best = other;
+    }
+  return best;
+}
+
+void
+OFSwitch13LpmClassifier::DoClear (void)
+{
+  for (auto &node : m_nodes)
+    {
+      delete node;
+    }
+  m_nodes.assign (1, 0);
+  m_free.clear ();
+  m_roots [0] = 0;
+  m_roots [1] = 0;
+  m_nPrefixes = 0;
+  OFSwitch13TssClassifier::DoClear ();
+}
+
+int
+OFSwitch13LpmClassifier::GetPrefix (const OFSwitch13FlowKey &value,
+                                    const OFSwitch13FlowKey &mask,
+                                    const uint8_t **addr, uint32_t &length)
+{
+  int trie;
+  uint32_t size;
+  const uint8_t *addrMask;
+  if (value.ethType == 0x0800)
+    {
+      trie = 0;
+      size = 4;
+      *addr = value.nwDst;
+      addrMask = mask.nwDst;
+    }
+  else if (value.ethType == 0x86dd)
+    {
+      trie = 1;
+      size = 16;
+      *addr = value.ipv6Dst;
+      addrMask = mask.ipv6Dst;
+    }
+  else
+    {
+      return -1;
+    }
+
+  // Count the leading mask bits and compare the mask with the one expected
+  // for this prefix, so entries with other fields or non-contiguous masks
+  // are rejected.
+  length = 0;
+  for (uint32_t i = 0; i < size && addrMask [i] == 0xff; i++)
+    {
+      length += 8;
+    }
+  if (length < size * 8)
+    {
+      uint8_t byte = addrMask [length / 8];
+      while (byte & 0x80)
+        {
+          length++;
+          byte <<= 1;
+        }
+    }
+
+  OFSwitch13FlowKey expected;
+  expected.ethType = 0xffff;
+  expected.layers = mask.layers & ((trie == 0) ? OFSwitch13FlowKey::LAYER_IPV4 :
+                                   OFSwitch13FlowKey::LAYER_IPV6);
+  uint8_t *expMask = (trie == 0) ? expected.nwDst : expected.ipv6Dst;
+  for (uint32_t i = 0; i < length; i++)
+    {
+      expMask [i / 8] |= 0x80 >> (i % 8);
+    }
+  return (mask == expected) ? trie : -1;
+}
+
+uint16_t
+OFSwitch13LpmClassifier::GetPrefixKey (const uint8_t *addr, uint32_t length,
+                                       uint32_t &depth)
+{
+  // The default route (zero length) is held by the root node. Other prefixes
+  // are held by the node covering their last bit. As the address is masked,
+  // the address byte is the first node slot covered by the prefix.
+  depth = length ? (length - 1) / 8 : 0;
+  uint32_t bits = length - depth * 8;
+  return (addr [depth] << 4) | bits;
+}
+
+uint32_t
+OFSwitch13LpmClassifier::NewNode (void)
+{
+  uint32_t idx;
+  if (m_free.empty ())
+    {
+      idx = m_nodes.size ();
+      m_nodes.push_back (0);
+    }
+  else
+    {
+      idx = m_free.back ();
+      m_free.pop_back ();
+    }
+  m_nodes [idx] = new Node ();
+  return idx;
+}
+
+void
+OFSwitch13LpmClassifier::UpdateSlots (Node &node, uint16_t key)
+{
+  uint32_t bits = key & 0xf;
+  uint32_t first = key >> 4;
+  uint32_t last = first + (1 << (8 - bits));
+
+  // Start with the highest priority entry among this prefix and the shorter
+  // ones covering it, preferring longer prefixes on the same priority.
+  uint16_t best = 0;
+  for (uint32_t b = 0; b <= bits; b++)
+    {
+      uint32_t slot = (first >> (8 - b)) << (8 - b);
+      auto it = node.prefixes.find ((slot << 4) | b);
+      if (it == node.prefixes.end ())
+        {
+          continue;
+        }
+      struct flow_entry *entry = it->second.entries.front ();
+      if (!best || entry->stats->priority
+          >= node.fronts [best - 1]->stats->priority)
+        {
+          best = it->second.index + 1;
+        }
+    }
+  for (uint32_t s = first; s < last; s++)
+    {
+      node.best [s] = best;
+    }
+
+  // Then visit the longer prefixes covered by this one. As the prefix map is
+  // sorted in preorder, each slot is updated after all shorter prefixes
+  // covering it.
+  auto it = node.prefixes.upper_bound (key);
+  while (it != node.prefixes.end () && (uint32_t)(it->first >> 4) < last)
+    {
+      uint32_t from = it->first >> 4;
+      uint32_t to = from + (1 << (8 - (it->first & 0xf)));
+      struct flow_entry *entry = it->second.entries.front ();
+      for (uint32_t s = from; s < to; s++)
+        {
+          if (!node.best [s] || entry->stats->priority
+              >= node.fronts [node.best [s] - 1]->stats->priority)
+            {
+              node.best [s] = it->second.index + 1;
+            }
+        }
+      ++it;
+    }
+}
+
+/********** OFSwitch13TreeClassifier **********/
+/** Number of bits of each field cut by the decision tree. */
+static const uint8_t g_treeFieldBits [] = {32, 16, 32, 32, 8, 16, 16};
+
+OFSwitch13TreeClassifier::OFSwitch13TreeClassifier (double spaceFactor)
+  : m_nTree (0),
+  m_nDead (0),
+  m_depth (0),
+  m_spaceFactor (spaceFactor)
+{
+  NS_LOG_FUNCTION (this << spaceFactor);
+
+  m_nodes.push_back (Node ());
+}
+
+OFSwitch13TreeClassifier::~OFSwitch13TreeClassifier ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint32_t
+OFSwitch13TreeClassifier::GetDepth (void) const
+{
+  return m_depth;
+}
+
+uint32_t
+OFSwitch13TreeClassifier::GetNNodes (void) const
+{
+  return m_nodes.size ();
+}
+
+uint32_t
+OFSwitch13TreeClassifier::GetNPending (void) const
+{
+  return m_pending.size ();
+}
+
+double
+OFSwitch13TreeClassifier::GetSpaceFactor (void) const
+{
+  return m_spaceFactor;
+}
+
+bool
+OFSwitch13TreeClassifier::DoInsert (struct flow_entry *entry,
+                                    const OFSwitch13FlowKey &value,
+                                    const OFSwitch13FlowKey &mask)
+{
+  Rule rule;
+  rule.entry = entry;
+  rule.priority = entry->stats->priority;
+  rule.value = value;
+  rule.mask = mask;
+
+  // The range of each field is given by the leading mask bits, so masks
+  // that are not prefixes result in a larger range (the other mask bits are
+  // checked when comparing the keys).
+  for (uint32_t f = 0; f < N_FIELDS; f++)
+    {
+      uint32_t bits = g_treeFieldBits [f];
+      uint64_t full = (1ULL << bits) - 1;
+      uint32_t fieldMask = GetField (mask, f);
+      uint32_t ones = 0;
+      while (ones < bits && (fieldMask & (1U << (bits - ones - 1))))
+        {
+          ones++;
+        }
+      uint64_t prefix = full & ~((1ULL << (bits - ones)) - 1);
+      rule.lo [f] = GetField (value, f) & prefix;
+      rule.hi [f] = rule.lo [f] | (full & ~prefix);
+    }
+
+  // New rules are searched linearly until the next tree rebuild.
+  uint32_t idx = m_rules.size ();
+  m_rules.push_back (rule);
+  m_index [entry] = idx;
+  auto it = m_pending.end ();
+  while (it != m_pending.begin ()
+         && m_rules [*(it - 1)].priority < rule.priority)
+    {
+      --it;
+    }
+  m_pending.insert (it, idx);
+  return true;
+}
+
+bool
+OFSwitch13TreeClassifier::DoRemove (struct flow_entry *entry,
+                                    const OFSwitch13FlowKey &value,
+                                    const OFSwitch13FlowKey &mask)
+{
+  auto it = m_index.find (entry);
+  if (it == m_index.end ())
+    {
+      return false;
+    }
+
+  // The rule is kept as dead until the next tree rebuild.
+  uint32_t idx = it->second;
+  m_index.erase (it);
+  m_rules [idx].entry = 0;
+  m_nDead++;
+  auto pt = std::find (m_pending.begin (), m_pending.end (), idx);
+  if (pt != m_pending.end ())
+    {
+      m_pending.erase (pt);
+    }
+  else
+    {
+      m_nTree--;
+    }
+  return true;
+}
+
+struct flow_entry*
+OFSwitch13TreeClassifier::DoFind (const OFSwitch13FlowKey &value,
+                                  const OFSwitch13FlowKey &mask,
+                                  uint16_t priority)
+{
+  // The rule is kept in some node in the path to the leaf covering the point
+  // given by the rule values, or in the pending list.
+  uint32_t fields [N_FIELDS];
+  for (uint32_t f = 0; f < N_FIELDS; f++)
+    {
+      fields [f] = GetField (value, f);
+    }
+
+  struct flow_entry *entry = FindNode (fields, 0, value, mask, priority);
+  return entry ? entry : FindRule (m_pending, value, mask, priority);
+}
+
+struct flow_entry*
+OFSwitch13TreeClassifier::DoLookup (const OFSwitch13FlowKey &key)
+{
+  uint32_t fields [N_FIELDS];
+  for (uint32_t f = 0; f < N_FIELDS; f++)
+    {
+      fields [f] = GetField (key, f);
+    }
+  struct flow_entry *best = SearchNode (key, fields, 0, 0);
+  return SearchRules (key, m_pending, best);
+}
+
+void
+OFSwitch13TreeClassifier::DoClear (void)
+{
+  m_rules.clear ();
+  m_nodes.assign (1, Node ());
+  m_pending.clear ();
+  m_index.clear ();
+  m_nTree = 0;
+  m_nDead = 0;
+  m_depth = 0;
+}
+
+void
+OFSwitch13TreeClassifier::DoUpdate (void)
+{
+  // Rebuild the tree when too many rules are out of it.
+  uint32_t limit = m_nTree / 8;
+  if (limit < LEAF_SIZE)
+    {
+      limit = LEAF_SIZE;
+    }
+  if (m_pending.size () + m_nDead > limit)
+    {
+      Rebuild ();
+    }
+}
+
+uint32_t
+OFSwitch13TreeClassifier::GetField (const OFSwitch13FlowKey &key,
+                                    uint32_t field)
+{
+  switch (field)
+    {
+    case 0:
+      return key.inPort;
+    case 1:
+      return key.ethType;
+    case 2:
+      return (key.nwSrc [0] << 24) | (key.nwSrc [1] << 16) |
+             (key.nwSrc [2] << 8) | key.nwSrc [3];
+    case 3:
+      return (key.nwDst [0] << 24) | (key.nwDst [1] << 16) |
+             (key.nwDst [2] << 8) | key.nwDst [3];
+    case 4:
+      return key.ipProto;
+    case 5:
+      return key.l4Src;
+    default:
+      return key.l4Dst;
+    }
+}
+
+void
+OFSwitch13TreeClassifier::Rebuild (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // Drop the dead rules and sort the live ones by decreasing priority,
+  // keeping the insertion order among rules with the same priority.
+  std::vector<Rule> rules;
+  std::vector<std::pair<uint32_t, uint32_t> > order;
+  rules.reserve (m_index.size ());
+  for (auto const &rule : m_rules)
+    {
+      if (rule.entry)
+        {
+          m_index [rule.entry] = rules.size ();
+          order.push_back (std::make_pair (0xffff - rule.priority,
+                                           rules.size ()));
+          rules.push_back (rule);
+        }
+    }
+  m_rules.swap (rules);
+  std::sort (order.begin (), order.end ());
+  RuleList_t root;
+  root.reserve (order.size ());
+  for (auto const &it : order)
+    {
+      root.push_back (it.second);
+    }
+
+  Region region;
+  for (uint32_t f = 0; f < N_FIELDS; f++)
+    {
+      region.lo [f] = 0;
+      region.bits [f] = g_treeFieldBits [f];
+    }
+  m_nodes.assign (1, Node ());
+  m_pending.clear ();
+  m_nTree = root.size ();
+  m_nDead = 0;
+  m_depth = 0;
+  BuildNode (0, root, region, 0);
+  NS_LOG_DEBUG ("Decision tree built with " << m_nTree << " entries, " <<
+                m_nodes.size () << " nodes, and depth " << m_depth << ".");
+}
+
+void
+OFSwitch13TreeClassifier::BuildNode (uint32_t idx, const RuleList_t &rules,
+                                     const Region &region, uint32_t depth)
+{
+  if (depth > m_depth)
+    {
+      m_depth = depth;
+    }
+  m_nodes [idx].maxPriority = rules.empty () ? 0 :
+    m_rules [rules.front ()].priority;
+  if (rules.size () <= LEAF_SIZE)
+    {
+      m_nodes [idx].rules = rules;
+      return;
+    }
+
+  // Choose the field with the most distinct rule ranges inside the region.
+  uint32_t field = N_FIELDS;
+  size_t maxDistinct = 1;
+  std::vector<std::pair<uint32_t, uint32_t> > ranges;
+  for (uint32_t f = 0; f < N_FIELDS; f++)
+    {
+      if (!region.bits [f])
+        {
+          continue;
+        }
+      uint64_t lo = region.lo [f];
+      uint64_t hi = lo + (1ULL << region.bits [f]) - 1;
+      ranges.clear ();
+      for (auto const &r : rules)
+        {
+          ranges.push_back (std::make_pair (
+                              std::max<uint64_t> (m_rules [r].lo [f], lo),
+                              std::min<uint64_t> (m_rules [r].hi [f], hi)));
+        }
+      std::sort (ranges.begin (), ranges.end ());
+      size_t distinct = std::unique (ranges.begin (), ranges.end ()) -
+        ranges.begin ();
+      if (distinct > maxDistinct)
+        {
+          maxDistinct = distinct;
+          field = f;
+        }
+    }
+  if (field == N_FIELDS)
+    {
+      m_nodes [idx].rules = rules;
+      return;
+    }
+
+  // Choose the largest number of cuts keeping the rules replicated over the
+  // children (plus the children themselves) within the space factor. Rules
+  // covering the whole region are kept in this node and are not replicated.
+  uint64_t lo = region.lo [field];
+  uint64_t hi = lo + (1ULL << region.bits [field]) - 1;
+  uint32_t cutBits = 1;
+  while (cutBits < region.bits [field] && (2U << cutBits) <= MAX_CUTS)
+    {
+      uint32_t shift = region.bits [field] - cutBits - 1;
+      uint64_t replicas = 2U << cutBits;
+      for (auto const &r : rules)
+        {
+          uint64_t first = std::max<uint64_t> (m_rules [r].lo [field], lo);
+          uint64_t last = std::min<uint64_t> (m_rules [r].hi [field], hi);
+          if (first != lo || last != hi)
+            {
+              replicas += ((last - lo) >> shift) - ((first - lo) >> shift) + 1;
+            }
+        }
+      if (replicas > m_spaceFactor * rules.size ())
+        {
+          break;
+        }
+      cutBits++;
+    }
+
+  // Split the rules among the children. Rules covering all children are
+  // kept in this node (they would be replicated into the whole subtree).
+  // Children fully covered by all their rules in this field are never cut
+  // again in this field, so adjacent children of this kind with the same
+  // rules can share the same subtree.
+  uint32_t nCuts = 1 << cutBits;
+  uint32_t shift = region.bits [field] - cutBits;
+  RuleList_t common;
+  std::vector<RuleList_t> parts (nCuts);
+  std::vector<bool> full (nCuts, true);
+  for (auto const &r : rules)
+    {
+      uint64_t first = std::max<uint64_t> (m_rules [r].lo [field], lo);
+      uint64_t last = std::min<uint64_t> (m_rules [r].hi [field], hi);
+      if (first == lo && last == hi)
+        {
+          common.push_back (r);
+          continue;
+        }
+      for (uint64_t c = (first - lo) >> shift; c <= (last - lo) >> shift; c++)
+        {
+          parts [c].push_back (r);
+          uint64_t childLo = lo + (c << shift);
+          uint64_t childHi = childLo + (1ULL << shift) - 1;
+          if (m_rules [r].lo [field] > childLo
+              || m_rules [r].hi [field] < childHi)
+            {
+              full [c] = false;
+            }
+        }
+    }
+  if (common.size () == rules.size ())
+    {
+      m_nodes [idx].rules = rules;
+      return;
+    }
+
+  // Too many rules kept in this node are split by a side subtree over the
+  // same region (cutting other fields).
+  if (common.size () <= LEAF_SIZE)
+    {
+      m_nodes [idx].rules = common;
+    }
+  else
+    {
+      uint32_t side = m_nodes.size ();
+      m_nodes.push_back (Node ());
+      m_nodes [idx].side = side;
+      BuildNode (side, common, region, depth + 1);
+    }
+  m_nodes [idx].field = field;
+  m_nodes [idx].shift = shift;
+  m_nodes [idx].cutMask = nCuts - 1;
+  m_nodes [idx].children.resize (nCuts);
+  for (uint32_t c = 0; c < nCuts; c++)
+    {
+      if (c && full [c] && full [c - 1] && parts [c] == parts [c - 1])
+        {
+          m_nodes [idx].children [c] = m_nodes [idx].children [c - 1];
+          continue;
+        }
+      uint32_t child = m_nodes.size ();
+      m_nodes.push_back (Node ());
+      m_nodes [idx].children [c] = child;
+
+      Region sub = region;
+      sub.lo [field] = lo + (c << shift);
+      sub.bits [field] = shift;
+      BuildNode (child, parts [c], sub, depth + 1);
+    }
+}
+
+struct flow_entry*
+OFSwitch13TreeClassifier::FindNode (const uint32_t *fields, uint32_t idx,
+                                    const OFSwitch13FlowKey &value,
+                                    const OFSwitch13FlowKey &mask,
+                                    uint16_t priority) const
+{
+  while (true)
+    {
+      const Node &node = m_nodes [idx];
+      struct flow_entry *entry = FindRule (node.rules, value, mask, priority);
+      if (!entry && node.side)
+        {
+          entry = FindNode (fields, node.side, value, mask, priority);
+        }
+      if (entry || !node.cutMask)
+        {
+          return entry;
+        }
+      idx = node.children [(fields [node.field] >> node.shift) & node.cutMask];
+    }
+}
+
+struct flow_entry*
+OFSwitch13TreeClassifier::FindRule (const RuleList_t &rules,
+                                    const OFSwitch13FlowKey &value,
+                                    const OFSwitch13FlowKey &mask,
+                                    uint16_t priority) const
+{
+  for (auto const &idx : rules)
+    {
+      const Rule &rule = m_rules [idx];
+      if (rule.entry && rule.priority == priority && rule.mask == mask
+          && rule.value == value)
+        {
+          return rule.entry;
+        }
+    }
+  return 0;
+}
+
+struct flow_entry*
+OFSwitch13TreeClassifier::SearchNode (const OFSwitch13FlowKey &key,
+                                      const uint32_t *fields, uint32_t idx,
+                                      struct flow_entry *best) const
+{
+  // Walk down the tree searching the rules kept in each node (and in side
+  // subtrees), skipping the subtrees that can't beat the best match.
+  while (true)
+    {
+      const Node &node = m_nodes [idx];
+      if (best && node.maxPriority <= best->stats->priority)
+        {
+          return best;
+        }
+      if (node.side)
+        {
+          best = SearchNode (key, fields, node.side, best);
+        }
+      best = SearchRules (key, node.rules, best);
+      if (!node.cutMask)
+        {
+          return best;
+        }
+      idx = node.children [(fields [node.field] >> node.shift) & node.cutMask];
+    }
+}
+
+struct flow_entry*
+OFSwitch13TreeClassifier::SearchRules (const OFSwitch13FlowKey &key,
+                                       const RuleList_t &rules,
+                                       struct flow_entry *best) const
+{
+  for (auto const &idx : rules)
+    {
+      const Rule &rule = m_rules [idx];
+      if (best && rule.priority <= best->stats->priority)
+        {
+          break;
+        }
+      if (rule.entry && KeyMatches (rule.value, rule.mask, key))
+        {
+          return rule.entry;
+        }
+    }
+  return best;
+}
+
+} // namespace ns3
@@ -0,0 +1,743 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+#ifndef OFSWITCH13_CLASSIFIER_H
+#define OFSWITCH13_CLASSIFIER_H
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <ns3/simple-ref-count.h>
+#include "ofswitch13-interface.h"
+#include "ofswitch13-flow-key.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup ofswitch13
+ *
+ * Base class for a packet classifier indexing the entries of an OpenFlow flow
+ * table, used by the OFSwitch13Device in place of the linear search performed
+ * by the ofsoftswitch13 flow_table_lookup () function.
+ *
+ * The classifier holds pointers to the flow entries that belong to the
+ * ofsoftswitch13 flow table, but it is not notified when the library removes
+ * entries from the table. So, the device must remove the entries from the
+ * classifier before the library frees them, or invalidate the classifier on
+ * any other flow table change, in which case the classifier is rebuilt from
+ * the flow table on the next lookup.
+ *
+ * Entries are indexed by the flow key (see OFSwitch13FlowKey) built from
+ * their match fields. Entries with match fields that can't be represented by
+ * the flow key, or that can't be indexed by the classifier algorithm, are
+ * kept in a separated list that is searched linearly. As the flow key holds
+ * all the match fields of indexed entries (including the protocol layers),
+ * indexed entries are matched by masked word comparisons against the packet
+ * flow key, and only the entries in the linear list need the library match
+ * function (and the packet match structure validated by the library). So,
+ * the lookup result is the same of the linear search (except for the order
+ * among overlapping entries with the same priority, which is undefined by
+ * the OpenFlow specification).
+ */
+class OFSwitch13Classifier : public SimpleRefCount<OFSwitch13Classifier>
+{
+public:
+  OFSwitch13Classifier ();          //!< Default constructor.
+  virtual ~OFSwitch13Classifier (); //!< Dummy destructor.
+
+  /**
+   * Clear the classifier and insert all entries from the flow table.
+   * \param table The flow table.
+   */
+  void Build (struct flow_table *table);
+
+  /** Remove all entries from the classifier, invalidating it. */
+  void Clear (void);
+
+  /**
+   * Insert a new flow entry into the classifier.
+   * \param entry The flow entry.
+   */
+  void Insert (struct flow_entry *entry);
+
+  /**
+   * Remove a flow entry from the classifier. This must be called before the
+   * entry is freed by the library.
+   * \param entry The flow entry.
+   */
+  void Remove (struct flow_entry *entry);
+
+  /**
+   * Look for the flow entry with exactly this match and priority.
+   * \param match The match structure.
+   * \param priority The entry priority.
+   * \return The flow entry, or 0 if not found.
+   */
+  struct flow_entry* Find (struct ofl_match_header *match, uint16_t priority);
+
+  /**
+   * Look for the highest priority flow entry matching the packet. This
+   * function doesn't update the flow table and flow entry counters.
+   * \param pkt The packet.
+   * \return The matching entry, or 0 if not found.
+   */
+  struct flow_entry* Lookup (struct packet *pkt);
+
+  /**
+   * Look for the highest priority flow entry matching the packet, using the
+   * flow key already extracted from the packet headers. The packet match
+   * structure is only validated when entries in the linear list must be
+   * checked. This function doesn't update the flow table and flow entry
+   * counters.
+   * \param pkt The packet.
+   * \param key The flow key with the packet header field values.
+   * \return The matching entry, or 0 if not found.
+   */
+  struct flow_entry* Lookup (struct packet *pkt, const OFSwitch13FlowKey &key);
+
+  /**
+   * Check whether the classifier is in sync with the flow table.
+   * \return true if the classifier is valid.
+   */
+  bool IsValid (void) const;
+
+  /**
+   * Perform the deferred maintenance of the classifier structures after
+   * insertions and removals. This is called by the device on datapath
+   * timeouts, out of the packet lookups.
+   */
+  void Update (void);
+
+  /**
+   * \name Classifier size accessors.
+   * \return The requested value.
+   */
+  //\{
+  uint32_t GetNEntries  (void) const;
+  uint32_t GetNLinear   (void) const;
+  //\}
+
+protected:
+  /** Structure to save a list of flow entries. */
+  typedef std::vector<struct flow_entry*> EntryList_t;
+
+  /**
+   * Insert the flow entry into the classifier structures.
+   * \param entry The flow entry.
+   * \param value The flow key with the (masked) match field values.
+   * \param mask The flow key mask with the match field bits.
+   * \return false if the entry can't be indexed by the classifier (in this
+   *         case it will be searched linearly).
+   */
+  virtual bool DoInsert (struct flow_entry *entry,
+                         const OFSwitch13FlowKey &value,
+                         const OFSwitch13FlowKey &mask) = 0;
+
+  /**
+   * Remove the flow entry from the classifier structures.
+   * \param entry The flow entry.
+   * \param value The flow key with the (masked) match field values.
+   * \param mask The flow key mask with the match field bits.
+   * \return false if the entry was not indexed by the classifier.
+   */
+  virtual bool DoRemove (struct flow_entry *entry,
+                         const OFSwitch13FlowKey &value,
+                         const OFSwitch13FlowKey &mask) = 0;
+
+  /**
+   * Look for the indexed flow entry with exactly this match and priority.
+   * \param value The flow key with the (masked) match field values.
+   * \param mask The flow key mask with the match field bits.
+   * \param priority The entry priority.
+   * \return The flow entry, or 0 if not found.
+   */
+  virtual struct flow_entry* DoFind (const OFSwitch13FlowKey &value,
+                                     const OFSwitch13FlowKey &mask,
+                                     uint16_t priority) = 0;
+
+  /**
+   * Look for the highest priority indexed flow entry matching the packet.
+   * \param key The flow key with the packet header field values.
+   * \return The matching entry, or 0 if not found.
+   */
+  virtual struct flow_entry* DoLookup (const OFSwitch13FlowKey &key) = 0;
+
+  /** Remove all entries from the classifier structures. */
+  virtual void DoClear (void) = 0;
+
+  /**
+   * Perform the deferred maintenance of the classifier structures. The
+   * default implementation does nothing.
+   */
+  virtual void DoUpdate (void);
+
+  /**
+   * Check if the flow entry matches the packet, using the library function.
+   * The packet match structure is validated when necessary.
+   * \param pkt The packet.
+   * \param entry The flow entry.
+   * \return true if the entry matches the packet.
+   */
+  static bool Matches (struct packet *pkt, struct flow_entry *entry);
+
+  /**
+   * Check if the flow key matches the flow entry keys.
+   * \param value The flow key with the (masked) match field values.
+   * \param mask The flow key mask with the match field bits.
+   * \param key The flow key with the packet header field values.
+   * \return true if the masked key is equal to the entry value.
+   */
+  static bool KeyMatches (const OFSwitch13FlowKey &value,
+                          const OFSwitch13FlowKey &mask,
+                          const OFSwitch13FlowKey &key);
+
+  /**
+   * Check if the flow entry has exactly this match, using the library
+   * function.
+   * \param entry The flow entry.
+   * \param match The match structure.
+   * \return true if the entry has the same match.
+   */
+  static bool StrictMatches (struct flow_entry *entry,
+                             struct ofl_match_header *match);
+
+  /**
+   * Build the flow keys from the flow entry match.
+   * \param entry The flow entry.
+   * \param value The flow key to hold the (masked) match field values.
+   * \param mask The flow key mask to hold the match field bits.
+   * \return false if the match can't be represented by flow keys.
+   */
+  static bool GetKeys (struct flow_entry *entry, OFSwitch13FlowKey &value,
+                       OFSwitch13FlowKey &mask);
+
+  /**
+   * Insert the flow entry into the list, keeping the list sorted by
+   * decreasing priority. New entries are placed after those with the same
+   * priority, just like the ofsoftswitch13 flow table does.
+   * \param list The list of flow entries.
+   * \param entry The flow entry.
+   */
+  static void InsertSorted (EntryList_t &list, struct flow_entry *entry);
+
+  /**
+   * Remove the flow entry from the list.
+   * \param list The list of flow entries.
+   * \param entry The flow entry.
+   * \return false if the entry is not in the list.
+   */
+  static bool RemoveFrom (EntryList_t &list, struct flow_entry *entry);
+
+  /**
+   * Look for the first entry in the sorted list matching the packet with
+   * priority higher than the current best entry.
+   * \param pkt The packet.
+   * \param list The list of flow entries sorted by decreasing priority.
+   * \param best The current best entry (may be 0).
+   * \return The new best entry.
+   */
+  static struct flow_entry* SearchSorted (struct packet *pkt,
+                                          const EntryList_t &list,
+                                          struct flow_entry *best);
+
+private:
+  EntryList_t         m_linear;     //!< Entries searched linearly.
+  uint32_t            m_nEntries;   //!< Number of entries.
+  bool                m_valid;      //!< Classifier in sync with flow table.
+}; // Class OFSwitch13Classifier
+
+
+/**
+ * \ingroup ofswitch13
+ *
+ * Tuple space search classifier for wildcard flow tables. Flow entries are
+ * grouped into subtables by their match mask, and each subtable is a hash
+ * table indexed by the masked flow key. A lookup probes the subtables in
+ * decreasing order of the highest entry priority on each one, and stops as
+ * soon as the next subtables can't hold entries with higher priority than
+ * the best match found so far. So, the lookup cost depends on the number of
+ * distinct masks in the table, not on the number of entries.
+ */
+class OFSwitch13TssClassifier : public OFSwitch13Classifier
+{
+public:
+  OFSwitch13TssClassifier ();           //!< Default constructor.
+  virtual ~OFSwitch13TssClassifier ();  //!< Dummy destructor.
+
+  /**
+   * Get the number of subtables (distinct masks) in the classifier.
+   * \return The number of subtables.
+   */
+  uint32_t GetNSubtables (void) const;
+
+protected:
+  // Inherited from OFSwitch13Classifier.
+  bool DoInsert (struct flow_entry *entry, const OFSwitch13FlowKey &value,
+                 const OFSwitch13FlowKey &mask);
+  bool DoRemove (struct flow_entry *entry, const OFSwitch13FlowKey &value,
+                 const OFSwitch13FlowKey &mask);
+  struct flow_entry* DoFind (const OFSwitch13FlowKey &value,
+                             const OFSwitch13FlowKey &mask,
+                             uint16_t priority);
+  struct flow_entry* DoLookup (const OFSwitch13FlowKey &key);
+  void DoClear (void);
+
+private:
+  /** Structure to map masked flow keys to entries sorted by priority. */
+  typedef std::unordered_map<OFSwitch13FlowKey, EntryList_t,
+                             OFSwitch13FlowKey::Hasher> KeyEntryMap_t;
+
+  /** Subtable holding entries that share the same mask. */
+  struct Subtable
+  {
+    OFSwitch13FlowKey   mask;         //!< The subtable mask.
+    uint16_t            maxPriority;  //!< The highest entry priority (an
+                                      //!< upper bound after removals).
+    KeyEntryMap_t       entries;      //!< Entries indexed by masked keys.
+  };
+
+  /** Structure to save the list of subtables. */
+  typedef std::vector<Subtable> SubtableList_t;
+
+  /**
+   * Get the subtable for this mask.
+   * \param mask The subtable mask.
+   * \return The subtable index, or the number of subtables if not found.
+   */
+  size_t FindSubtable (const OFSwitch13FlowKey &mask) const;
+
+  SubtableList_t      m_subtables;  //!< Subtables by decreasing priority.
+}; // Class OFSwitch13TssClassifier
+
+
+/**
+ * \ingroup ofswitch13
+ *
+ * Exact-match classifier for flow tables whose entries match a fixed set of
+ * header fields without masks (e.g., L2 tables matching the Ethernet
+ * destination address, or tunnel tables matching the tunnel ID). Entries are
+ * saved into a hash table keyed on the hash of the flow key, so lookups,
+ * insertions, and removals take constant time. Entries in the same bucket
+ * (with colliding hashes or with the same field values and other priorities)
+ * are chained by decreasing priority. Each slot only holds the key hash, the
+ * flow entry pointer, and the next slot in the chain (the entry keys are
+ * rebuilt from its match to confirm hash matches), keeping the memory
+ * footprint small for large tables (24 bytes per entry, plus 4 bytes per
+ * bucket, with at most one bucket per entry after growing).
+ *
+ * The field set is configured for each flow table (see SetFields ()). The
+ * table-miss entry and any other entries that can't be saved into the hash
+ * table (all entries when no field set is configured) are searched linearly.
+ * The device uses CheckMatch () to reject flow mods adding entries that don't
+ * fit into the hash table.
+ */
+class OFSwitch13ExactClassifier : public OFSwitch13Classifier
+{
+public:
+  OFSwitch13ExactClassifier ();           //!< Default constructor.
+  virtual ~OFSwitch13ExactClassifier ();  //!< Dummy destructor.
+
+  /**
+   * Set the field set of the entries saved into the hash table. This clears
+   * the classifier, so it's rebuilt from the flow table.
+   * \param fields The OXM headers of the fields (e.g., OXM_OF_ETH_DST),
+   *        including the prerequisite fields (e.g., OXM_OF_ETH_TYPE for IPv4
+   *        addresses). An empty list removes the field set.
+   * \return false if the fields can't be indexed by the classifier (in this
+   *         case, no field set is configured).
+   */
+  bool SetFields (const std::vector<uint32_t> &fields);
+
+  /**
+   * Check if a new entry with this match fits into the hash table. Only the
+   * table-miss match (no fields) and matches with the configured field set,
+   * without masks, are accepted (any match is accepted when no field set is
+   * configured). When the flow mod asks for the overlap check, an entry with
+   * the same field values and priority is reported as overlapping, as done
+   * by the library.
+   * \param match The match structure.
+   * \param priority The entry priority.
+   * \param flags The flow mod flags.
+   * \return 0 if the match is accepted, otherwise the OpenFlow error.
+   */
+  ofl_err CheckMatch (struct ofl_match_header *match, uint16_t priority,
+                      uint16_t flags) const;
+
+  /**
+   * \name Hash table size accessors.
+   * \return The requested value.
+   */
+  //\{
+  uint32_t GetNBuckets    (void) const;
+  uint32_t GetNUsedSlots  (void) const;
+  //\}
+
+protected:
+  // Inherited from OFSwitch13Classifier.
+  bool DoInsert (struct flow_entry *entry, const OFSwitch13FlowKey &value,
+                 const OFSwitch13FlowKey &mask);
+  bool DoRemove (struct flow_entry *entry, const OFSwitch13FlowKey &value,
+                 const OFSwitch13FlowKey &mask);
+  struct flow_entry* DoFind (const OFSwitch13FlowKey &value,
+                             const OFSwitch13FlowKey &mask,
+                             uint16_t priority);
+  struct flow_entry* DoLookup (const OFSwitch13FlowKey &key);
+  void DoClear (void);
+
+private:
+  /** Hash table slot (released when the entry is 0). */
+  struct Slot
+  {
+    size_t              hash;     //!< The flow key hash.
+    struct flow_entry*  entry;    //!< The flow entry.
+    uint32_t            next;     //!< Next slot in the chain (0 for none).
+  };
+
+  /**
+   * Link the slot into the chain of its bucket, keeping the chain sorted by
+   * decreasing priority.
+   * \param idx The slot index.
+   */
+  void Link (uint32_t idx);
+
+  /** Double the number of buckets, relinking the slots. */
+  void Grow (void);
+
+  std::vector<uint32_t> m_buckets;  //!< First slot of each bucket (power of
+                                    //!< two, 0 for empty buckets).
+  std::vector<Slot>   m_slots;      //!< Slots (index 0 is unused).
+  uint32_t            m_free;       //!< First released slot (0 for none).
+  uint32_t            m_nUsed;      //!< Number of used slots.
+  bool                m_hasFields;  //!< The field set is configured.
+  OFSwitch13FlowKey   m_mask;       //!< The field set.
+}; // Class OFSwitch13ExactClassifier
+
+
+/**
+ * \ingroup ofswitch13
+ *
+ * Longest prefix match classifier for routing tables whose entries match the
+ * IPv4 or IPv6 destination address with prefix masks (besides the mandatory
+ * Ethernet type). These entries are saved into multibit tries with 8-bit
+ * strides (one trie for each IP version), so a lookup visits at most 4 (IPv4)
+ * or 16 (IPv6) trie nodes, regardless of the number of prefixes in the table.
+ *
+ * Each trie node covers one byte of the address and holds the prefixes whose
+ * last bit falls into this byte. The prefixes are expanded into the 256 node
+ * slots, and each slot caches the highest priority entry among the node
+ * prefixes covering it. The lookup keeps the highest priority entry found
+ * while walking down the trie (the longest prefix wins among entries with the
+ * same priority), so priorities don't need to follow prefix lengths.
+ *
+ * Entries that don't fit into the tries (e.g., the table-miss entry or
+ * entries matching other fields) are indexed by the tuple space search
+ * classifier.
+ */
+class OFSwitch13LpmClassifier : public OFSwitch13TssClassifier
+{
+public:
+  OFSwitch13LpmClassifier ();           //!< Default constructor.
+  virtual ~OFSwitch13LpmClassifier ();  //!< Default destructor.
+
+  /**
+   * \name Trie size accessors.
+   * \return The requested value.
+   */
+  //\{
+  uint32_t GetNPrefixes   (void) const;
+  uint32_t GetNNodes      (void) const;
+  //\}
+
+protected:
+  // Inherited from OFSwitch13Classifier.
+  bool DoInsert (struct flow_entry *entry, const OFSwitch13FlowKey &value,
+                 const OFSwitch13FlowKey &mask);
+  bool DoRemove (struct flow_entry *entry, const OFSwitch13FlowKey &value,
+                 const OFSwitch13FlowKey &mask);
+  struct flow_entry* DoFind (const OFSwitch13FlowKey &value,
+                             const OFSwitch13FlowKey &mask,
+                             uint16_t priority);
+  struct flow_entry* DoLookup (const OFSwitch13FlowKey &key);
+  void DoClear (void);
+
+private:
+  /** Prefix ending in a trie node. */
+  struct Prefix
+  {
+    EntryList_t         entries;      //!< Entries sorted by priority.
+    uint16_t            index;        //!< Index in the node list of fronts.
+  };
+
+  /**
+   * Structure to map prefix keys to prefixes. The key holds the first node
+   * slot covered by the prefix followed by the number of prefix bits in the
+   * node (4 bits), so the map is sorted in trie preorder.
+   */
+  typedef std::map<uint16_t, Prefix> PrefixMap_t;
+
+  /** Trie node for one address byte. */
+  struct Node
+  {
+    uint16_t            best [256];   //!< Highest priority covering entry
+                                      //!< (index in fronts + 1, 0 for none).
+    std::vector<uint32_t> children;   //!< Child node indexes (0 for none,
+                                      //!< empty for leaf nodes).
+    std::vector<struct flow_entry*> fronts; //!< First entry of each prefix.
+    PrefixMap_t         prefixes;     //!< Prefixes ending in this node.
+    uint32_t            nChildren;    //!< Number of child nodes.
+  };
+
+  /**
+   * Get the trie and the prefix for a flow entry, when it fits into a trie.
+   * \param value The flow key with the (masked) match field values.
+   * \param mask The flow key mask with the match field bits.
+   * \param addr The pointer to hold the (masked) address bytes.
+   * \param length The prefix length.
+   * \return The trie index (0 for IPv4 and 1 for IPv6), or -1 if the entry
+   *         doesn't fit into a trie.
+   */
+  static int GetPrefix (const OFSwitch13FlowKey &value,
+                        const OFSwitch13FlowKey &mask, const uint8_t **addr,
+                        uint32_t &length);
+
+  /**
+   * Get the key identifying the prefix in the trie node holding its last bit.
+   * \param addr The (masked) address bytes.
+   * \param length The prefix length.
+   * \param depth The node depth.
+   * \return The prefix key.
+   */
+  static uint16_t GetPrefixKey (const uint8_t *addr, uint32_t length,
+                                uint32_t &depth);
+
+  /**
+   * Allocate a new trie node, reusing released node indexes when possible.
+   * \return The node index.
+   */
+  uint32_t NewNode (void);
+
+  /**
+   * Update the node slots covered by this prefix after a change in the list
+   * of entries for this prefix.
+   * \param node The trie node.
+   * \param key The prefix key.
+   */
+  static void UpdateSlots (Node &node, uint16_t key);
+
+  std::vector<Node*>  m_nodes;      //!< Trie nodes (index 0 is unused).
+  std::vector<uint32_t> m_free;     //!< Released node indexes.
+  uint32_t            m_roots [2];  //!< IPv4 and IPv6 trie roots.
+  uint32_t            m_nPrefixes;  //!< Number of entries in the tries.
+}; // Class OFSwitch13LpmClassifier
+
+
+/**
+ * \ingroup ofswitch13
+ *
+ * Decision tree classifier (HiCuts) for ACL tables with overlapping ranges
+ * and wildcards across many fields, where the number of distinct masks makes
+ * the tuple space search slow. The tree cuts the space of the input port,
+ * Ethernet type, IPv4 source and destination addresses, IP protocol, and L4
+ * source and destination ports. Each internal node cuts its region along one
+ * field into equal-sized children (sibling children with the same entries are
+ * merged), and each leaf holds a short list of entries sorted by priority.
+ * Entries covering all children of a node are kept in the node instead of
+ * being replicated into the children (as in HyperCuts), and too many of them
+ * are split by a side subtree cutting other fields.
+ * The field to cut is the one with the most distinct entry ranges, and the
+ * number of cuts is the largest one keeping the entries replicated over the
+ * children within the space factor (the memory/lookup time trade-off). Other
+ * fields in the entries are checked by comparing the masked flow keys.
+ *
+ * The tree is built with the classifier. Later insertions are kept into a
+ * pending list searched linearly, and removed entries are marked as dead in
+ * the tree. The tree is rebuilt on the next classifier update (on datapath
+ * timeouts) when the number of pending and dead entries gets too large, so
+ * packet lookups never pay for the tree build.
+ */
+class OFSwitch13TreeClassifier : public OFSwitch13Classifier
+{
+public:
+  /**
+   * Complete constructor.
+   * \param spaceFactor The maximum ratio between the number of entries in the
+   *        children (plus the number of children) and the number of entries
+   *        in the node being cut.
+   */
+  OFSwitch13TreeClassifier (double spaceFactor = 4);
+  virtual ~OFSwitch13TreeClassifier ();  //!< Dummy destructor.
+
+  /**
+   * \name Decision tree accessors.
+   * \return The requested value.
+   */
+  //\{
+  uint32_t GetDepth       (void) const;
+  uint32_t GetNNodes      (void) const;
+  uint32_t GetNPending    (void) const;
+  double   GetSpaceFactor (void) const;
+  //\}
+
+protected:
+  // Inherited from OFSwitch13Classifier.
+  bool DoInsert (struct flow_entry *entry, const OFSwitch13FlowKey &value,
+                 const OFSwitch13FlowKey &mask);
+  bool DoRemove (struct flow_entry *entry, const OFSwitch13FlowKey &value,
+                 const OFSwitch13FlowKey &mask);
+  struct flow_entry* DoFind (const OFSwitch13FlowKey &value,
+                             const OFSwitch13FlowKey &mask,
+                             uint16_t priority);
+  struct flow_entry* DoLookup (const OFSwitch13FlowKey &key);
+  void DoClear (void);
+  void DoUpdate (void);
+
+private:
+  /** Number of fields cut by the tree. */
+  static const uint32_t N_FIELDS = 7;
+
+  /** Maximum number of entries in a leaf. */
+  static const uint32_t LEAF_SIZE = 8;
+
+  /** Maximum number of cuts in a node. */
+  static const uint32_t MAX_CUTS = 256;
+
+  /** Structure to save a list of rule indexes. */
+  typedef std::vector<uint32_t> RuleList_t;
+
+  /** Flow entry indexed by the tree. */
+  struct Rule
+  {
+    struct flow_entry*  entry;        //!< The flow entry (0 when dead).
+    uint16_t            priority;     //!< The entry priority.
+    OFSwitch13FlowKey   value;        //!< The (masked) match field values.
+    OFSwitch13FlowKey   mask;         //!< The match field bits.
+    uint32_t            lo [N_FIELDS]; //!< Lowest value for each field.
+    uint32_t            hi [N_FIELDS]; //!< Highest value for each field.
+  };
+
+  /** Decision tree node. */
+  struct Node
+  {
+    uint8_t             field;        //!< The field cut by this node.
+    uint8_t             shift;        //!< Bits of the child region size.
+    uint16_t            maxPriority;  //!< Highest rule priority in the
+                                      //!< subtree (an upper bound).
+    uint32_t            cutMask;      //!< Number of cuts - 1 (0 for leaves).
+    uint32_t            side;         //!< Side subtree index (0 for none).
+    RuleList_t          children;     //!< Child node indexes.
+    RuleList_t          rules;        //!< Rules covering all the node
+                                      //!< region in the cut field (or all
+                                      //!< rules for leaves), by priority.
+  };
+
+  /** Region of the field space covered by a node. */
+  struct Region
+  {
+    uint32_t            lo [N_FIELDS];   //!< Lowest value for each field.
+    uint8_t             bits [N_FIELDS]; //!< Bits of the region size.
+  };
+
+  /**
+   * Get the value of a tree field from the flow key.
+   * \param key The flow key.
+   * \param field The field index.
+   * \return The field value.
+   */
+  static uint32_t GetField (const OFSwitch13FlowKey &key, uint32_t field);
+
+  /** Rebuild the tree with all live rules, cleaning the pending list. */
+  void Rebuild (void);
+
+  /**
+   * Build the (sub)tree for this node.
+   * \param idx The node index.
+   * \param rules The node rules sorted by priority.
+   * \param region The node region.
+   * \param depth The node depth.
+   */
+  void BuildNode (uint32_t idx, const RuleList_t &rules,
+                  const Region &region, uint32_t depth);
+
+  /**
+   * Look for the live rule with exactly these flow keys and priority in the
+   * subtree, following the path to the point given by the field values.
+   * \param fields The field values.
+   * \param idx The subtree root node index.
+   * \param value The flow key with the (masked) match field values.
+   * \param mask The flow key mask with the match field bits.
+   * \param priority The entry priority.
+   * \return The flow entry, or 0 if not found.
+   */
+  struct flow_entry* FindNode (const uint32_t *fields, uint32_t idx,
+                               const OFSwitch13FlowKey &value,
+                               const OFSwitch13FlowKey &mask,
+                               uint16_t priority) const;
+
+  /**
+   * Look for the live rule in the list with exactly these flow keys and
+   * priority.
+   * \param rules The list of rules.
+   * \param value The flow key with the (masked) match field values.
+   * \param mask The flow key mask with the match field bits.
+   * \param priority The entry priority.
+   * \return The flow entry, or 0 if not found.
+   */
+  struct flow_entry* FindRule (const RuleList_t &rules,
+                               const OFSwitch13FlowKey &value,
+                               const OFSwitch13FlowKey &mask,
+                               uint16_t priority) const;
+
+  /**
+   * Look for the highest priority live rule in the subtree matching the
+   * packet with priority higher than the current best entry.
+   * \param key The flow key with the packet header field values.
+   * \param fields The packet field values.
+   * \param idx The subtree root node index.
+   * \param best The current best entry (may be 0).
+   * \return The new best entry.
+   */
+  struct flow_entry* SearchNode (const OFSwitch13FlowKey &key,
+                                 const uint32_t *fields, uint32_t idx,
+                                 struct flow_entry *best) const;
+
+  /**
+   * Look for the first live rule in the sorted list matching the packet with
+   * priority higher than the current best entry.
+   * \param key The flow key with the packet header field values.
+   * \param rules The list of rules sorted by decreasing priority.
+   * \param best The current best entry (may be 0).
+   * \return The new best entry.
+   */
+  struct flow_entry* SearchRules (const OFSwitch13FlowKey &key,
+                                  const RuleList_t &rules,
+                                  struct flow_entry *best) const;
+
+  std::vector<Rule>   m_rules;        //!< Rules (including dead ones).
+  std::vector<Node>   m_nodes;        //!< Tree nodes (root at index 0).
+  RuleList_t          m_pending;      //!< Rules not in the tree yet.
+  std::unordered_map<struct flow_entry*, uint32_t> m_index; //!< Rule index.
+  uint32_t            m_nTree;        //!< Number of live rules in the tree.
+  uint32_t            m_nDead;        //!< Number of dead rules in the tree.
+  uint32_t            m_depth;        //!< Tree depth.
+  double              m_spaceFactor;  //!< Space factor.
+}; // Class OFSwitch13TreeClassifier
+
+} // namespace ns3
+#endif /* OFSWITCH13_CLASSIFIER_H */
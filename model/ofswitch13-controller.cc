@@ -67,6 +67,7 @@ OFSwitch13Controller::DoDispose ()
   m_echoMap.clear ();
   m_barrierMap.clear ();
   m_schedCommands.clear ();
+  m_bufPool.Clear ();
 
   Application::DoDispose ();
 }
@@ -579,7 +580,8 @@ OFSwitch13Controller::ReceiveFromSwitch (Ptr<Packet> packet, Address from)
   ofl_err error;
 
   // Get the openflow buffer, unpack the message and send to message handler
-  struct ofpbuf *buffer = ofs::BufferFromPacket (packet, packet->GetSize ());
+  struct ofpbuf *buffer = m_bufPool.BufferFromPacket (packet,
+                                                      packet->GetSize ());
   error = ofl_msg_unpack ((uint8_t*)buffer->data, buffer->size, &msg, &xid, 0);
 
   if (!error)
@@ -604,7 +606,7 @@ OFSwitch13Controller::ReceiveFromSwitch (Ptr<Packet> packet, Address from)
     {
       NS_LOG_ERROR ("Error processing OpenFlow message from switch.");
     }
-  ofpbuf_delete (buffer);
+  m_bufPool.Put (buffer);
 }
 
 Ptr<OFSwitch13Controller::RemoteSwitch>
@@ -24,6 +24,7 @@
 #include <ns3/application.h>
 #include <ns3/socket.h>
 #include "ofswitch13-interface.h"
+#include "ofswitch13-buffer-pool.h"
 #include "ofswitch13-socket-handler.h"
 #include <string>
 
@@ -387,6 +388,8 @@ private:
   BarrierMsgMap_t m_barrierMap;       //!< Metadata for barrier requests.
   DpIdCmdMap_t    m_schedCommands;    //!< Scheduled commands for execution.
   SwitchsMap_t    m_switchesMap;      //!< Registered switches metadata's.
+
+  OFSwitch13BufferPool m_bufPool;     //!< Control channel buffer pool.
 };
 
 } // namespace ns3
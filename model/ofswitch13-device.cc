@@ -18,7 +18,13 @@
  * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
  */
 
+#include <algorithm>
+#include <iterator>
+#include <ns3/boolean.h>
+#include <ns3/double.h>
+#include <ns3/enum.h>
 #include <ns3/object-vector.h>
+#include <ns3/pointer.h>
 #include "ofswitch13-device.h"
 #include "ofswitch13-port.h"
 
@@ -37,19 +43,40 @@ NS_OBJECT_ENSURE_REGISTERED (OFSwitch13Device);
 // Initializing OFSwitch13Device static members.
 uint64_t OFSwitch13Device::m_globalDpId = 0;
 uint64_t OFSwitch13Device::m_globalPktId = 0;
-OFSwitch13Device::DpIdDevMap_t OFSwitch13Device::m_globalSwitchMap;
+OFSwitch13Device::TagList_t OFSwitch13Device::m_tagPrototypes;
+OFSwitch13Device::TimeoutGroupMap_t OFSwitch13Device::m_timeoutGroups;
+OFSwitch13Device::DpIdDevList_t OFSwitch13Device::m_globalSwitchList;
 
 /********** Public methods **********/
 OFSwitch13Device::OFSwitch13Device ()
   : m_dpId (0),
+  m_groupIdx (0),
+  m_groupAwake (false),
   m_datapath (0),
+  m_bufferHead (0),
+  m_bufferTail (0),
+  m_bufferUsed (0),
   m_cpuConsumed (0),
   m_cpuTokens (0),
+  m_cpuTokensFrac (0),
+  m_cpuNumCores (1),
+  m_cpuQueueSize (0),
   m_cFlowMod (0),
   m_cGroupMod (0),
   m_cMeterMod (0),
   m_cPacketIn (0),
-  m_cPacketOut (0)
+  m_cPacketOut (0),
+  m_flowTimersSync (false),
+  m_evictPolicy (EVICT_NONE),
+  m_tierFastSize (0),
+  m_tierTables (false),
+  m_tierLookups (0),
+  m_tierFastHits (0),
+  m_tierSlowHits (0),
+  m_tcamDftSlices (0),
+  m_tcamUsedSync (true),
+  m_classDftType (CLASSIFIER_LINEAR),
+  m_treeSpace (4)
 {
   NS_LOG_FUNCTION (this);
   NS_LOG_INFO ("OpenFlow version: " << OFP_VERSION);
@@ -71,23 +98,117 @@ OFSwitch13Device::GetTypeId (void)
     .SetParent<Object> ()
     .SetGroupName ("OFSwitch13")
     .AddConstructor<OFSwitch13Device> ()
+    .AddAttribute ("BatchSize",
+                   "The maximum number of packets sent to pipeline by a "
+                   "single event (values higher than 1 enable the ingress "
+                   "batching mode).",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&OFSwitch13Device::m_batchSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("BatchWindow",
+                   "The ingress batching time window. Packets due within "
+                   "this window are sent to pipeline in advance by the same "
+                   "event. A zero window preserves the exact packet timing, "
+                   "only batching packets due at the same time (with "
+                   "different arrival times, this turns batching off).",
+                   TimeValue (Time (0)),
+                   MakeTimeAccessor (&OFSwitch13Device::m_batchWindow),
+                   MakeTimeChecker (Time (0)))
     .AddAttribute ("CpuCapacity",
                    "CPU processing capacity (in terms of throughput).",
                    DataRateValue (DataRate ("100Gb/s")),
                    MakeDataRateAccessor (&OFSwitch13Device::m_cpuCapacity),
                    MakeDataRateChecker ())
+    .AddAttribute ("CpuCoreRate",
+                   "The service rate of each CPU core (a zero rate evenly "
+                   "splits the CPU capacity among cores).",
+                   DataRateValue (DataRate (0)),
+                   MakeDataRateAccessor (&OFSwitch13Device::m_cpuCoreRate),
+                   MakeDataRateChecker ())
+    .AddAttribute ("CpuCores",
+                   "The number of CPU cores serving packets in parallel.",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&OFSwitch13Device::SetCpuCores,
+                                         &OFSwitch13Device::GetCpuCores),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("CpuQueueSize",
+                   "The maximum number of packets waiting for a free CPU core "
+                   "(a zero size disables the CPU ingress queue).",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&OFSwitch13Device::m_cpuQueueSize),
+                   MakeUintegerChecker<uint32_t> ())
     .AddAttribute ("DatapathId",
                    "The unique identification of this OpenFlow switch.",
                    TypeId::ATTR_GET,
                    UintegerValue (0),
                    MakeUintegerAccessor (&OFSwitch13Device::m_dpId),
                    MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("EvictionPolicy",
+                   "The flow table eviction policy, used to make room for new "
+                   "flow entries when a flow table is full.",
+                   EnumValue (OFSwitch13Device::EVICT_NONE),
+                   MakeEnumAccessor (&OFSwitch13Device::m_evictPolicy),
+                   MakeEnumChecker (
+                     OFSwitch13Device::EVICT_NONE,     "None",
+                     OFSwitch13Device::EVICT_LRU,      "Lru",
+                     OFSwitch13Device::EVICT_PACKETS,  "LeastPackets",
+                     OFSwitch13Device::EVICT_PRIORITY, "LowestPriority"))
+    .AddAttribute ("FlowCache",
+                   "Enable the exact-match flow cache in front of pipeline.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&OFSwitch13Device::m_cacheEnable),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FlowCacheMegaflow",
+                   "Enable the megaflow (wildcard) layer of the flow cache.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&OFSwitch13Device::m_cacheMega),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FlowCacheSize",
+                   "The maximum number of entries allowed on each flow cache "
+                   "layer.",
+                   UintegerValue (4096),
+                   MakeUintegerAccessor (&OFSwitch13Device::SetFlowCacheSize,
+                                         &OFSwitch13Device::GetFlowCacheSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("FlowModDelay",
+                   "The fixed time to update a flow table on a flow mod "
+                   "(a zero delay and shift delay apply flow mods instantly).",
+                   TimeValue (Time (0)),
+                   MakeTimeAccessor (&OFSwitch13Device::m_ruleDelay),
+                   MakeTimeChecker (Time (0)))
+    .AddAttribute ("FlowModShiftDelay",
+                   "The time to shift each lower priority entry when a flow "
+                   "mod adds a new entry to a flow table.",
+                   TimeValue (Time (0)),
+                   MakeTimeAccessor (&OFSwitch13Device::m_ruleShift),
+                   MakeTimeChecker (Time (0)))
+    .AddAttribute ("FlowTableClassifier",
+                   "The packet classifier algorithm used for lookups on each "
+                   "flow table.",
+                   EnumValue (OFSwitch13Device::CLASSIFIER_LINEAR),
+                   MakeEnumAccessor (
+                     &OFSwitch13Device::SetDftFlowTableClassifier,
+                     &OFSwitch13Device::GetDftFlowTableClassifier),
+                   MakeEnumChecker (
+                     OFSwitch13Device::CLASSIFIER_LINEAR, "Linear",
+                     OFSwitch13Device::CLASSIFIER_TSS,    "TupleSpace",
+                     OFSwitch13Device::CLASSIFIER_EXACT,  "ExactMatch",
+                     OFSwitch13Device::CLASSIFIER_LPM,    "LongestPrefix",
+                     OFSwitch13Device::CLASSIFIER_TREE,   "DecisionTree"))
     .AddAttribute ("FlowTableSize",
                    "The maximum number of entries allowed on each flow table.",
                    UintegerValue (FLOW_TABLE_MAX_ENTRIES),
                    MakeUintegerAccessor (&OFSwitch13Device::SetDftFlowTableSize,
                                          &OFSwitch13Device::GetDftFlowTableSize),
                    MakeUintegerChecker<uint32_t> (0, FLOW_TABLE_MAX_ENTRIES))
+    .AddAttribute ("FlowTableSlices",
+                   "The TCAM slice budget of each flow table (a zero budget "
+                   "disables the TCAM width-aware capacity model).",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (
+                     &OFSwitch13Device::SetDftFlowTableSlices,
+                     &OFSwitch13Device::GetDftFlowTableSlices),
+                   MakeUintegerChecker<uint32_t> ())
     .AddAttribute ("GroupTableSize",
                    "The maximum number of entries allowed on group table.",
                    UintegerValue (GROUP_TABLE_MAX_ENTRIES),
@@ -100,6 +221,13 @@ OFSwitch13Device::GetTypeId (void)
                    MakeUintegerAccessor (&OFSwitch13Device::SetMeterTableSize,
                                          &OFSwitch13Device::GetMeterTableSize),
                    MakeUintegerChecker<uint32_t> (0, METER_TABLE_MAX_ENTRIES))
+    .AddAttribute ("PipelineDelayModel",
+                   "The default lookup delay model for pipeline flow tables. "
+                   "When set, the pipeline delay is computed for each packet "
+                   "from the flow tables it has visited.",
+                   PointerValue (),
+                   MakePointerAccessor (&OFSwitch13Device::m_dftDelay),
+                   MakePointerChecker<OFSwitch13PipelineDelayModel> ())
     .AddAttribute ("PipelineTables",
                    "The number of pipeline flow tables.",
                    TypeId::ATTR_GET | TypeId::ATTR_CONSTRUCT,
@@ -116,12 +244,69 @@ OFSwitch13Device::GetTypeId (void)
                    TimeValue (MicroSeconds (20)),
                    MakeTimeAccessor (&OFSwitch13Device::m_tcamDelay),
                    MakeTimeChecker (Time (0)))
+    .AddAttribute ("TcamSliceWidth",
+                   "The width (in bits) of a TCAM slice.",
+                   UintegerValue (160),
+                   MakeUintegerAccessor (&OFSwitch13Device::m_tcamWidth),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("TierFastDelay",
+                   "The default lookup delay of the fast tier in two-tier "
+                   "flow tables.",
+                   TimeValue (MicroSeconds (20)),
+                   MakeTimeAccessor (&OFSwitch13Device::m_tierFastDelay),
+                   MakeTimeChecker (Time (0)))
+    .AddAttribute ("TierFastSize",
+                   "The default maximum number of entries in the fast tier "
+                   "of each flow table (values higher than 0 enable the "
+                   "two-tier flow table mode).",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&OFSwitch13Device::m_tierFastSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("TierPromoteHits",
+                   "The minimum number of hits between datapath timeout "
+                   "operations to promote an entry to the fast tier.",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&OFSwitch13Device::m_tierPromote),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("TierSlowDelay",
+                   "The default lookup delay of the slow tier in two-tier "
+                   "flow tables (added to the fast tier delay on fast tier "
+                   "misses).",
+                   TimeValue (MicroSeconds (200)),
+                   MakeTimeAccessor (&OFSwitch13Device::m_tierSlowDelay),
+                   MakeTimeChecker (Time (0)))
     .AddAttribute ("TimeoutInterval",
                    "The interval between timeout operations on datapath.",
                    TimeValue (MilliSeconds (100)),
                    MakeTimeAccessor (&OFSwitch13Device::m_timeout),
                    MakeTimeChecker (MilliSeconds (1), MilliSeconds (1000)))
-
+    .AddAttribute ("TreeSpaceFactor",
+                   "The space factor for decision tree classifiers, trading "
+                   "memory for lookup time (larger values result in more "
+                   "cuts per node and shallower trees).",
+                   DoubleValue (4),
+                   MakeDoubleAccessor (&OFSwitch13Device::SetTreeSpaceFactor,
+                                       &OFSwitch13Device::GetTreeSpaceFactor),
+                   MakeDoubleChecker<double> (1))
+    .AddAttribute ("VacancyDown",
+                   "The flow table vacancy threshold (percent of free "
+                   "entries) below which a vacancy down event is traced.",
+                   UintegerValue (10),
+                   MakeUintegerAccessor (&OFSwitch13Device::m_vacancyDown),
+                   MakeUintegerChecker<uint8_t> (0, 100))
+    .AddAttribute ("VacancyUp",
+                   "The flow table vacancy threshold (percent of free "
+                   "entries) above which a vacancy up event is traced.",
+                   UintegerValue (20),
+                   MakeUintegerAccessor (&OFSwitch13Device::m_vacancyUp),
+                   MakeUintegerChecker<uint8_t> (0, 100))
+
+    .AddTraceSource ("BatchSize",
+                     "Trace source indicating the number of packets sent to "
+                     "pipeline by an ingress batch event.",
+                     MakeTraceSourceAccessor (
+                       &OFSwitch13Device::m_batchTrace),
+                     "ns3::OFSwitch13Device::BatchTracedCallback")
     .AddTraceSource ("BufferExpire",
                      "Trace source indicating an expired packet in buffer.",
                      MakeTraceSourceAccessor (
@@ -137,6 +322,43 @@ OFSwitch13Device::GetTypeId (void)
                      MakeTraceSourceAccessor (
                        &OFSwitch13Device::m_bufferSaveTrace),
                      "ns3::Packet::TracedCallback")
+    .AddTraceSource ("CpuCoreLoad",
+                     "Trace source indicating the utilization of each CPU "
+                     "core (fired on datapath timeout operation when the CPU "
+                     "ingress queue is enabled).",
+                     MakeTraceSourceAccessor (
+                       &OFSwitch13Device::m_cpuCoreLoadTrace),
+                     "ns3::OFSwitch13Device::CpuCoreLoadTracedCallback")
+    .AddTraceSource ("CpuQueueDelay",
+                     "Trace source indicating the time a packet has waited "
+                     "in the CPU ingress queue.",
+                     MakeTraceSourceAccessor (
+                       &OFSwitch13Device::m_cpuQueueDelayTrace),
+                     "ns3::OFSwitch13Device::CpuQueueDelayTracedCallback")
+    .AddTraceSource ("FlowCacheHit",
+                     "Trace source indicating a packet that hit the flow "
+                     "cache.",
+                     MakeTraceSourceAccessor (
+                       &OFSwitch13Device::m_cacheHitTrace),
+                     "ns3::Packet::TracedCallback")
+    .AddTraceSource ("FlowCacheMiss",
+                     "Trace source indicating a packet that missed the flow "
+                     "cache.",
+                     MakeTraceSourceAccessor (
+                       &OFSwitch13Device::m_cacheMissTrace),
+                     "ns3::Packet::TracedCallback")
+    .AddTraceSource ("FlowModLatency",
+                     "Trace source indicating the time from the flow mod "
+                     "arrival until it took effect.",
+                     MakeTraceSourceAccessor (
+                       &OFSwitch13Device::m_flowModTrace),
+                     "ns3::OFSwitch13Device::FlowModTracedCallback")
+    .AddTraceSource ("FlowTableVacancy",
+                     "Trace source indicating a flow table that crossed the "
+                     "vacancy down or up thresholds.",
+                     MakeTraceSourceAccessor (
+                       &OFSwitch13Device::m_vacancyTrace),
+                     "ns3::OFSwitch13Device::VacancyTracedCallback")
     .AddTraceSource ("MeterDrop",
                      "Trace source indicating a packet dropped by meter band.",
                      MakeTraceSourceAccessor (
@@ -154,7 +376,8 @@ OFSwitch13Device::GetTypeId (void)
                        &OFSwitch13Device::m_pipePacketTrace),
                      "ns3::Packet::TracedCallback")
     .AddTraceSource ("DatapathTimeout",
-                     "Trace source indicating a datapath timeout operation.",
+                     "Trace source indicating a datapath timeout operation "
+                     "(only for devices with pending work).",
                      MakeTraceSourceAccessor (
                        &OFSwitch13Device::m_datapathTimeoutTrace),
                      "ns3::OFSwitch13Device::DeviceTracedCallback")
@@ -165,6 +388,12 @@ OFSwitch13Device::GetTypeId (void)
                      MakeTraceSourceAccessor (
                        &OFSwitch13Device::m_cpuLoad),
                      "ns3::TracedValueCallback::DataRate")
+    .AddTraceSource ("CpuQueueLength",
+                     "Traced value indicating the number of packets in the "
+                     "CPU ingress queue.",
+                     MakeTraceSourceAccessor (
+                       &OFSwitch13Device::m_cpuQueueLen),
+                     "ns3::TracedValueCallback::Uint32")
     .AddTraceSource ("GroupEntries",
                      "Traced value indicating the number of group entries"
                      " (periodically updated on datapath timeout operation).",
@@ -238,7 +467,7 @@ OFSwitch13Device::GetPacketOutCounter (void) const
 uint32_t
 OFSwitch13Device::GetBufferEntries (void) const
 {
-  return m_bufferPkts.size ();
+  return m_bufferUsed;
 }
 
 uint32_t
@@ -258,12 +487,36 @@ OFSwitch13Device::GetBufferUsage (void) const
          static_cast<double> (GetBufferSize ());
 }
 
+uint64_t
+OFSwitch13Device::GetBufPoolHits (void) const
+{
+  return m_bufPool.GetHits ();
+}
+
+uint32_t
+OFSwitch13Device::GetBufPoolHighWater (void) const
+{
+  return m_bufPool.GetHighWater ();
+}
+
+uint64_t
+OFSwitch13Device::GetBufPoolMisses (void) const
+{
+  return m_bufPool.GetMisses ();
+}
+
 DataRate
 OFSwitch13Device::GetCpuCapacity (void) const
 {
   return m_cpuCapacity;
 }
 
+uint32_t
+OFSwitch13Device::GetCpuCores (void) const
+{
+  return m_cpuNumCores;
+}
+
 DataRate
 OFSwitch13Device::GetCpuLoad (void) const
 {
@@ -293,6 +546,42 @@ OFSwitch13Device::GetDftFlowTableSize (void) const
   return m_flowTabSize;
 }
 
+uint32_t
+OFSwitch13Device::GetDftFlowTableSlices (void) const
+{
+  return m_tcamDftSlices;
+}
+
+OFSwitch13Device::ClassifierType
+OFSwitch13Device::GetDftFlowTableClassifier (void) const
+{
+  return m_classDftType;
+}
+
+uint32_t
+OFSwitch13Device::GetFlowCacheEntries (void) const
+{
+  return m_flowCache.GetNEntries ();
+}
+
+uint32_t
+OFSwitch13Device::GetFlowCacheMegaflows (void) const
+{
+  return m_flowCache.GetNMegaflows ();
+}
+
+uint32_t
+OFSwitch13Device::GetFlowCacheMasks (void) const
+{
+  return m_flowCache.GetNMasks ();
+}
+
+uint32_t
+OFSwitch13Device::GetFlowCacheSize (void) const
+{
+  return m_cacheSize;
+}
+
 uint32_t
 OFSwitch13Device::GetFlowTableEntries (uint8_t tableId) const
 {
@@ -309,9 +598,75 @@ OFSwitch13Device::GetFlowTableSize (uint8_t tableId) const
   return m_datapath->pipeline->tables [tableId]->features->max_entries;
 }
 
+uint32_t
+OFSwitch13Device::GetFlowTableSlices (uint8_t tableId) const
+{
+  NS_ASSERT_MSG (tableId < GetNPipelineTables (), "Invalid table ID.");
+  return m_tcamSlices.empty () ? 0 : m_tcamSlices [tableId];
+}
+
+uint32_t
+OFSwitch13Device::GetFlowTableTierSize (uint8_t tableId) const
+{
+  NS_ASSERT_MSG (tableId < GetNPipelineTables (), "Invalid table ID.");
+  if (m_tierConfigs.empty ())
+    {
+      return m_tierFastSize;
+    }
+  return m_tierConfigs [tableId].fastSize;
+}
+
+uint32_t
+OFSwitch13Device::GetFlowTableTreeDepth (uint8_t tableId) const
+{
+  NS_ASSERT_MSG (tableId < GetNPipelineTables (), "Invalid table ID.");
+  if (GetFlowTableClassifier (tableId) != CLASSIFIER_TREE
+      || m_classifiers.empty ())
+    {
+      return 0;
+    }
+  OFSwitch13TreeClassifier *tree = static_cast<OFSwitch13TreeClassifier*> (
+      PeekPointer (m_classifiers [tableId]));
+  return tree->GetDepth ();
+}
+
+uint32_t
+OFSwitch13Device::GetFlowTableTreeNodes (uint8_t tableId) const
+{
+  NS_ASSERT_MSG (tableId < GetNPipelineTables (), "Invalid table ID.");
+  if (GetFlowTableClassifier (tableId) != CLASSIFIER_TREE
+      || m_classifiers.empty ())
+    {
+      return 0;
+    }
+  OFSwitch13TreeClassifier *tree = static_cast<OFSwitch13TreeClassifier*> (
+      PeekPointer (m_classifiers [tableId]));
+  return tree->GetNNodes ();
+}
+
+uint32_t
+OFSwitch13Device::GetFlowTableUsedSlices (uint8_t tableId) const
+{
+  NS_ASSERT_MSG (tableId < GetNPipelineTables (), "Invalid table ID.");
+  if (GetFlowTableSlices (tableId) == 0)
+    {
+      return 0;
+    }
+
+  // Group and meter mods may remove flow entries without updating the
+  // bookkeeping, so count the slices again while it is out of sync.
+  return m_tcamUsedSync ? FlowTableSlicesCount (tableId) :
+         m_tcamUsed [tableId];
+}
+
 double
 OFSwitch13Device::GetFlowTableUsage (uint8_t tableId) const
 {
+  if (GetFlowTableSlices (tableId))
+    {
+      return static_cast<double> (GetFlowTableUsedSlices (tableId)) /
+             static_cast<double> (GetFlowTableSlices (tableId));
+    }
   if (GetFlowTableSize (tableId) == 0)
     {
       return 0.0;
@@ -392,6 +747,52 @@ OFSwitch13Device::GetPipelineDelay (void) const
   return m_pipeDelay;
 }
 
+uint64_t
+OFSwitch13Device::GetTierFastHits (void) const
+{
+  return m_tierFastHits;
+}
+
+double
+OFSwitch13Device::GetTierFastHitRatio (void) const
+{
+  if (GetTierLookups () == 0)
+    {
+      return 0.0;
+    }
+  return static_cast<double> (GetTierFastHits ()) /
+         static_cast<double> (GetTierLookups ());
+}
+
+uint64_t
+OFSwitch13Device::GetTierLookups (void) const
+{
+  return m_tierLookups;
+}
+
+uint64_t
+OFSwitch13Device::GetTierSlowHits (void) const
+{
+  return m_tierSlowHits;
+}
+
+double
+OFSwitch13Device::GetTierSlowHitRatio (void) const
+{
+  if (GetTierLookups () == 0)
+    {
+      return 0.0;
+    }
+  return static_cast<double> (GetTierSlowHits ()) /
+         static_cast<double> (GetTierLookups ());
+}
+
+double
+OFSwitch13Device::GetTreeSpaceFactor (void) const
+{
+  return m_treeSpace;
+}
+
 uint32_t
 OFSwitch13Device::GetSumFlowEntries (void) const
 {
@@ -403,6 +804,131 @@ OFSwitch13Device::GetSumFlowEntries (void) const
   return flowEntries;
 }
 
+void
+OFSwitch13Device::SetFlowTableSlices (uint8_t tableId, uint32_t value)
+{
+  NS_LOG_FUNCTION (this << (uint16_t)tableId << value);
+
+  NS_ASSERT_MSG (tableId < GetNPipelineTables (), "Invalid table ID.");
+  m_tcamSlices.resize (GetNPipelineTables (), m_tcamDftSlices);
+  m_tcamSlices [tableId] = value;
+  m_tcamUsedSync = true;
+}
+
+void
+OFSwitch13Device::SetFlowTableTiers (uint8_t tableId, uint32_t fastSize,
+                                     Time fastDelay, Time slowDelay)
+{
+  NS_LOG_FUNCTION (this << (uint16_t)tableId << fastSize << fastDelay <<
+                   slowDelay);
+
+  NS_ASSERT_MSG (tableId < GetNPipelineTables (), "Invalid table ID.");
+  TierConfig dftTier = {m_tierFastSize, m_tierFastDelay, m_tierSlowDelay};
+  m_tierConfigs.resize (GetNPipelineTables (), dftTier);
+  TierConfig tier = {fastSize, fastDelay, slowDelay};
+  m_tierConfigs [tableId] = tier;
+
+  m_tierTables = false;
+  for (auto const &config : m_tierConfigs)
+    {
+      m_tierTables = m_tierTables || config.fastSize;
+    }
+}
+
+void
+OFSwitch13Device::SetFlowTableDelayModel (
+  uint8_t tableId, Ptr<OFSwitch13PipelineDelayModel> model)
+{
+  NS_LOG_FUNCTION (this << (uint16_t)tableId << model);
+
+  NS_ASSERT_MSG (tableId < GetNPipelineTables (), "Invalid table ID.");
+  if (m_tableDelays.empty ())
+    {
+      m_tableDelays.resize (GetNPipelineTables ());
+    }
+  m_tableDelays [tableId] = model;
+}
+
+Ptr<OFSwitch13PipelineDelayModel>
+OFSwitch13Device::GetFlowTableDelayModel (uint8_t tableId) const
+{
+  NS_ASSERT_MSG (tableId < GetNPipelineTables (), "Invalid table ID.");
+  if (!m_tableDelays.empty () && m_tableDelays [tableId])
+    {
+      return m_tableDelays [tableId];
+    }
+  return m_dftDelay;
+}
+
+void
+OFSwitch13Device::SetFlowTableClassifier (uint8_t tableId,
+                                          ClassifierType type)
+{
+  NS_LOG_FUNCTION (this << (uint16_t)tableId << type);
+
+  NS_ASSERT_MSG (tableId < GetNPipelineTables (), "Invalid table ID.");
+  m_classTypes.resize (GetNPipelineTables (), m_classDftType);
+  m_classifiers.resize (GetNPipelineTables ());
+  m_classTypes [tableId] = type;
+  switch (type)
+    {
+    case CLASSIFIER_LINEAR:
+      m_classifiers [tableId] = 0;
+      break;
+    case CLASSIFIER_TSS:
+      m_classifiers [tableId] = Create<OFSwitch13TssClassifier> ();
+      break;
+    case CLASSIFIER_EXACT:
+      {
+        Ptr<OFSwitch13ExactClassifier> exact =
+          Create<OFSwitch13ExactClassifier> ();
+        if (tableId < m_exactFields.size ())
+          {
+            exact->SetFields (m_exactFields [tableId]);
+          }
+        m_classifiers [tableId] = exact;
+        break;
+      }
+    case CLASSIFIER_LPM:
+      m_classifiers [tableId] = Create<OFSwitch13LpmClassifier> ();
+      break;
+    case CLASSIFIER_TREE:
+      m_classifiers [tableId] = Create<OFSwitch13TreeClassifier> (m_treeSpace);
+      break;
+    default:
+      NS_ABORT_MSG ("Invalid classifier type.");
+    }
+}
+
+void
+OFSwitch13Device::SetFlowTableExactFields (uint8_t tableId,
+                                           std::vector<uint32_t> fields)
+{
+  NS_LOG_FUNCTION (this << (uint16_t)tableId << fields.size ());
+
+  NS_ASSERT_MSG (tableId < GetNPipelineTables (), "Invalid table ID.");
+  OFSwitch13ExactClassifier check;
+  NS_ABORT_MSG_IF (!check.SetFields (fields),
+                   "Field set not supported by exact-match tables.");
+  m_exactFields.resize (GetNPipelineTables ());
+  m_exactFields [tableId] = fields;
+  if (GetFlowTableClassifier (tableId) == CLASSIFIER_EXACT)
+    {
+      SetFlowTableClassifier (tableId, CLASSIFIER_EXACT);
+    }
+}
+
+OFSwitch13Device::ClassifierType
+OFSwitch13Device::GetFlowTableClassifier (uint8_t tableId) const
+{
+  NS_ASSERT_MSG (tableId < GetNPipelineTables (), "Invalid table ID.");
+  if (m_classTypes.empty ())
+    {
+      return m_classDftType;
+    }
+  return m_classTypes [tableId];
+}
+
 struct datapath*
 OFSwitch13Device::GetDatapathStruct ()
 {
@@ -427,6 +953,14 @@ OFSwitch13Device::AddSwitchPort (Ptr<NetDevice> portDevice)
   NS_ASSERT ((m_ports.size () == ofPort->GetPortNo ())
              && (m_ports.size () == m_datapath->ports_num));
 
+  // Update the port state now and on any further link change.
+  ofPort->PortUpdateState ();
+  portDevice->AddLinkChangeCallback (
+    MakeCallback (&OFSwitch13Device::PortLinkChanged, this));
+
+  // Flooded packets must be forwarded to this new port as well.
+  FlowCacheFlush ();
+
   return ofPort;
 }
 
@@ -446,8 +980,40 @@ OFSwitch13Device::ReceiveFromSwitchPort (Ptr<Packet> packet, uint32_t portNo,
 {
   NS_LOG_FUNCTION (this << packet << portNo << tunnelId);
 
+  if (!m_groupAwake)
+    {
+      TimeoutGroupWake ();
+    }
+
+  // With the CPU ingress queue enabled, the packet is processed by the first
+  // idle core, or waits in the queue. It is only dropped when the queue is
+  // full.
+  if (m_cpuQueueSize)
+    {
+      IngressPacket ingress = {packet, portNo, tunnelId, Simulator::Now ()};
+      for (uint32_t coreId = 0; coreId < m_cpuCores.size (); coreId++)
+        {
+          if (!m_cpuCores [coreId].event.IsRunning ())
+            {
+              m_cpuQueueDelayTrace (packet, Time (0));
+              CpuCoreStart (coreId, ingress);
+              return;
+            }
+        }
+      if (m_cpuQueue.size () >= m_cpuQueueSize)
+        {
+          NS_LOG_DEBUG ("Drop packet due to CPU ingress queue full.");
+          m_loadDropTrace (packet);
+          return;
+        }
+      m_cpuQueue.push_back (ingress);
+      m_cpuQueueLen = m_cpuQueue.size ();
+      return;
+    }
+
   // Check the packet for conformance to CPU processing capacity.
   uint32_t pktSizeBits = packet->GetSize () * 8;
+  CpuTokensRefill ();
   if (m_cpuTokens < pktSizeBits)
     {
       // Packet will be dropped. Increase counter and fire drop trace source.
@@ -459,8 +1025,51 @@ OFSwitch13Device::ReceiveFromSwitchPort (Ptr<Packet> packet, uint32_t portNo,
   // Consume tokens, fire trace source and schedule the packet to the pipeline.
   m_cpuTokens -= pktSizeBits;
   m_cpuConsumed += pktSizeBits;
+  ScheduleToPipeline (packet, portNo, tunnelId);
+}
+
+void
+OFSwitch13Device::ScheduleToPipeline (Ptr<Packet> packet, uint32_t portNo,
+                                      uint64_t tunnelId)
+{
+  NS_LOG_FUNCTION (this << packet << portNo << tunnelId);
+
+  // With lookup delay models, the pipeline delay is applied to the packet
+  // outputs, once the visited flow tables are known.
+  Time delay = m_pipeDelay;
+  if (m_dftDelay || !m_tableDelays.empty () || m_tierFastSize
+      || m_tierTables)
+    {
+      delay = Time (0);
+    }
+
   m_pipePacketTrace (packet);
-  Simulator::Schedule (m_pipeDelay, &OFSwitch13Device::SendToPipeline,
+  if (m_batchSize > 1)
+    {
+      // Save the packet into the ingress batch queue, sorted by due time
+      // (packets due at the same time are kept in arrival order). As the
+      // pipeline delay changes over time, the packet is inserted from the
+      // back, where it usually belongs. A single event sends the packets to
+      // pipeline in batch, so it's rescheduled when this packet is the first
+      // one due.
+      IngressPacket ingress = {packet, portNo, tunnelId,
+                               Simulator::Now () + delay};
+      auto it = m_batchQueue.end ();
+      while (it != m_batchQueue.begin ()
+             && ingress.dueTime < std::prev (it)->dueTime)
+        {
+          --it;
+        }
+      it = m_batchQueue.insert (it, ingress);
+      if (it == m_batchQueue.begin ())
+        {
+          m_batchEvent.Cancel ();
+          m_batchEvent = Simulator::Schedule (
+              delay, &OFSwitch13Device::SendBatchToPipeline, this);
+        }
+      return;
+    }
+  Simulator::Schedule (delay, &OFSwitch13Device::SendToPipeline,
                        this, packet, portNo, tunnelId);
 }
 
@@ -525,7 +1134,20 @@ OFSwitch13Device::SendOpenflowBufferToRemote (struct ofpbuf *buffer,
   Ptr<Packet> packet = ofs::PacketFromBuffer (buffer);
   Ptr<RemoteController> remoteCtrl = dev->GetRemoteController (remote);
 
-  ofpbuf_delete (buffer);
+  dev->m_bufPool.Put (buffer);
+  if (!remoteCtrl)
+    {
+      NS_LOG_ERROR ("No controller for this remote. Discarding message.");
+      return -1;
+    }
+  if (dev->m_egressDelay.IsStrictlyPositive ())
+    {
+      // This is a packet-in message for a packet under pipeline processing.
+      Simulator::Schedule (dev->m_egressDelay,
+                           &OFSwitch13Device::SendToController,
+                           dev, packet, remoteCtrl);
+      return 0;
+    }
   return dev->SendToController (packet, remoteCtrl);
 }
 
@@ -542,12 +1164,15 @@ OFSwitch13Device::DpActionsOutputPort (struct packet *pkt, uint32_t outPort,
         if (pkt->packet_out)
           {
             // Makes sure packet cannot be resubmit to pipeline again setting
-            // packet_out to false. Also, pipeline_process_packet takes
+            // packet_out to false. Also, PipelineProcessPacket takes
             // ownership of the packet, we need a copy.
             struct packet *pkt_copy = packet_clone (pkt);
             pkt_copy->packet_out = false;
-            pipeline_process_packet (pkt_copy->dp->pipeline, pkt_copy);
+            Time egressDelay = dev->m_egressDelay;
+            dev->PipelineProcessPacket (pkt_copy->dp->pipeline, pkt_copy);
+            dev->m_egressDelay = egressDelay;
           }
+        dev->FlowCacheUncacheable (pkt);
         break;
       }
     case (OFPP_IN_PORT):
@@ -623,7 +1248,7 @@ void
 OFSwitch13Device::BufferSaveCallback (struct packet *pkt, time_t timeout)
 {
   Ptr<OFSwitch13Device> dev = OFSwitch13Device::GetDevice (pkt->dp->id);
-  dev->BufferPacketSave (pkt->ns3_uid, timeout);
+  pkt->ns3_uid = dev->BufferPacketSave (pkt->ns3_uid, timeout);
 }
 
 void
@@ -636,12 +1261,10 @@ OFSwitch13Device::BufferRetrieveCallback (struct packet *pkt)
 Ptr<OFSwitch13Device>
 OFSwitch13Device::GetDevice (uint64_t id)
 {
-  auto it = OFSwitch13Device::m_globalSwitchMap.find (id);
-  if (it != OFSwitch13Device::m_globalSwitchMap.end ())
-    {
-      return it->second;
-    }
-  NS_ABORT_MSG ("Error when retrieving datapath.");
+  NS_ABORT_MSG_IF (id >= OFSwitch13Device::m_globalSwitchList.size ()
+                   || !OFSwitch13Device::m_globalSwitchList [id],
+                   "Error when retrieving datapath.");
+  return OFSwitch13Device::m_globalSwitchList [id];
 }
 
 /********** Protected methods **********/
@@ -657,23 +1280,39 @@ OFSwitch13Device::DoDispose ()
     }
   m_ports.clear ();
   m_bufferPkts.clear ();
+  m_bufferEvent.Cancel ();
+  m_bufferUsed = 0;
+  m_pipePkts.clear ();
+  TimeoutGroupUnregister ();
+  m_batchEvent.Cancel ();
+  m_batchQueue.clear ();
+  for (auto &core : m_cpuCores)
+    {
+      core.event.Cancel ();
+    }
+  m_cpuCores.clear ();
+  m_cpuQueue.clear ();
+  m_tableDelays.clear ();
+  m_dftDelay = 0;
+  m_ctrlEvent.Cancel ();
+  m_ctrlQueue.clear ();
+  m_evictIndexes.clear ();
+  m_tierEntries.clear ();
+  m_classifiers.clear ();
 
   for (auto &ctrl : m_controllers)
     {
       free (ctrl->m_remote);
     }
   m_controllers.clear ();
+  m_remoteCtrls.clear ();
+  m_bufPool.Clear ();
 
   dp_buffers_destroy (m_datapath->buffers);
   pipeline_destroy (m_datapath->pipeline);
   group_table_destroy (m_datapath->groups);
   meter_table_destroy (m_datapath->meters);
 
-  free (m_datapath->mfr_desc);
-  free (m_datapath->hw_desc);
-  free (m_datapath->sw_desc);
-  free (m_datapath->dp_desc);
-  free (m_datapath->serial_num);
   free (m_datapath);
 
   OFSwitch13Device::UnregisterDatapath (m_dpId);
@@ -691,11 +1330,14 @@ OFSwitch13Device::NotifyConstructionCompleted ()
 
   // Set the attribute values again so it can now update the dapatah structs.
   SetDftFlowTableSize (GetDftFlowTableSize ());
+  SetDftFlowTableSlices (GetDftFlowTableSlices ());
+  SetDftFlowTableClassifier (GetDftFlowTableClassifier ());
   SetGroupTableSize   (GetGroupTableSize ());
   SetMeterTableSize   (GetMeterTableSize ());
 
-  // Execute the first datapath timeout.
+  // Execute the first datapath timeout and join the housekeeping group.
   DatapathTimeout (m_datapath);
+  TimeoutGroupRegister ();
 
   // Chain up.
   Object::NotifyConstructionCompleted ();
@@ -709,20 +1351,23 @@ OFSwitch13Device::DatapathNew ()
 
   struct datapath *dp = (struct datapath*)xmalloc (sizeof (struct datapath));
 
-  dp->mfr_desc = (char*)xmalloc (DESC_STR_LEN);
-  dp->hw_desc = (char*)xmalloc (DESC_STR_LEN);
-  dp->sw_desc = (char*)xmalloc (DESC_STR_LEN);
-  dp->dp_desc = (char*)xmalloc (DESC_STR_LEN);
-  dp->serial_num = (char*)xmalloc (DESC_STR_LEN);
-  strncpy (dp->mfr_desc, "The ns-3 team", DESC_STR_LEN);
-  strncpy (dp->hw_desc, "N/A", DESC_STR_LEN);
-  strncpy (dp->sw_desc, "The ns-3 OFSwitch13 module", DESC_STR_LEN);
-  strncpy (dp->dp_desc, "Using ofsoftswitch13 (from CPqD)", DESC_STR_LEN);
-  strncpy (dp->serial_num, "3.1.0", DESC_STR_LEN);
+  // The description strings are the same for all switches and are only read
+  // by the library, so they are shared instead of allocated per datapath.
+  static char mfrDesc [DESC_STR_LEN] = "The ns-3 team";
+  static char hwDesc [DESC_STR_LEN] = "N/A";
+  static char swDesc [DESC_STR_LEN] = "The ns-3 OFSwitch13 module";
+  static char dpDesc [DESC_STR_LEN] = "Using ofsoftswitch13 (from CPqD)";
+  static char serialNum [DESC_STR_LEN] = "3.1.0";
+  dp->mfr_desc = mfrDesc;
+  dp->hw_desc = hwDesc;
+  dp->sw_desc = swDesc;
+  dp->dp_desc = dpDesc;
+  dp->serial_num = serialNum;
 
   dp->id = m_dpId;
   dp->last_timeout = time_now ();
   m_lastTimeout = Simulator::Now ();
+  m_cpuLastFill = Simulator::Now ();
   list_init (&dp->remotes);
 
   // unused
@@ -792,52 +1437,157 @@ OFSwitch13Device::SetDftFlowTableSize (uint32_t value)
 }
 
 void
-OFSwitch13Device::SetGroupTableSize (uint32_t value)
+OFSwitch13Device::SetDftFlowTableSlices (uint32_t value)
 {
   NS_LOG_FUNCTION (this << value);
 
-  m_groupTabSize = value;
+  m_tcamDftSlices = value;
   if (m_datapath)
     {
-      NS_ABORT_MSG_IF (GetGroupTableEntries () > value,
-                       "Can't reduce table size to this value.");
-      for (size_t i = 0; i < 4; i++)
+      // Without slice budget, the per table slices are not allocated.
+      m_tcamSlices.clear ();
+      if (value)
         {
-          m_datapath->groups->features->max_groups [i] = value;
+          m_tcamSlices.assign (GetNPipelineTables (), value);
         }
+      m_tcamUsedSync = true;
     }
 }
 
 void
-OFSwitch13Device::SetMeterTableSize (uint32_t value)
+OFSwitch13Device::SetDftFlowTableClassifier (ClassifierType value)
 {
   NS_LOG_FUNCTION (this << value);
 
-  m_meterTabSize = value;
+  m_classDftType = value;
   if (m_datapath)
     {
-      NS_ABORT_MSG_IF (GetMeterTableEntries () > value,
-                       "Can't reduce table size to this value.");
-      m_datapath->meters->features->max_meter = value;
+      // With the linear search, the per table classifiers are not allocated,
+      // and the packet flow key is not extracted for table lookups.
+      m_classTypes.clear ();
+      m_classifiers.clear ();
+      if (value != CLASSIFIER_LINEAR)
+        {
+          for (uint32_t i = 0; i < GetNPipelineTables (); i++)
+            {
+              SetFlowTableClassifier (i, value);
+            }
+        }
     }
 }
 
 void
-OFSwitch13Device::DatapathTimeout (struct datapath *dp)
+OFSwitch13Device::SetTreeSpaceFactor (double value)
 {
-  meter_table_add_tokens (dp->meters);
-  pipeline_timeout (dp->pipeline);
+  NS_LOG_FUNCTION (this << value);
 
-  // Check for chan/s in links (port) status.
-  for (auto const &port : m_ports)
+  // Replace the existing decision tree classifiers.
+  m_treeSpace = value;
+  for (uint32_t i = 0; i < m_classTypes.size (); i++)
     {
-      port->PortUpdateState ();
+      if (m_classTypes [i] == CLASSIFIER_TREE)
+        {
+          SetFlowTableClassifier (i, CLASSIFIER_TREE);
+        }
     }
+}
 
-  // Update traced values.
-  m_groupEntries = GetGroupTableEntries ();
-  m_meterEntries = GetMeterTableEntries ();
-  m_sumFlowEntries = GetSumFlowEntries ();
+void
+OFSwitch13Device::SetGroupTableSize (uint32_t value)
+{
+  NS_LOG_FUNCTION (this << value);
+
+  m_groupTabSize = value;
+  if (m_datapath)
+    {
+      NS_ABORT_MSG_IF (GetGroupTableEntries () > value,
+                       "Can't reduce table size to this value.");
+      for (size_t i = 0; i < 4; i++)
+        {
+          m_datapath->groups->features->max_groups [i] = value;
+        }
+    }
+}
+
+void
+OFSwitch13Device::SetMeterTableSize (uint32_t value)
+{
+  NS_LOG_FUNCTION (this << value);
+
+  m_meterTabSize = value;
+  if (m_datapath)
+    {
+      NS_ABORT_MSG_IF (GetMeterTableEntries () > value,
+                       "Can't reduce table size to this value.");
+      m_datapath->meters->features->max_meter = value;
+    }
+}
+
+void
+OFSwitch13Device::SetCpuCores (uint32_t value)
+{
+  NS_LOG_FUNCTION (this << value);
+
+  // Busy cores can't be removed, as their service completion events hold
+  // the packets being processed.
+  for (uint32_t coreId = value; coreId < m_cpuCores.size (); coreId++)
+    {
+      NS_ABORT_MSG_IF (m_cpuCores [coreId].event.IsRunning (),
+                       "Can't remove busy CPU cores.");
+    }
+  m_cpuNumCores = value;
+  m_cpuCores.resize (value);
+
+  // New cores start serving the packets waiting in the queue.
+  for (uint32_t coreId = 0; coreId < m_cpuCores.size (); coreId++)
+    {
+      if (m_cpuQueue.empty ())
+        {
+          break;
+        }
+      if (!m_cpuCores [coreId].event.IsRunning ())
+        {
+          IngressPacket next = m_cpuQueue.front ();
+          m_cpuQueue.pop_front ();
+          m_cpuQueueLen = m_cpuQueue.size ();
+          m_cpuQueueDelayTrace (next.packet, Simulator::Now () - next.dueTime);
+          CpuCoreStart (coreId, next);
+        }
+    }
+}
+
+void
+OFSwitch13Device::SetFlowCacheSize (uint32_t value)
+{
+  NS_LOG_FUNCTION (this << value);
+
+  m_cacheSize = value;
+  m_flowCache.SetMaxEntries (value);
+}
+
+void
+OFSwitch13Device::DatapathTimeout (struct datapath *dp)
+{
+  FlowTimersExpire ();
+  FlowTableSlicesSync ();
+  if (m_tierFastSize || m_tierTables)
+    {
+      TierRebalance ();
+    }
+
+  // Deferred classifier maintenance is kept out of the packet lookups.
+  for (auto const &classifier : m_classifiers)
+    {
+      if (classifier)
+        {
+          classifier->Update ();
+        }
+    }
+
+  // Update traced values.
+  m_groupEntries = GetGroupTableEntries ();
+  m_meterEntries = GetMeterTableEntries ();
+  m_sumFlowEntries = GetSumFlowEntries ();
 
   // The pipeline delay is estimated as k * log (n), where 'k' is the
   // m_tcamDelay set to the time for a single TCAM operation, and 'n' is the
@@ -846,169 +1596,1718 @@ OFSwitch13Device::DatapathTimeout (struct datapath *dp)
     m_tcamDelay * (int64_t)ceil (log2 (m_sumFlowEntries));
 
   // The CPU load is estimated based on the CPU consumed tokens since last
-  // timeout operation.
-  m_cpuLoad = DataRate (m_cpuConsumed / m_timeout.GetSeconds ());
-  m_cpuConsumed = 0;
-
-  // Refill the pipeline bucket with tokens based on elapsed time
-  // (bucket capacity is set to the number of tokens for an entire second).
+  // timeout operation. The elapsed time is used here, as the first interval
+  // after joining a housekeeping group can be shorter than m_timeout.
   Time elapTime = Simulator::Now () - m_lastTimeout;
-  uint64_t addTokens = m_cpuCapacity.GetBitRate () * elapTime.GetSeconds ();
-  uint64_t maxTokens = m_cpuCapacity.GetBitRate ();
-  m_cpuTokens = std::min (m_cpuTokens + addTokens, maxTokens);
+  if (elapTime.IsStrictlyPositive ())
+    {
+      m_cpuLoad = DataRate (m_cpuConsumed / elapTime.GetSeconds ());
+      m_cpuConsumed = 0;
+
+      // The CPU core utilization is the fraction of the elapsed time each
+      // core was busy. The busy time of ongoing services is accounted up to
+      // now, and the remaining will be accounted on the next timeout.
+      if (m_cpuQueueSize)
+        {
+          for (uint32_t coreId = 0; coreId < m_cpuCores.size (); coreId++)
+            {
+              CpuCore &core = m_cpuCores [coreId];
+              if (core.event.IsRunning ())
+                {
+                  core.busyTime += Simulator::Now () - core.busyStart;
+                  core.busyStart = Simulator::Now ();
+                }
+              m_cpuCoreLoadTrace (coreId, core.busyTime.GetSeconds () /
+                                  elapTime.GetSeconds ());
+              core.busyTime = Time (0);
+            }
+        }
+    }
 
   dp->last_timeout = time_now ();
   m_lastTimeout = Simulator::Now ();
   m_datapathTimeoutTrace (this);
-  Simulator::Schedule (m_timeout, &OFSwitch13Device::DatapathTimeout,
-                       this, m_datapath);
 }
 
-int
-OFSwitch13Device::SendPacketInMessage (struct packet *pkt, uint8_t tableId,
-                                       uint8_t reason, uint16_t maxLength,
-                                       uint64_t cookie)
+void
+OFSwitch13Device::CpuTokensRefill (void)
 {
-  NS_LOG_FUNCTION (this << pkt->ns3_uid << tableId << reason);
+  Time elapTime = Simulator::Now () - m_cpuLastFill;
+  if (!elapTime.IsStrictlyPositive ())
+    {
+      return;
+    }
+  m_cpuLastFill = Simulator::Now ();
 
-  // Create the packet_in message.
-  struct ofl_msg_packet_in msg;
-  msg.header.type = OFPT_PACKET_IN;
-  msg.total_len = pkt->buffer->size;
-  msg.reason = (enum ofp_packet_in_reason)reason;
-  msg.table_id = tableId;
-  msg.cookie = cookie;
-  msg.data = (uint8_t*)pkt->buffer->data;
+  // Fractional tokens are carried over, so frequent refills with short
+  // elapsed times don't lose tokens due to rounding.
+  uint64_t maxTokens = m_cpuCapacity.GetBitRate ();
+  double addTokens = maxTokens * elapTime.GetSeconds () + m_cpuTokensFrac;
+  if (addTokens >= maxTokens)
+    {
+      m_cpuTokens = maxTokens;
+      m_cpuTokensFrac = 0;
+      return;
+    }
+  uint64_t intTokens = static_cast<uint64_t> (addTokens);
+  m_cpuTokensFrac = addTokens - intTokens;
+  m_cpuTokens = std::min (m_cpuTokens + intTokens, maxTokens);
+}
 
-  // A maxLength of OFPCML_NO_BUFFER means that the complete packet should be
-  // sent, and it should not be buffered. However, in this implementation we
-  // always save the packet into buffer to avoid losing ns-3 packet id
-  // reference. This is not full compliant with OpenFlow specification, but
-  // works very well here.
-  dp_buffers_save (pkt->dp->buffers, pkt);
-  msg.buffer_id = pkt->buffer_id;
-  msg.data_length = MIN (maxLength, pkt->buffer->size);
+void
+OFSwitch13Device::CpuCoreStart (uint32_t coreId, IngressPacket ingress)
+{
+  NS_LOG_FUNCTION (this << coreId << ingress.packet);
 
-  if (!pkt->handle_std->valid)
+  // The service time is given by the core service rate, when configured,
+  // or by the per-core share of the CPU capacity.
+  uint64_t pktSizeBits = ingress.packet->GetSize () * 8;
+  double coreBitRate = m_cpuCoreRate.GetBitRate ()
+    ? static_cast<double> (m_cpuCoreRate.GetBitRate ())
+    : static_cast<double> (m_cpuCapacity.GetBitRate ()) / m_cpuNumCores;
+  Time serviceTime = Seconds (pktSizeBits / coreBitRate);
+  m_cpuConsumed += pktSizeBits;
+
+  CpuCore &core = m_cpuCores [coreId];
+  core.busyStart = Simulator::Now ();
+  core.event = Simulator::Schedule (
+      serviceTime, &OFSwitch13Device::CpuCoreDone, this, coreId, ingress);
+}
+
+void
+OFSwitch13Device::CpuCoreDone (uint32_t coreId, IngressPacket ingress)
+{
+  NS_LOG_FUNCTION (this << coreId << ingress.packet);
+
+  CpuCore &core = m_cpuCores [coreId];
+  core.busyTime += Simulator::Now () - core.busyStart;
+  ScheduleToPipeline (ingress.packet, ingress.portNo, ingress.tunnelId);
+
+  if (!m_cpuQueue.empty ())
     {
-      packet_handle_std_validate (pkt->handle_std);
+      IngressPacket next = m_cpuQueue.front ();
+      m_cpuQueue.pop_front ();
+      m_cpuQueueLen = m_cpuQueue.size ();
+      m_cpuQueueDelayTrace (next.packet, Simulator::Now () - next.dueTime);
+      CpuCoreStart (coreId, next);
+    }
+}
+
+bool
+OFSwitch13Device::DatapathTimeoutPending (void) const
+{
+  if (m_flowTimers.GetNEntries () || m_flowTimersSync || m_tcamUsedSync
+      || m_cpuConsumed || m_cpuLoad.Get ().GetBitRate ())
+    {
+      return true;
+    }
+  for (auto const &core : m_cpuCores)
+    {
+      if (core.event.IsRunning () || core.busyTime.IsStrictlyPositive ())
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+OFSwitch13Device::DatapathTimeoutGroup (Time interval)
+{
+  auto it = OFSwitch13Device::m_timeoutGroups.find (interval);
+  NS_ASSERT_MSG (it != OFSwitch13Device::m_timeoutGroups.end (),
+                 "Invalid housekeeping group.");
+
+  // Only devices with pending work are visited. An index is used here, as
+  // devices woken up by trace sinks are appended to the list.
+  TimeoutGroup &group = it->second;
+  group.lastTick = Simulator::Now ();
+  DevList_t moved;
+  DevList_t idle;
+  for (size_t i = 0; i < group.devices.size (); i++)
+    {
+      OFSwitch13Device *dev = group.devices [i];
+      dev->DatapathTimeout (dev->m_datapath);
+      if (dev->m_timeout != interval)
+        {
+          moved.push_back (dev);
+        }
+      else if (!dev->DatapathTimeoutPending ())
+        {
+          idle.push_back (dev);
+        }
+    }
+  group.event = Simulator::Schedule (
+      interval, &OFSwitch13Device::DatapathTimeoutGroup, interval);
+  for (auto const &dev : idle)
+    {
+      dev->TimeoutGroupSleep ();
+    }
+
+  // Move devices with updated timeout interval to their new groups. This
+  // must be the last operation, as it can remove the current group.
+  for (auto const &dev : moved)
+    {
+      dev->TimeoutGroupUnregister ();
+      dev->TimeoutGroupRegister ();
+    }
+}
+
+void
+OFSwitch13Device::TimeoutGroupRegister (void)
+{
+  NS_LOG_FUNCTION (this << m_timeout);
+
+  TimeoutGroup &group = OFSwitch13Device::m_timeoutGroups [m_timeout];
+  if (group.members++ == 0)
+    {
+      group.event = Simulator::Schedule (
+          m_timeout, &OFSwitch13Device::DatapathTimeoutGroup, m_timeout);
+    }
+  m_groupTimeout = m_timeout;
+  TimeoutGroupWake ();
+}
+
+void
+OFSwitch13Device::TimeoutGroupUnregister (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  auto it = OFSwitch13Device::m_timeoutGroups.find (m_groupTimeout);
+  if (it == OFSwitch13Device::m_timeoutGroups.end ())
+    {
+      return;
+    }
+
+  TimeoutGroupSleep ();
+  m_groupTimeout = Time (0);
+  if (--it->second.members == 0)
+    {
+      it->second.event.Cancel ();
+      OFSwitch13Device::m_timeoutGroups.erase (it);
+    }
+}
+
+void
+OFSwitch13Device::TimeoutGroupWake (void)
+{
+  auto it = OFSwitch13Device::m_timeoutGroups.find (m_groupTimeout);
+  if (m_groupAwake || it == OFSwitch13Device::m_timeoutGroups.end ())
+    {
+      return;
+    }
+
+  NS_LOG_FUNCTION (this);
+  TimeoutGroup &group = it->second;
+  if (m_lastTimeout < group.lastTick)
+    {
+      m_lastTimeout = group.lastTick;
+      m_datapath->last_timeout =
+        static_cast<time_t> (group.lastTick.ToInteger (Time::S));
+    }
+  m_groupAwake = true;
+  m_groupIdx = group.devices.size ();
+  group.devices.push_back (this);
+}
+
+void
+OFSwitch13Device::TimeoutGroupSleep (void)
+{
+  auto it = OFSwitch13Device::m_timeoutGroups.find (m_groupTimeout);
+  if (!m_groupAwake || it == OFSwitch13Device::m_timeoutGroups.end ())
+    {
+      return;
+    }
+
+  // Swap with the last device in the list and remove it.
+  NS_LOG_FUNCTION (this);
+  DevList_t &devices = it->second.devices;
+  devices [m_groupIdx] = devices.back ();
+  devices [m_groupIdx]->m_groupIdx = m_groupIdx;
+  devices.pop_back ();
+  m_groupAwake = false;
+}
+
+void
+OFSwitch13Device::FlowTimersExpire (void)
+{
+  if (m_flowTimersSync)
+    {
+      FlowTimersSync ();
+    }
+
+  OFSwitch13TimerWheel::EntryList_t dueEntries;
+  m_flowTimers.Advance (time_msec (), dueEntries);
+  if (dueEntries.empty ())
+    {
+      return;
+    }
+
+  // The library functions check the entry timeouts and remove expired
+  // entries, notifying the controller when requested by the entry flags.
+  // Expired entries are freed by the library, so entries are removed from the
+  // flow table classifier in advance, and reinserted when not expired.
+  bool removed = false;
+  for (auto const &entry : dueEntries)
+    {
+      Ptr<OFSwitch13Classifier> classifier;
+      if (!m_classifiers.empty ())
+        {
+          classifier = m_classifiers [entry->table->stats->table_id];
+        }
+      bool indexed = classifier && classifier->IsValid ();
+      if (indexed)
+        {
+          classifier->Remove (entry);
+        }
+
+      uint8_t tableId = entry->table->stats->table_id;
+      if (flow_entry_hard_timeout (entry) || flow_entry_idle_timeout (entry))
+        {
+          FlowEvictIndexRemove (tableId, entry);
+          FlowCacheInvalidate (tableId);
+          removed = true;
+        }
+      else
+        {
+          if (indexed)
+            {
+              classifier->Insert (entry);
+            }
+          FlowTimerSchedule (entry);
+        }
+    }
+
+  if (removed)
+    {
+      m_tcamUsedSync = true;
+      FlowTableVacancyCheck ();
+    }
+}
+
+bool
+OFSwitch13Device::FlowTableEvict (struct flow_table *table)
+{
+  NS_LOG_FUNCTION (this << (uint16_t)table->stats->table_id);
+
+  uint8_t tableId = table->stats->table_id;
+  if (m_evictIndexes.size () <= tableId || m_evictIndexes [tableId].sync
+      || m_evictIndexes [tableId].policy != m_evictPolicy)
+    {
+      FlowEvictIndexSync (table);
+    }
+
+  // Items of removed entries are discarded, and entries whose key has grown
+  // since they were indexed are reindexed with the current key.
+  EvictIndex &index = m_evictIndexes [tableId];
+  struct flow_entry *victim = 0;
+  while (!victim && !index.heap.empty ())
+    {
+      std::pop_heap (index.heap.begin (), index.heap.end (), FlowEvictAfter);
+      EvictItem item = index.heap.back ();
+      index.heap.pop_back ();
+
+      auto it = index.live.find (item.entry);
+      if (it == index.live.end () || it->second != item.seq)
+        {
+          continue;
+        }
+      uint64_t key = FlowEvictKey (item.entry);
+      if (key != item.key)
+        {
+          item.key = key;
+          index.heap.push_back (item);
+          std::push_heap (index.heap.begin (), index.heap.end (),
+                          FlowEvictAfter);
+          continue;
+        }
+      victim = item.entry;
+      index.live.erase (it);
+    }
+
+  if (!victim)
+    {
+      return false;
+    }
+
+  NS_LOG_DEBUG ("Evicting flow entry from table " << (uint16_t)tableId);
+  if (GetFlowTableSlices (tableId) && !m_tcamUsedSync)
+    {
+      m_tcamUsed [tableId] -= std::min (m_tcamUsed [tableId],
+                                        FlowEntrySlices (victim->match));
+    }
+
+  // The evicted entry is freed by the library, so it's removed from the flow
+  // table classifier and from the flow timing wheel in advance.
+  Ptr<OFSwitch13Classifier> classifier = FlowClassifierGet (tableId);
+  if (classifier)
+    {
+      classifier->Remove (victim);
+    }
+  m_flowTimers.Cancel (victim);
+  flow_entry_remove (victim, OFPRR_DELETE);
+  FlowCacheInvalidate (tableId);
+  return true;
+}
+
+uint64_t
+OFSwitch13Device::FlowEvictKey (struct flow_entry *entry) const
+{
+  switch (m_evictPolicy)
+    {
+    case EVICT_LRU:
+      return entry->last_used;
+    case EVICT_PACKETS:
+      return entry->stats->packet_count;
+    case EVICT_PRIORITY:
+      return entry->stats->priority;
+    default:
+      NS_ABORT_MSG ("Invalid eviction policy.");
+    }
+  return 0;
+}
+
+bool
+OFSwitch13Device::FlowEvictAfter (const EvictItem &a, const EvictItem &b)
+{
+  if (a.key != b.key)
+    {
+      return a.key > b.key;
+    }
+  if (a.created != b.created)
+    {
+      return a.created > b.created;
+    }
+  return a.seq > b.seq;
+}
+
+void
+OFSwitch13Device::FlowEvictIndexAdd (struct flow_table *table,
+                                     struct flow_entry *entry)
+{
+  uint8_t tableId = table->stats->table_id;
+  if (m_evictIndexes.size () <= tableId || m_evictIndexes [tableId].sync
+      || m_evictIndexes [tableId].policy != m_evictPolicy)
+    {
+      return;
+    }
+
+  EvictIndex &index = m_evictIndexes [tableId];
+  if (!entry)
+    {
+      index.sync = true;
+      return;
+    }
+
+  // Never index the table-miss entry.
+  if (entry->stats->priority == 0 && entry->match->length <= 4)
+    {
+      return;
+    }
+
+  // Rebuild the index when it holds too many items of removed entries.
+  if (index.heap.size () > 2 * index.live.size () + 64)
+    {
+      index.sync = true;
+      return;
+    }
+
+  EvictItem item = {FlowEvictKey (entry), entry->created, index.nextSeq++,
+                    entry};
+  index.live [entry] = item.seq;
+  index.heap.push_back (item);
+  std::push_heap (index.heap.begin (), index.heap.end (), FlowEvictAfter);
+}
+
+void
+OFSwitch13Device::FlowEvictIndexRemove (uint8_t tableId,
+                                        struct flow_entry *entry)
+{
+  if (m_evictIndexes.size () > tableId && !m_evictIndexes [tableId].sync)
+    {
+      m_evictIndexes [tableId].live.erase (entry);
+    }
+}
+
+void
+OFSwitch13Device::FlowEvictIndexSync (struct flow_table *table)
+{
+  NS_LOG_FUNCTION (this << (uint16_t)table->stats->table_id);
+
+  uint8_t tableId = table->stats->table_id;
+  if (m_evictIndexes.size () <= tableId)
+    {
+      EvictIndex empty;
+      empty.policy = EVICT_NONE;
+      empty.nextSeq = 0;
+      empty.sync = true;
+      m_evictIndexes.resize (GetNPipelineTables (), empty);
+    }
+
+  EvictIndex &index = m_evictIndexes [tableId];
+  index.heap.clear ();
+  index.live.clear ();
+  index.policy = m_evictPolicy;
+  index.sync = false;
+  struct flow_entry *entry;
+  LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries)
+  {
+    FlowEvictIndexAdd (table, entry);
+  }
+}
+
+void
+OFSwitch13Device::FlowEvictIndexInvalidate (void)
+{
+  for (auto &index : m_evictIndexes)
+    {
+      index.heap.clear ();
+      index.live.clear ();
+      index.sync = true;
+    }
+}
+
+uint32_t
+OFSwitch13Device::FlowEntrySlices (struct ofl_match_header *match) const
+{
+  uint32_t bits = 0;
+  struct ofl_match_tlv *f;
+  HMAP_FOR_EACH (f, struct ofl_match_tlv, hmap_node,
+                 &((struct ofl_match*)match)->match_fields)
+  {
+    uint32_t length = OXM_LENGTH (f->header);
+    bits += (OXM_HASMASK (f->header) ? length / 2 : length) * 8;
+  }
+  return std::max (1U, (bits + m_tcamWidth - 1) / m_tcamWidth);
+}
+
+uint32_t
+OFSwitch13Device::FlowTableSlicesCount (uint8_t tableId) const
+{
+  uint32_t slices = 0;
+  struct flow_entry *entry;
+  struct flow_table *table = m_datapath->pipeline->tables [tableId];
+  LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries)
+  {
+    slices += FlowEntrySlices (entry->match);
+  }
+  return slices;
+}
+
+void
+OFSwitch13Device::FlowTableSlicesSync (void)
+{
+  if (!m_tcamUsedSync || m_tcamSlices.empty ())
+    {
+      return;
+    }
+
+  NS_LOG_FUNCTION (this);
+  m_tcamUsed.assign (GetNPipelineTables (), 0);
+  for (uint32_t i = 0; i < GetNPipelineTables (); i++)
+    {
+      if (m_tcamSlices [i])
+        {
+          m_tcamUsed [i] = FlowTableSlicesCount (i);
+        }
+    }
+  m_tcamUsedSync = false;
+}
+
+struct flow_entry*
+OFSwitch13Device::FlowTableLookup (struct flow_table *table,
+                                  struct packet *pkt,
+                                  const OFSwitch13FlowKey *key)
+{
+  Ptr<OFSwitch13Classifier> classifier =
+    FlowClassifierGet (table->stats->table_id);
+  if (!classifier)
+    {
+      return flow_table_lookup (table, pkt);
+    }
+
+  // Update the counters just like flow_table_lookup () does.
+  table->stats->lookup_count++;
+  struct flow_entry *entry = key ? classifier->Lookup (pkt, *key) :
+    classifier->Lookup (pkt);
+  if (entry)
+    {
+      if (!entry->no_byt_count)
+        {
+          entry->stats->byte_count += pkt->buffer->size;
+        }
+      if (!entry->no_pkt_count)
+        {
+          entry->stats->packet_count++;
+        }
+      entry->last_used = time_msec ();
+      table->stats->matched_count++;
+    }
+  return entry;
+}
+
+struct flow_entry*
+OFSwitch13Device::FlowTableFind (struct flow_table *table,
+                                 struct ofl_match_header *match,
+                                 uint16_t priority)
+{
+  Ptr<OFSwitch13Classifier> classifier =
+    FlowClassifierGet (table->stats->table_id);
+  if (classifier)
+    {
+      return classifier->Find (match, priority);
+    }
+
+  // Entries are sorted by decreasing priority.
+  struct flow_entry *entry;
+  LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries)
+  {
+    if (entry->stats->priority < priority)
+      {
+        break;
+      }
+    struct ofl_match_header *m = entry->match ? entry->match :
+      entry->stats->match;
+    if (entry->stats->priority == priority && m->type == OFPMT_OXM
+        && match->type == OFPMT_OXM
+        && match_std_strict ((struct ofl_match*)m, (struct ofl_match*)match))
+      {
+        return entry;
+      }
+  }
+  return 0;
+}
+
+Ptr<OFSwitch13Classifier>
+OFSwitch13Device::FlowClassifierGet (uint8_t tableId)
+{
+  if (m_classifiers.empty () || !m_classifiers [tableId])
+    {
+      return 0;
+    }
+
+  Ptr<OFSwitch13Classifier> classifier = m_classifiers [tableId];
+  if (!classifier->IsValid ())
+    {
+      classifier->Build (m_datapath->pipeline->tables [tableId]);
+    }
+  return classifier;
+}
+
+void
+OFSwitch13Device::FlowClassifierAdd (struct flow_table *table,
+                                     uint16_t priority,
+                                     const OFSwitch13FlowKey &value,
+                                     const OFSwitch13FlowKey &mask)
+{
+  Ptr<OFSwitch13Classifier> classifier =
+    m_classifiers [table->stats->table_id];
+  if (!classifier->IsValid ())
+    {
+      return;
+    }
+
+  // The new entry was placed among those with the same priority. As flow mods
+  // with the same priority and match replace existing entries, the match of
+  // recently created entries identifies the new one.
+  uint64_t now = time_msec ();
+  struct flow_entry *entry;
+  LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries)
+  {
+    if (entry->stats->priority < priority)
+      {
+        break;
+      }
+    if (entry->stats->priority > priority || entry->created != now)
+      {
+        continue;
+      }
+    struct ofl_match_header *m = entry->match ? entry->match :
+      entry->stats->match;
+    OFSwitch13FlowKey entryValue;
+    OFSwitch13FlowKey entryMask;
+    if (m->type == OFPMT_OXM
+        && entryValue.SetMatch ((struct ofl_match*)m, &entryMask)
+        && entryValue == value && entryMask == mask)
+      {
+        classifier->Insert (entry);
+        return;
+      }
+  }
+  classifier->Clear ();
+}
+
+void
+OFSwitch13Device::FlowClassifiersInvalidate (void)
+{
+  for (auto const &classifier : m_classifiers)
+    {
+      if (classifier)
+        {
+          classifier->Clear ();
+        }
+    }
+}
+
+void
+OFSwitch13Device::FlowTableVacancyCheck (void)
+{
+  FlowTableSlicesSync ();
+  m_vacancyLow.resize (GetNPipelineTables (), false);
+  for (uint32_t i = 0; i < GetNPipelineTables (); i++)
+    {
+      if (GetFlowTableSize (i) == 0 && GetFlowTableSlices (i) == 0)
+        {
+          continue;
+        }
+      double usage = std::min (GetFlowTableUsage (i), 1.0);
+      uint8_t vacancy = (1.0 - usage) * 100;
+      if (!m_vacancyLow [i] && vacancy < m_vacancyDown)
+        {
+          m_vacancyLow [i] = true;
+          m_vacancyTrace (i, vacancy, true);
+        }
+      else if (m_vacancyLow [i] && vacancy > m_vacancyUp)
+        {
+          m_vacancyLow [i] = false;
+          m_vacancyTrace (i, vacancy, false);
+        }
+    }
+}
+
+void
+OFSwitch13Device::FlowTimerSchedule (struct flow_entry *entry)
+{
+  // The library removes entries only after the timeout has been exceeded,
+  // so deadlines are set 1 ms after the timeout instant.
+  uint64_t deadline = 0;
+  if (entry->remove_at)
+    {
+      deadline = entry->remove_at + 1;
+    }
+  if (entry->stats->idle_timeout)
+    {
+      uint64_t idleDeadline =
+        entry->last_used + entry->stats->idle_timeout * 1000ULL + 1;
+      if (!deadline || idleDeadline < deadline)
+        {
+          deadline = idleDeadline;
+        }
+    }
+  if (deadline)
+    {
+      m_flowTimers.Schedule (entry, deadline);
+    }
+}
+
+void
+OFSwitch13Device::FlowTimersSync (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_flowTimers.Clear (time_msec ());
+  for (size_t i = 0; i < GetNPipelineTables (); i++)
+    {
+      struct flow_entry *entry;
+      struct flow_table *table = m_datapath->pipeline->tables [i];
+      LIST_FOR_EACH (entry, struct flow_entry, match_node,
+                     &table->match_entries)
+      {
+        FlowTimerSchedule (entry);
+      }
+    }
+  m_flowTimersSync = false;
+}
+
+void
+OFSwitch13Device::FlowTimersUpdate (struct flow_table *table,
+                                    uint16_t idleTimeout, uint16_t hardTimeout,
+                                    uint32_t flowEntries,
+                                    struct flow_entry *oldEntry)
+{
+  NS_LOG_FUNCTION (this << flowEntries);
+
+  uint32_t newFlowEntries = GetSumFlowEntries ();
+  if (m_flowTimersSync || (!table && newFlowEntries == flowEntries))
+    {
+      return;
+    }
+
+  // The entry removed by a strict delete was freed by the library.
+  if (!table && oldEntry && newFlowEntries + 1 == flowEntries)
+    {
+      m_flowTimers.Cancel (oldEntry);
+      return;
+    }
+
+  // A new entry with the same match and priority of an existing one replaces
+  // it, and the replaced entry was freed by the library. Any other change
+  // may have freed unknown flow entries in the timing wheel.
+  struct flow_entry *entry = 0;
+  bool replaced = oldEntry && newFlowEntries == flowEntries;
+  if (table && (newFlowEntries == flowEntries + 1 || replaced))
+    {
+      if (replaced)
+        {
+          m_flowTimers.Cancel (oldEntry);
+        }
+
+      // New entries with idle timeout are appended to the idle list, while
+      // new entries with hard timeout are placed after all entries in the
+      // hard list with the same or earlier removal time.
+      uint64_t now = time_msec ();
+      if (idleTimeout && !list_is_empty (&table->idle_entries))
+        {
+          entry = CONTAINER_OF (table->idle_entries.prev,
+                                struct flow_entry, idle_node);
+        }
+      else if (hardTimeout)
+        {
+          uint64_t removeAt = now + hardTimeout * 1000ULL;
+          struct list *node = table->hard_entries.prev;
+          while (node != &table->hard_entries)
+            {
+              entry = CONTAINER_OF (node, struct flow_entry, hard_node);
+              if (entry->remove_at <= removeAt)
+                {
+                  break;
+                }
+              entry = 0;
+              node = node->prev;
+            }
+        }
+
+      // Double-check that this is the new entry.
+      if (entry && (entry->created != now
+                    || entry->stats->idle_timeout != idleTimeout
+                    || entry->stats->hard_timeout != hardTimeout))
+        {
+          entry = 0;
+        }
+      if (entry || (!idleTimeout && !hardTimeout))
+        {
+          if (entry)
+            {
+              FlowTimerSchedule (entry);
+            }
+          return;
+        }
+    }
+  m_flowTimersSync = true;
+}
+
+void
+OFSwitch13Device::PortLinkChanged (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  for (auto const &port : m_ports)
+    {
+      if (port->PortUpdateState ())
+        {
+          FlowCacheFlush ();
+        }
+    }
+}
+
+int
+OFSwitch13Device::SendPacketInMessage (struct packet *pkt, uint8_t tableId,
+                                       uint8_t reason, uint16_t maxLength,
+                                       uint64_t cookie)
+{
+  NS_LOG_FUNCTION (this << pkt->ns3_uid << tableId << reason);
+
+  // Packets sent to the controller can't be memoized by the flow cache.
+  FlowCacheUncacheable (pkt);
+
+  // Create the packet_in message.
+  struct ofl_msg_packet_in msg;
+  msg.header.type = OFPT_PACKET_IN;
+  msg.total_len = pkt->buffer->size;
+  msg.reason = (enum ofp_packet_in_reason)reason;
+  msg.table_id = tableId;
+  msg.cookie = cookie;
+  msg.data = (uint8_t*)pkt->buffer->data;
+
+  // A maxLength of OFPCML_NO_BUFFER means that the complete packet should be
+  // sent, and it should not be buffered. However, in this implementation we
+  // always save the packet into buffer to avoid losing ns-3 packet id
+  // reference. This is not full compliant with OpenFlow specification, but
+  // works very well here.
+  dp_buffers_save (pkt->dp->buffers, pkt);
+  msg.buffer_id = pkt->buffer_id;
+  msg.data_length = MIN (maxLength, pkt->buffer->size);
+
+  if (!pkt->handle_std->valid)
+    {
+      packet_handle_std_validate (pkt->handle_std);
+    }
+  msg.match = (struct ofl_match_header*) &pkt->handle_std->match;
+
+  // Increase packet-in counter and send the message.
+  m_cPacketIn++;
+  return dp_send_message (pkt->dp, (struct ofl_msg_header *)&msg, 0);
+}
+
+bool
+OFSwitch13Device::SendToSwitchPort (struct packet *pkt, uint32_t portNo,
+                                    uint32_t queueNo)
+{
+  NS_LOG_FUNCTION (this << pkt->ns3_uid << portNo);
+
+  Ptr<OFSwitch13Port> port = GetSwitchPort (portNo);
+  if (!port)
+    {
+      NS_LOG_ERROR ("Can't forward packet to invalid port.");
+      return false;
+    }
+
+  // When a packet is sent to OpenFlow pipeline, we keep track of its original
+  // ns3::Packet using the PipelinePacket structure. When the packet is
+  // processed by the pipeline with no internal changes, we forward the
+  // original ns3::Packet to the specified output port. When internal changes
+  // are necessary, we create a new packet replacing only the leading header
+  // bytes of a copy of the original ns3::Packet by the modified ones, keeping
+  // all packet tags. If the changes can't be confined to
+  // the header bytes, we create a new packet with the entire modified content
+  // and copy all packet tags to this new one.
+  Ptr<Packet> packet;
+  Ptr<PipelinePacket> pipePkt = GetPipelinePacket (pkt->ns3_uid);
+  if (pipePkt)
+    {
+      if (pipePkt->m_cacheRecord)
+        {
+          // Record this output for the flow cache. Modified packets can't be
+          // memoized, as the cache forwards the original ns-3 packet.
+          if (pkt->changes)
+            {
+              FlowCacheUncacheable (pkt);
+            }
+          else
+            {
+              OFSwitch13FlowCache::Output output = {portNo, queueNo};
+              pipePkt->m_cacheEntry.outputs.push_back (output);
+
+              // Output ports depend on the input port (e.g., IN_PORT, FLOOD,
+              // and ALL reserved ports, or the input port suppression), but
+              // the cache replays the recorded port numbers. So, megaflows
+              // with outputs must be specific to the input port.
+              pipePkt->m_cacheMask.inPort = 0xffffffff;
+            }
+        }
+
+      if (pkt->changes)
+        {
+          // The original ns-3 packet was modified by OpenFlow switch.
+          // Rewrite the header bytes of the original packet.
+          NS_LOG_DEBUG ("Packet " << pkt->ns3_uid << " modified by switch.");
+          packet = ofs::PacketFromBuffer (pipePkt->GetPacket (), pkt->buffer);
+          if (!packet)
+            {
+              // Create a new packet with modified data and copy tags from the
+              // original packet.
+              packet = ofs::PacketFromBuffer (pkt->buffer);
+              OFSwitch13Device::CopyTags (pipePkt->GetPacket (), packet);
+            }
+        }
+      else
+        {
+          // Using the original ns-3 packet.
+          packet = pipePkt->GetPacket ();
+        }
+    }
+  else
+    {
+      // This is a new packet, probably created by the controller and sent to
+      // the switch within an OpenFlow packet-out message.
+      NS_ASSERT_MSG (pkt->ns3_uid == 0, "Invalid packet ID.");
+      NS_LOG_DEBUG ("Creating new ns-3 packet from OpenFlow buffer.");
+      packet = ofs::PacketFromBuffer (pkt->buffer);
+    }
+
+  // Send the packet to switch port, after the lookup delay of the flow tables
+  // visited by this packet (when using delay models).
+  if (m_egressDelay.IsStrictlyPositive ())
+    {
+      Simulator::Schedule (m_egressDelay, &OFSwitch13Port::Send, port,
+                           packet, queueNo, pkt->tunnel_id);
+      return true;
+    }
+  return port->Send (packet, queueNo, pkt->tunnel_id);
+}
+
+void
+OFSwitch13Device::SendBatchToPipeline (void)
+{
+  NS_LOG_FUNCTION (this << m_batchQueue.size ());
+
+  // With a zero batch window, only the packets that are due now are sent to
+  // pipeline, preserving the exact per-packet timing. Otherwise, packets can
+  // be sent to pipeline up to the batch window in advance.
+  Time limit = Simulator::Now () + m_batchWindow;
+  uint32_t count = 0;
+  while (!m_batchQueue.empty () && count < m_batchSize
+         && m_batchQueue.front ().dueTime <= limit)
+    {
+      IngressPacket ingress = m_batchQueue.front ();
+      m_batchQueue.pop_front ();
+      SendToPipeline (ingress.packet, ingress.portNo, ingress.tunnelId);
+      count++;
+    }
+  m_batchTrace (count);
+
+  // Schedule the next batch for the time the next packet is due. The queue is
+  // sorted by due time, so this is the first packet in the queue.
+  if (!m_batchQueue.empty () && !m_batchEvent.IsRunning ())
+    {
+      Time delay = Max (m_batchQueue.front ().dueTime - Simulator::Now (),
+                        Time (0));
+      m_batchEvent = Simulator::Schedule (
+          delay, &OFSwitch13Device::SendBatchToPipeline, this);
+    }
+}
+
+void
+OFSwitch13Device::SendToPipeline (Ptr<Packet> packet, uint32_t portNo,
+                                  uint64_t tunnelId)
+{
+  NS_LOG_FUNCTION (this << packet << portNo << tunnelId);
+
+  // Extract the packet flow key once, for both the flow cache and the flow
+  // table classifiers.
+  OFSwitch13FlowKey key;
+  bool keyOk = false;
+  if (m_cacheEnable || !m_classifiers.empty ())
+    {
+      keyOk = key.Extract (packet, portNo, tunnelId);
+    }
+
+  // Look for the packet flow in the flow cache.
+  bool cacheable = false;
+  if (m_cacheEnable)
+    {
+      cacheable = keyOk;
+      if (cacheable)
+        {
+          const OFSwitch13FlowCache::Entry *entry = m_flowCache.Lookup (key);
+          if (entry)
+            {
+              NS_LOG_DEBUG ("Packet " << packet->GetUid () << " hit cache.");
+              m_cacheHitTrace (packet);
+              m_egressDelay = Time (0);
+              FlowCacheApply (entry, packet, tunnelId);
+              m_egressDelay = Time (0);
+              return;
+            }
+        }
+      m_cacheMissTrace (packet);
+    }
+
+  // Creating the internal OpenFlow packet structure from ns-3 packet
+  // Allocate buffer with some extra space for OpenFlow packet modifications.
+  uint32_t headRoom = 128 + 2;
+  uint32_t bodyRoom = packet->GetSize () + VLAN_ETH_HEADER_LEN;
+  struct ofpbuf *buffer = ofs::BufferFromPacket (packet, bodyRoom, headRoom);
+  struct packet *pkt = packet_create (m_datapath, portNo, buffer,
+                                      tunnelId, false);
+
+  // Save the ns-3 packet into pipeline structure. Note that we are using a
+  // private packet uid to avoid conflicts with ns3::Packet uid.
+  pkt->ns3_uid = OFSwitch13Device::GetNewPacketId ();
+  Ptr<PipelinePacket> pipePkt = Create<PipelinePacket> (pkt->ns3_uid, packet);
+  PipelinePacketNewId (pkt->ns3_uid, pipePkt);
+
+  // Send the packet to pipeline, recording the result for the flow cache.
+  // The pipeline context may be released before the pipeline returns, but we
+  // still hold a reference to it here.
+  pipePkt->m_cacheRecord = cacheable;
+  pipePkt->m_cacheMaskOk = cacheable && m_cacheMega;
+  pipePkt->m_keyOk = keyOk;
+  if (keyOk)
+    {
+      pipePkt->m_key = key;
+    }
+  m_egressDelay = Time (0);
+  PipelineProcessPacket (m_datapath->pipeline, pkt);
+  m_egressDelay = Time (0);
+
+  // The flow key is only valid for this pipeline run (buffered packets may
+  // come back later in packet-out messages with other actions).
+  pipePkt->m_keyOk = false;
+  if (pipePkt->m_cacheRecord && pipePkt->m_cacheMaskOk)
+    {
+      m_flowCache.Insert (key, pipePkt->m_cacheMask, pipePkt->m_cacheEntry);
+    }
+  else if (pipePkt->m_cacheRecord)
+    {
+      m_flowCache.Insert (key, pipePkt->m_cacheEntry);
+    }
+}
+
+void
+OFSwitch13Device::PipelineProcessPacket (struct pipeline *pl,
+                                         struct packet *pkt)
+{
+  NS_LOG_FUNCTION (this << pkt->ns3_uid);
+
+  // Packets with invalid TTL never get a flow key, so the TTL check (which
+  // requires the library packet match structure) is skipped for packets
+  // with a valid key.
+  Ptr<PipelinePacket> pipePkt = GetPipelinePacket (pkt->ns3_uid);
+  if (!(pipePkt && pipePkt->m_keyOk)
+      && !packet_handle_std_is_ttl_valid (pkt->handle_std))
+    {
+      send_packet_to_controller (pl, pkt, 0, OFPR_INVALID_TTL);
+      packet_destroy (pkt);
+      return;
+    }
+
+  struct flow_table *table;
+  struct flow_table *nextTable = pl->tables [0];
+  while (nextTable)
+    {
+      pkt->table_id = nextTable->stats->table_id;
+      table = nextTable;
+      nextTable = 0;
+
+      struct flow_entry *entry =
+        FlowTableLookup (table, pkt, PipelineGetFlowKey (pipePkt, pkt));
+      PipelineAddTableDelay (table, entry);
+      if (pipePkt && pipePkt->m_cacheRecord)
+        {
+          OFSwitch13FlowCache::Visit visit = {table, entry, 0};
+          pipePkt->m_cacheEntry.visits.push_back (visit);
+          FlowCacheAddMask (pipePkt, table, entry);
+        }
+
+      if (!entry)
+        {
+          // OpenFlow 1.3 default behavior on a table miss.
+          NS_LOG_DEBUG ("No matching entry found. Dropping packet.");
+          packet_destroy (pkt);
+          return;
+        }
+
+      pkt->handle_std->table_miss =
+        (entry->stats->priority == 0 && entry->match->length <= 4);
+      PipelineExecuteEntry (pl, entry, &nextTable, &pkt);
+
+      // Packet could be destroyed by a meter instruction.
+      if (!pkt)
+        {
+          return;
+        }
+
+      if (!nextTable)
+        {
+          // Cookie field is set 0xffffffffffffffff because we cannot
+          // associate it to any particular flow.
+          action_set_execute (pkt->action_set, pkt, 0xffffffffffffffff);
+          packet_destroy (pkt);
+          return;
+        }
+    }
+}
+
+void
+OFSwitch13Device::PipelineExecuteEntry (struct pipeline *pl,
+                                        struct flow_entry *entry,
+                                        struct flow_table **nextTable,
+                                        struct packet **pkt)
+{
+  NS_LOG_FUNCTION (this << (*pkt)->ns3_uid);
+
+  for (size_t i = 0; i < entry->stats->instructions_num; i++)
+    {
+      // Packet was dropped by some instruction or action.
+      if (!(*pkt))
+        {
+          return;
+        }
+
+      struct ofl_instruction_header *inst = entry->stats->instructions [i];
+      switch (inst->type)
+        {
+        case (OFPIT_GOTO_TABLE):
+          {
+            struct ofl_instruction_goto_table *gi =
+              (struct ofl_instruction_goto_table*)inst;
+            *nextTable = pl->tables [gi->table_id];
+            break;
+          }
+        case (OFPIT_WRITE_METADATA):
+          {
+            struct ofl_instruction_write_metadata *wi =
+              (struct ofl_instruction_write_metadata*)inst;
+            struct ofl_match_tlv *f;
+
+            packet_handle_std_validate ((*pkt)->handle_std);
+            HMAP_FOR_EACH_WITH_HASH (f, struct ofl_match_tlv, hmap_node,
+                                     hash_int (OXM_OF_METADATA, 0),
+                                     &(*pkt)->handle_std->match.match_fields)
+            {
+              uint64_t *metadata = (uint64_t*)f->value;
+              *metadata = (*metadata & ~wi->metadata_mask)
+                | (wi->metadata & wi->metadata_mask);
+            }
+
+            // Keep the flow key in sync with the packet metadata.
+            Ptr<PipelinePacket> pipePkt = GetPipelinePacket ((*pkt)->ns3_uid);
+            if (pipePkt && pipePkt->m_keyOk)
+              {
+                uint64_t &metadata = pipePkt->m_key.metadata;
+                metadata = (metadata & ~wi->metadata_mask)
+                  | (wi->metadata & wi->metadata_mask);
+              }
+            break;
+          }
+        case (OFPIT_WRITE_ACTIONS):
+        case (OFPIT_APPLY_ACTIONS):
+          {
+            struct ofl_instruction_actions *ia =
+              (struct ofl_instruction_actions*)inst;
+
+            // Only output and set queue actions can be memoized by the flow
+            // cache (other actions modify the packet or depend on groups).
+            // The flow key holds the tunnel ID given by the input port, so it
+            // can't be parsed again after a set field action on this field.
+            bool modify = false;
+            bool reparse = true;
+            for (size_t j = 0; j < ia->actions_num; j++)
+              {
+                struct ofl_action_header *action = ia->actions [j];
+                if (action->type != OFPAT_OUTPUT
+                    && action->type != OFPAT_SET_QUEUE)
+                  {
+                    modify = true;
+                  }
+                if (action->type == OFPAT_SET_FIELD
+                    && ((struct ofl_action_set_field*)action)->field->header
+                    == OXM_OF_TUNNEL_ID)
+                  {
+                    reparse = false;
+                  }
+              }
+            if (modify)
+              {
+                FlowCacheUncacheable (*pkt);
+              }
+
+            if (inst->type == OFPIT_WRITE_ACTIONS)
+              {
+                action_set_write_actions ((*pkt)->action_set,
+                                          ia->actions_num, ia->actions);
+              }
+            else
+              {
+                if (modify)
+                  {
+                    PipelineFlowKeyStale (*pkt, reparse);
+                  }
+                dp_execute_action_list ((*pkt), ia->actions_num, ia->actions,
+                                        entry->stats->cookie);
+              }
+            break;
+          }
+        case (OFPIT_CLEAR_ACTIONS):
+          {
+            action_set_clear_actions ((*pkt)->action_set);
+            break;
+          }
+        case (OFPIT_METER):
+          {
+            struct ofl_instruction_meter *im =
+              (struct ofl_instruction_meter*)inst;
+            FlowCacheUncacheable (*pkt);
+            PipelineFlowKeyStale (*pkt, true);
+
+            // Refill the meter bucket with tokens based on the time elapsed
+            // since the last refill, just before applying the meter. This
+            // replaces the periodic meter_table_add_tokens () refill.
+            struct meter_entry *meter =
+              meter_table_find (pl->dp->meters, im->meter_id);
+            if (meter)
+              {
+                refill_bucket (meter);
+              }
+            meter_table_apply (pl->dp->meters, pkt, im->meter_id);
+            break;
+          }
+        case (OFPIT_EXPERIMENTER):
+          {
+            FlowCacheUncacheable (*pkt);
+            PipelineFlowKeyStale (*pkt, false);
+            dp_exp_inst ((*pkt), (struct ofl_instruction_experimenter*)inst);
+            break;
+          }
+        }
+    }
+}
+
+void
+OFSwitch13Device::FlowCacheApply (const OFSwitch13FlowCache::Entry *entry,
+                                  Ptr<Packet> packet, uint64_t tunnelId)
+{
+  NS_LOG_FUNCTION (this << packet << tunnelId);
+
+  // Update the counters just like flow_table_lookup () does.
+  uint32_t pktSize = packet->GetSize ();
+  long long int now = time_msec ();
+  for (auto const &visit : entry->visits)
+    {
+      visit.table->stats->lookup_count++;
+      if (visit.entry)
+        {
+          if (!visit.entry->no_byt_count)
+            {
+              visit.entry->stats->byte_count += pktSize;
+            }
+          if (!visit.entry->no_pkt_count)
+            {
+              visit.entry->stats->packet_count++;
+            }
+          visit.entry->last_used = now;
+          visit.table->stats->matched_count++;
+        }
+      PipelineAddTableDelay (visit.table, visit.entry);
+    }
+
+  // Send the original packet to the output ports.
+  for (auto const &output : entry->outputs)
+    {
+      Ptr<OFSwitch13Port> port = GetSwitchPort (output.portNo);
+      if (m_egressDelay.IsStrictlyPositive ())
+        {
+          Simulator::Schedule (m_egressDelay, &OFSwitch13Port::Send, port,
+                               packet, output.queueNo, tunnelId);
+          continue;
+        }
+      port->Send (packet, output.queueNo, tunnelId);
+    }
+}
+
+void
+OFSwitch13Device::PipelineAddTableDelay (struct flow_table *table,
+                                         struct flow_entry *entry)
+{
+  // In two-tier mode, the fast tier is always searched first, and the slow
+  // tier is only searched on fast tier misses. The tier delays replace the
+  // table delay model.
+  uint8_t tableId = table->stats->table_id;
+  if (GetFlowTableTierSize (tableId))
+    {
+      Time fastDelay = m_tierFastDelay;
+      Time slowDelay = m_tierSlowDelay;
+      if (!m_tierConfigs.empty ())
+        {
+          fastDelay = m_tierConfigs [tableId].fastDelay;
+          slowDelay = m_tierConfigs [tableId].slowDelay;
+        }
+
+      m_tierLookups++;
+      m_egressDelay += fastDelay;
+      if (entry && TierIsFast (table, entry))
+        {
+          m_tierFastHits++;
+          return;
+        }
+      m_egressDelay += slowDelay;
+      if (entry)
+        {
+          m_tierSlowHits++;
+        }
+      return;
+    }
+
+  Ptr<OFSwitch13PipelineDelayModel> model = GetFlowTableDelayModel (tableId);
+  if (model)
+    {
+      m_egressDelay += model->GetDelay (tableId, table->stats->active_count,
+                                        table->features->max_entries);
+    }
+}
+
+bool
+OFSwitch13Device::TierIsFast (struct flow_table *table,
+                              struct flow_entry *entry)
+{
+  // Flow entries may be freed and reallocated at the same address between
+  // rebalances, so the creation time is also checked.
+  auto it = m_tierEntries.find (entry);
+  if (it != m_tierEntries.end () && it->second.created == entry->created)
+    {
+      return it->second.fast;
+    }
+
+  uint8_t tableId = table->stats->table_id;
+  m_tierFastCount.resize (GetNPipelineTables (), 0);
+  bool fast = m_tierFastCount [tableId] < GetFlowTableTierSize (tableId);
+  if (fast)
+    {
+      m_tierFastCount [tableId]++;
+    }
+  TierEntry tier = {entry->created, 0, fast};
+  m_tierEntries [entry] = tier;
+  return fast;
+}
+
+void
+OFSwitch13Device::TierRebalance (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // Candidate entry for the fast tier. Hot entries come first (hottest
+  // first), followed by the current fast tier entries, which are only demoted
+  // when displaced by hot entries.
+  struct Candidate
+  {
+    static bool Before (const Candidate &a, const Candidate &b)
+    {
+      if (a.hot != b.hot)
+        {
+          return a.hot;
+        }
+      if (a.hits != b.hits)
+        {
+          return a.hits > b.hits;
+        }
+      return a.fast && !b.fast;
+    }
+
+    uint64_t            hits;   // Hits since last rebalance.
+    bool                hot;    // Enough hits for promotion.
+    bool                fast;   // Currently in the fast tier.
+    struct flow_entry*  entry;  // The flow entry.
+  };
+
+  // The state map is rebuilt from the entries currently in the tables, so
+  // removed entries are discarded.
+  TierEntryMap_t tierEntries;
+  std::vector<Candidate> candidates;
+  m_tierFastCount.assign (GetNPipelineTables (), 0);
+  for (uint32_t i = 0; i < GetNPipelineTables (); i++)
+    {
+      uint32_t fastSize = GetFlowTableTierSize (i);
+      if (fastSize == 0)
+        {
+          continue;
+        }
+
+      struct flow_table *table = m_datapath->pipeline->tables [i];
+      struct flow_entry *entry;
+      candidates.clear ();
+      LIST_FOR_EACH (entry, struct flow_entry, match_node,
+                     &table->match_entries)
+      {
+        Candidate cand = {entry->stats->packet_count, false, false, entry};
+        auto it = m_tierEntries.find (entry);
+        if (it != m_tierEntries.end () && it->second.created == entry->created)
+          {
+            cand.hits -= std::min (cand.hits, it->second.packets);
+            cand.fast = it->second.fast;
+          }
+        cand.hot = cand.hits >= m_tierPromote;
+        candidates.push_back (cand);
+      }
+
+      std::stable_sort (candidates.begin (), candidates.end (),
+                        Candidate::Before);
+
+      for (auto const &cand : candidates)
+        {
+          bool fast = (cand.hot || cand.fast)
+            && m_tierFastCount [i] < fastSize;
+          if (fast)
+            {
+              m_tierFastCount [i]++;
+            }
+          TierEntry tier = {cand.entry->created,
+                            cand.entry->stats->packet_count, fast};
+          tierEntries [cand.entry] = tier;
+        }
+    }
+  m_tierEntries.swap (tierEntries);
+}
+
+Ptr<OFSwitch13Device::PipelinePacket>
+OFSwitch13Device::GetPipelinePacket (uint64_t id) const
+{
+  auto it = m_pipePkts.find (id);
+  if (it != m_pipePkts.end ())
+    {
+      return it->second;
+    }
+  return 0;
+}
+
+void
+OFSwitch13Device::PipelinePacketNewId (uint64_t id,
+                                       Ptr<PipelinePacket> pipePkt)
+{
+  pipePkt->NewCopy (id);
+  auto ret = m_pipePkts.insert (std::make_pair (id, pipePkt));
+  NS_ABORT_MSG_IF (ret.second == false, "Packet ID already in pipeline.");
+}
+
+bool
+OFSwitch13Device::PipelinePacketDelId (uint64_t id)
+{
+  auto it = m_pipePkts.find (id);
+  NS_ASSERT_MSG (it != m_pipePkts.end (), "Packet ID not in pipeline.");
+  bool valid = it->second->DelCopy (id);
+  m_pipePkts.erase (it);
+  return valid;
+}
+
+const OFSwitch13FlowKey*
+OFSwitch13Device::PipelineGetFlowKey (Ptr<PipelinePacket> pipePkt,
+                                      struct packet *pkt)
+{
+  if (!pipePkt || !pipePkt->m_keyOk)
+    {
+      return 0;
+    }
+
+  if (pipePkt->m_keyStale)
+    {
+      // Parse the modified packet headers, keeping the fields that don't
+      // come from the packet bytes.
+      OFSwitch13FlowKey &key = pipePkt->m_key;
+      uint64_t metadata = key.metadata;
+      pipePkt->m_keyOk = key.Extract ((uint8_t*)pkt->buffer->data,
+                                      pkt->buffer->size, key.inPort,
+                                      key.tunnelId);
+      key.metadata = metadata;
+      pipePkt->m_keyStale = false;
+    }
+  return pipePkt->m_keyOk ? &pipePkt->m_key : 0;
+}
+
+void
+OFSwitch13Device::PipelineFlowKeyStale (struct packet *pkt, bool reparse)
+{
+  Ptr<PipelinePacket> pipePkt = GetPipelinePacket (pkt->ns3_uid);
+  if (pipePkt)
+    {
+      pipePkt->m_keyStale = true;
+      pipePkt->m_keyOk = pipePkt->m_keyOk && reparse;
+    }
+}
+
+void
+OFSwitch13Device::FlowCacheAddMask (Ptr<PipelinePacket> pipePkt,
+                                    struct flow_table *table,
+                                    struct flow_entry *entry)
+{
+  struct flow_entry *examined;
+  LIST_FOR_EACH (examined, struct flow_entry, match_node,
+                 &table->match_entries)
+  {
+    if (!pipePkt->m_cacheMaskOk)
+      {
+        return;
+      }
+
+    // Same match structure used by flow_table_lookup ().
+    struct ofl_match_header *m = examined->match ? examined->match :
+      examined->stats->match;
+    if (m->type != OFPMT_OXM
+        || !pipePkt->m_cacheMask.AddMatchMask ((struct ofl_match*)m))
+      {
+        pipePkt->m_cacheMaskOk = false;
+      }
+    if (examined == entry)
+      {
+        return;
+      }
+  }
+}
+
+void
+OFSwitch13Device::FlowCacheUncacheable (struct packet *pkt)
+{
+  Ptr<PipelinePacket> pipePkt = GetPipelinePacket (pkt->ns3_uid);
+  if (pipePkt)
+    {
+      pipePkt->m_cacheRecord = false;
+    }
+}
+
+void
+OFSwitch13Device::FlowCacheFlush (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_flowCache.Flush ();
+}
+
+void
+OFSwitch13Device::FlowCacheInvalidate (uint8_t tableId)
+{
+  NS_LOG_FUNCTION (this << (uint16_t)tableId);
+
+  m_flowCache.Invalidate (tableId);
+}
+
+int
+OFSwitch13Device::SendToController (Ptr<Packet> packet,
+                                    Ptr<RemoteController> remoteCtrl)
+{
+  if (!remoteCtrl->m_socket)
+    {
+      NS_LOG_ERROR ("No controller connection. Discarding message.");
+      return -1;
     }
-  msg.match = (struct ofl_match_header*) &pkt->handle_std->match;
 
-  // Increase packet-in counter and send the message.
-  m_cPacketIn++;
-  return dp_send_message (pkt->dp, (struct ofl_msg_header *)&msg, 0);
+  // TODO: No support for auxiliary connections.
+  return remoteCtrl->m_handler->SendMessage (packet);
 }
 
-bool
-OFSwitch13Device::SendToSwitchPort (struct packet *pkt, uint32_t portNo,
-                                    uint32_t queueNo)
+void
+OFSwitch13Device::ReceiveFromController (Ptr<Packet> packet, Address from)
 {
-  NS_LOG_FUNCTION (this << pkt->ns3_uid << portNo);
+  NS_LOG_FUNCTION (this << packet << from);
 
-  Ptr<OFSwitch13Port> port = GetSwitchPort (portNo);
-  if (!port)
+  // Only flow mods wait for the rule update time. Barriers wait behind the
+  // flow mods still in the queue, and other messages are processed now.
+  struct ofp_header header;
+  header.type = OFPT_HELLO;
+  if (packet->GetSize () >= sizeof (struct ofp_header))
     {
-      NS_LOG_ERROR ("Can't forward packet to invalid port.");
-      return false;
+      packet->CopyData ((uint8_t*)&header, sizeof (struct ofp_header));
     }
-
-  // When a packet is sent to OpenFlow pipeline, we keep track of its original
-  // ns3::Packet using the PipelinePacket structure. When the packet is
-  // processed by the pipeline with no internal changes, we forward the
-  // original ns3::Packet to the specified output port. When internal changes
-  // are necessary, we need to create a new packet with the modified content
-  // and copy all packet tags to this new one. This approach is more expensive
-  // than the previous one, but is far more simple than identifying which
-  // changes were performed in the packet to modify the original ns3::Packet.
-  Ptr<Packet> packet;
-  if (m_pipePkt.IsValid ())
+  bool queued = !m_ctrlQueue.empty ();
+  if (header.type == OFPT_FLOW_MOD)
     {
-      NS_ASSERT_MSG (m_pipePkt.HasId (pkt->ns3_uid), "Invalid packet ID.");
-      if (pkt->changes)
-        {
-          // The original ns-3 packet was modified by OpenFlow switch.
-          // Create a new packet with modified data and copy tags from the
-          // original packet.
-          NS_LOG_DEBUG ("Packet " << pkt->ns3_uid << " modified by switch.");
-          packet = ofs::PacketFromBuffer (pkt->buffer);
-          OFSwitch13Device::CopyTags (m_pipePkt.GetPacket (), packet);
-        }
-      else
-        {
-          // Using the original ns-3 packet.
-          packet = m_pipePkt.GetPacket ();
-        }
+      queued = queued || !m_ruleDelay.IsZero () || !m_ruleShift.IsZero ();
     }
-  else
+  else if (header.type != OFPT_BARRIER_REQUEST)
     {
-      // This is a new packet, probably created by the controller and sent to
-      // the switch within an OpenFlow packet-out message.
-      NS_ASSERT_MSG (pkt->ns3_uid == 0, "Invalid packet ID.");
-      NS_LOG_DEBUG ("Creating new ns-3 packet from OpenFlow buffer.");
-      packet = ofs::PacketFromBuffer (pkt->buffer);
+      queued = false;
+    }
+  if (!queued)
+    {
+      ProcessFromController (packet, from);
+      return;
     }
 
-  // Send the packet to switch port.
-  return port->Send (packet, queueNo, pkt->tunnel_id);
+  CtrlMessage ctrlMsg = {packet, from, Simulator::Now (), 0};
+  m_ctrlQueue.push_back (ctrlMsg);
+  if (!m_ctrlEvent.IsRunning ())
+    {
+      CtrlQueueStart ();
+    }
 }
 
 void
-OFSwitch13Device::SendToPipeline (Ptr<Packet> packet, uint32_t portNo,
-                                  uint64_t tunnelId)
+OFSwitch13Device::CtrlQueueStart (void)
 {
-  NS_LOG_FUNCTION (this << packet << portNo << tunnelId);
+  NS_LOG_FUNCTION (this << m_ctrlQueue.size ());
 
-  NS_ASSERT_MSG (!m_pipePkt.IsValid (), "Another packet in pipeline.");
+  CtrlMessage &ctrlMsg = m_ctrlQueue.front ();
+  Time updateTime = CtrlRuleUpdateTime (ctrlMsg.packet);
+  ctrlMsg.updateBits = m_cpuCapacity.GetBitRate () * updateTime.GetSeconds ();
+  m_ctrlEvent = Simulator::Schedule (
+      updateTime, &OFSwitch13Device::CtrlQueueDone, this);
+}
 
-  // Creating the internal OpenFlow packet structure from ns-3 packet
-  // Allocate buffer with some extra space for OpenFlow packet modifications.
-  uint32_t headRoom = 128 + 2;
-  uint32_t bodyRoom = packet->GetSize () + VLAN_ETH_HEADER_LEN;
-  struct ofpbuf *buffer = ofs::BufferFromPacket (packet, bodyRoom, headRoom);
-  struct packet *pkt = packet_create (m_datapath, portNo, buffer,
-                                      tunnelId, false);
+void
+OFSwitch13Device::CtrlQueueDone (void)
+{
+  NS_LOG_FUNCTION (this << m_ctrlQueue.size ());
 
-  // Save the ns-3 packet into pipeline structure. Note that we are using a
-  // private packet uid to avoid conflicts with ns3::Packet uid.
-  pkt->ns3_uid = OFSwitch13Device::GetNewPacketId ();
-  m_pipePkt.SetPacket (pkt->ns3_uid, packet);
+  CtrlMessage ctrlMsg = m_ctrlQueue.front ();
+  m_ctrlQueue.pop_front ();
+
+  // The rule update consumes CPU processing tokens as well, competing with
+  // the packets received from switch ports. They are charged when the flow
+  // mod takes effect, and ProcessFromController () wakes the device.
+  if (ctrlMsg.updateBits)
+    {
+      CpuTokensRefill ();
+      m_cpuTokens -= std::min (m_cpuTokens, ctrlMsg.updateBits);
+      m_cpuConsumed += ctrlMsg.updateBits;
+    }
+
+  struct ofp_header header;
+  ctrlMsg.packet->CopyData ((uint8_t*)&header, sizeof (struct ofp_header));
+  if (header.type == OFPT_FLOW_MOD)
+    {
+      m_flowModTrace (Simulator::Now () - ctrlMsg.arrival);
+    }
+  ProcessFromController (ctrlMsg.packet, ctrlMsg.from);
 
-  // Send the packet to pipeline.
-  pipeline_process_packet (m_datapath->pipeline, pkt);
+  if (!m_ctrlQueue.empty ())
+    {
+      CtrlQueueStart ();
+    }
 }
 
-int
-OFSwitch13Device::SendToController (Ptr<Packet> packet,
-                                    Ptr<RemoteController> remoteCtrl)
+Time
+OFSwitch13Device::CtrlRuleUpdateTime (Ptr<const Packet> packet) const
 {
-  if (!remoteCtrl->m_socket)
+  struct ofp_flow_mod flowMod;
+  if (packet->GetSize () < sizeof (struct ofp_flow_mod))
     {
-      NS_LOG_ERROR ("No controller connection. Discarding message.");
-      return -1;
+      return Time (0);
+    }
+  packet->CopyData ((uint8_t*)&flowMod, sizeof (struct ofp_flow_mod));
+  if (flowMod.header.type != OFPT_FLOW_MOD)
+    {
+      return Time (0);
     }
 
-  // TODO: No support for auxiliary connections.
-  return remoteCtrl->m_handler->SendMessage (packet);
+  // Adding a new entry to a table requires shifting all lower priority
+  // entries. The match entries list is sorted by decreasing priority.
+  Time updateTime = m_ruleDelay;
+  if (flowMod.command == OFPFC_ADD && !m_ruleShift.IsZero ()
+      && flowMod.table_id < GetNPipelineTables ())
+    {
+      uint16_t priority = ntohs (flowMod.priority);
+      struct flow_table *table = m_datapath->pipeline->tables [flowMod.table_id];
+      struct flow_entry *entry;
+      int64_t shifted = 0;
+      LIST_FOR_EACH (entry, struct flow_entry, match_node,
+                     &table->match_entries)
+      {
+        if (entry->stats->priority < priority)
+          {
+            shifted++;
+          }
+      }
+      updateTime += m_ruleShift * shifted;
+    }
+  return updateTime;
 }
 
 void
-OFSwitch13Device::ReceiveFromController (Ptr<Packet> packet, Address from)
+OFSwitch13Device::ProcessFromController (Ptr<Packet> packet, Address from)
 {
   NS_LOG_FUNCTION (this << packet << from);
 
   struct ofl_msg_header *msg;
   ofl_err error;
 
+  // Messages queued before the controller connection was closed are
+  // discarded.
   Ptr<RemoteController> remoteCtrl = GetRemoteController (from);
-  NS_ASSERT_MSG (remoteCtrl, "Error returning controller for this address.");
+  if (!remoteCtrl || !remoteCtrl->m_remote)
+    {
+      NS_LOG_WARN ("No controller connection. Discarding message.");
+      return;
+    }
+  if (!m_groupAwake)
+    {
+      TimeoutGroupWake ();
+    }
 
   struct sender senderCtrl;
   senderCtrl.remote = remoteCtrl->m_remote;
   senderCtrl.conn_id = 0; // TODO No support for auxiliary connections
 
   // Get the OpenFlow buffer and unpack the message.
-  struct ofpbuf *buffer = ofs::BufferFromPacket (packet, packet->GetSize ());
+  struct ofpbuf *buffer = m_bufPool.BufferFromPacket (packet,
+                                                      packet->GetSize ());
   error = ofl_msg_unpack ((uint8_t*)buffer->data, buffer->size, &msg,
                           &senderCtrl.xid, m_datapath->exp);
 
@@ -1032,7 +3331,7 @@ OFSwitch13Device::ReceiveFromController (Ptr<Packet> packet, Address from)
           // This is not a hello message or the advertised version is lower
           // than OFP_VERSION. Notify the error and return.
           ReplyWithErrorMessage (error, buffer, &senderCtrl);
-          ofpbuf_delete (buffer);
+          m_bufPool.Put (buffer);
           return;
         }
       else
@@ -1049,7 +3348,7 @@ OFSwitch13Device::ReceiveFromController (Ptr<Packet> packet, Address from)
             {
               // Notify the error and return.
               ReplyWithErrorMessage (error, buffer, &senderCtrl);
-              ofpbuf_delete (buffer);
+              m_bufPool.Put (buffer);
               return;
             }
         }
@@ -1089,8 +3388,211 @@ OFSwitch13Device::ReceiveFromController (Ptr<Packet> packet, Address from)
       }
     }
 
+  // Save the flow mod information required to update the flow timing wheel,
+  // as the message will be freed by the handler.
+  struct flow_table *addTable = 0;
+  uint16_t idleTimeout = 0;
+  uint16_t hardTimeout = 0;
+  uint32_t addSlices = 0;
+  uint16_t addPriority = 0;
+  bool addClassify = false;
+  OFSwitch13FlowKey addValue;
+  OFSwitch13FlowKey addMask;
+  struct flow_entry *addOld = 0;
+  struct ofl_match_header *addMatch = 0;
+  Ptr<OFSwitch13Classifier> delClassifier;
+  struct flow_entry *delEntry = 0;
+  uint8_t delTableId = 0;
+  bool flowModify = false;
+  uint8_t flowModTable = 0;
+  if (msg->type == OFPT_FLOW_MOD)
+    {
+      struct ofl_msg_flow_mod *flowMod = (struct ofl_msg_flow_mod*)msg;
+      flowModTable = flowMod->table_id;
+      flowModify = flowMod->command == OFPFC_MODIFY
+        || flowMod->command == OFPFC_MODIFY_STRICT;
+      if (flowMod->command == OFPFC_ADD
+          && flowMod->table_id < GetNPipelineTables ())
+        {
+          addTable = m_datapath->pipeline->tables [flowMod->table_id];
+          idleTimeout = flowMod->idle_timeout;
+          hardTimeout = flowMod->hard_timeout;
+          addPriority = flowMod->priority;
+          addMatch = flowMod->match;
+          addOld = FlowTableFind (addTable, flowMod->match,
+                                  flowMod->priority);
+          if (GetFlowTableClassifier (flowMod->table_id) != CLASSIFIER_LINEAR
+              && flowMod->match->type == OFPMT_OXM)
+            {
+              addClassify = addValue.SetMatch (
+                  (struct ofl_match*)flowMod->match, &addMask);
+            }
+
+          // Exact-match tables only accept entries fitting the hash table.
+          if (GetFlowTableClassifier (flowMod->table_id) == CLASSIFIER_EXACT)
+            {
+              OFSwitch13ExactClassifier *exact =
+                static_cast<OFSwitch13ExactClassifier*> (
+                  PeekPointer (FlowClassifierGet (flowMod->table_id)));
+              error = exact->CheckMatch (flowMod->match, flowMod->priority,
+                                         flowMod->flags);
+            }
+
+          // Check for TCAM slices available for the new entry, evicting
+          // entries to make room for it when possible. An entry replacing an
+          // identical one keeps the same slices, and an entry wider than the
+          // whole table is rejected before evicting anything.
+          uint32_t tableSlices = GetFlowTableSlices (flowMod->table_id);
+          if (!error && !addOld && tableSlices)
+            {
+              FlowTableSlicesSync ();
+              addSlices = FlowEntrySlices (flowMod->match);
+              uint32_t freeSlices = tableSlices - std::min (
+                  tableSlices, GetFlowTableUsedSlices (flowMod->table_id));
+              while (addSlices <= tableSlices && addSlices > freeSlices
+                     && m_evictPolicy != EVICT_NONE
+                     && FlowTableEvict (addTable))
+                {
+                  freeSlices = tableSlices - std::min (
+                      tableSlices, GetFlowTableUsedSlices (flowMod->table_id));
+                }
+              if (addSlices > freeSlices)
+                {
+                  NS_LOG_DEBUG ("No TCAM slices available for new entry.");
+                  error = ofl_error (OFPET_FLOW_MOD_FAILED,
+                                     OFPFMFC_TABLE_FULL);
+                }
+            }
+        }
+      else if (flowMod->command == OFPFC_DELETE_STRICT
+               && flowMod->table_id < GetNPipelineTables ())
+        {
+          // The entry removed by a strict delete is freed by the library, so
+          // it's removed from the flow table classifier in advance.
+          delTableId = flowMod->table_id;
+          delClassifier = FlowClassifierGet (flowMod->table_id);
+          delEntry = FlowTableFind (
+              m_datapath->pipeline->tables [flowMod->table_id],
+              flowMod->match, flowMod->priority);
+          if (delEntry && delClassifier)
+            {
+              delClassifier->Remove (delEntry);
+            }
+        }
+    }
+  uint32_t flowEntries = GetSumFlowEntries ();
+
   // Send the message to handler.
-  error = handle_control_msg (m_datapath, msg, &senderCtrl);
+  enum ofp_type msgType = msg->type;
+  if (!error)
+    {
+      error = handle_control_msg (m_datapath, msg, &senderCtrl);
+
+      // Make room for the new entry when the library rejects it because the
+      // flow table is full, and retry. The library only reports a full table
+      // after validating the flow mod and checking for an identical entry to
+      // replace, so no entry is evicted for replacements or invalid requests.
+      if (addTable && m_evictPolicy != EVICT_NONE
+          && error == ofl_error (OFPET_FLOW_MOD_FAILED, OFPFMFC_TABLE_FULL)
+          && FlowTableEvict (addTable))
+        {
+          flowEntries = GetSumFlowEntries ();
+          error = handle_control_msg (m_datapath, msg, &senderCtrl);
+        }
+    }
+  FlowTimersUpdate (error ? 0 : addTable, idleTimeout, hardTimeout,
+                    flowEntries, error ? 0 : (addTable ? addOld : delEntry));
+
+  // Update the TCAM slices used by the flow table with the new entry, or
+  // recompute them later on any other flow table change.
+  if (addSlices && !error && !m_tcamUsedSync
+      && GetSumFlowEntries () == flowEntries + 1)
+    {
+      m_tcamUsed [addTable->stats->table_id] += addSlices;
+    }
+  else if (msgType == OFPT_FLOW_MOD || msgType == OFPT_GROUP_MOD
+           || msgType == OFPT_METER_MOD)
+    {
+      m_tcamUsedSync = true;
+    }
+
+  // Insert the new entry into the flow table classifier, or reinsert the
+  // entry that was not removed by a strict delete. Rebuild the classifiers
+  // later on any other flow table change (flow modifications keep the entry
+  // matches, so they don't change the classifiers).
+  uint32_t newFlowEntries = GetSumFlowEntries ();
+  bool delDone = delEntry && newFlowEntries + 1 == flowEntries;
+  if (addTable && !error && newFlowEntries == flowEntries + 1)
+    {
+      uint8_t tableId = addTable->stats->table_id;
+      if (addClassify)
+        {
+          FlowClassifierAdd (addTable, addPriority, addValue, addMask);
+        }
+      else if (GetFlowTableClassifier (tableId) != CLASSIFIER_LINEAR)
+        {
+          m_classifiers [tableId]->Clear ();
+        }
+    }
+  else if (delEntry && delClassifier && newFlowEntries == flowEntries)
+    {
+      delClassifier->Insert (delEntry);
+    }
+  else if ((addTable && !error) || (newFlowEntries != flowEntries && !delDone))
+    {
+      FlowClassifiersInvalidate ();
+    }
+
+  // Insert the new entry into the flow table eviction index, or drop the
+  // entries removed by a replacement or by a strict delete. Rebuild the
+  // indexes later on any other flow table change (flow modifications may
+  // reset the entry counters). The library keeps the flow mod match in the
+  // new entry, so it can still be used to find the entry.
+  if (m_evictPolicy != EVICT_NONE)
+    {
+      bool replaced = addOld && newFlowEntries == flowEntries;
+      if (addTable && !error && (newFlowEntries == flowEntries + 1 || replaced))
+        {
+          if (replaced)
+            {
+              FlowEvictIndexRemove (addTable->stats->table_id, addOld);
+            }
+          FlowEvictIndexAdd (addTable,
+                             FlowTableFind (addTable, addMatch, addPriority));
+        }
+      else if (delDone)
+        {
+          FlowEvictIndexRemove (delTableId, delEntry);
+        }
+      else if (newFlowEntries != flowEntries || (flowModify && !error))
+        {
+          FlowEvictIndexInvalidate ();
+        }
+    }
+
+  // Invalidate the flow cache on any message that may change the datapath
+  // state. Flow mods only change the target flow table (or all of them).
+  switch (msgType)
+    {
+    case (OFPT_FLOW_MOD):
+      {
+        FlowCacheInvalidate (flowModTable);
+        FlowTableVacancyCheck ();
+        break;
+      }
+    case (OFPT_GROUP_MOD):
+    case (OFPT_METER_MOD):
+    case (OFPT_PORT_MOD):
+    case (OFPT_TABLE_MOD):
+    case (OFPT_EXPERIMENTER):
+      {
+        FlowCacheFlush ();
+        break;
+      }
+    default:
+      {
+      }
+    }
   if (error)
     {
       // It is assumed that if a handler returns with error, it did not use any
@@ -1101,8 +3603,8 @@ OFSwitch13Device::ReceiveFromController (Ptr<Packet> packet, Address from)
       ReplyWithErrorMessage (error, buffer, &senderCtrl);
     }
 
-  // If we got here, let's free the buffer.
-  ofpbuf_delete (buffer);
+  // If we got here, let's release the buffer.
+  m_bufPool.Put (buffer);
 }
 
 int
@@ -1134,6 +3636,7 @@ OFSwitch13Device::SocketCtrlSucceeded (Ptr<Socket> socket)
   NS_LOG_INFO ("Controller accepted connection request!");
   Ptr<RemoteController> remoteCtrl = GetRemoteController (socket);
   remoteCtrl->m_remote = remote_create (m_datapath, 0, 0);
+  m_remoteCtrls [remoteCtrl->m_remote] = remoteCtrl;
 
   // As we have more than one socket that is used for communication between
   // this OpenFlow switch device and controllers, we need to handle the process
@@ -1142,6 +3645,9 @@ OFSwitch13Device::SocketCtrlSucceeded (Ptr<Socket> socket)
   remoteCtrl->m_handler = CreateObject<OFSwitch13SocketHandler> (socket);
   remoteCtrl->m_handler->SetReceiveCallback (
     MakeCallback (&OFSwitch13Device::ReceiveFromController, this));
+  socket->SetCloseCallbacks (
+    MakeCallback (&OFSwitch13Device::SocketCtrlClosed, this),
+    MakeCallback (&OFSwitch13Device::SocketCtrlClosed, this));
 
   // Send the OpenFlow Hello message.
   struct ofl_msg_header msg;
@@ -1160,18 +3666,16 @@ OFSwitch13Device::SocketCtrlFailed (Ptr<Socket> socket)
   NS_LOG_FUNCTION (this << socket);
 
   NS_LOG_ERROR ("Controller did not accepted connection request!");
+  RemoveRemoteController (socket);
+}
 
-  // Loop over controllers looking for the one associated to this socket and
-  // remove it from the collection.
-  for (auto it = m_controllers.begin (); it != m_controllers.end (); it++)
-    {
-      Ptr<RemoteController> remoteCtrl = *it;
-      if (remoteCtrl->m_socket == socket)
-        {
-          m_controllers.erase (it);
-          return;
-        }
-    }
+void
+OFSwitch13Device::SocketCtrlClosed (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+
+  NS_LOG_WARN ("Controller connection closed!");
+  RemoveRemoteController (socket);
 }
 
 void
@@ -1195,8 +3699,17 @@ OFSwitch13Device::NotifyPacketCloned (struct packet *pkt, struct packet *clone)
   NS_LOG_FUNCTION (this << pkt->ns3_uid);
 
   // Assigning a new unique ID for this cloned packet.
+  Ptr<PipelinePacket> pipePkt = GetPipelinePacket (pkt->ns3_uid);
+  if (!pipePkt)
+    {
+      // This packet has no ns-3 ID (probably created by the controller and
+      // sent to the switch within an OpenFlow packet-out message).
+      NS_ASSERT_MSG (pkt->ns3_uid == 0, "Invalid packet ID.");
+      clone->ns3_uid = 0;
+      return;
+    }
   clone->ns3_uid = OFSwitch13Device::GetNewPacketId ();
-  m_pipePkt.NewCopy (clone->ns3_uid);
+  PipelinePacketNewId (clone->ns3_uid, pipePkt);
 }
 
 void
@@ -1204,10 +3717,10 @@ OFSwitch13Device::NotifyPacketDestroyed (struct packet *pkt)
 {
   NS_LOG_FUNCTION (this << pkt->ns3_uid);
 
-  // This is the packet current under pipeline. Let's delete this copy.
-  if (m_pipePkt.IsValid () && m_pipePkt.HasId (pkt->ns3_uid))
+  // This packet is under pipeline. Let's delete this copy.
+  if (GetPipelinePacket (pkt->ns3_uid))
     {
-      bool valid = m_pipePkt.DelCopy (pkt->ns3_uid);
+      bool valid = PipelinePacketDelId (pkt->ns3_uid);
       if (!valid)
         {
           NS_LOG_DEBUG ("Packet " << pkt->ns3_uid << " done at this switch.");
@@ -1224,10 +3737,6 @@ OFSwitch13Device::NotifyPacketDestroyed (struct packet *pkt)
       return;
     }
 
-  // If we got here, this packet must not be valid on the pipeline structure.
-  NS_ASSERT_MSG ((m_pipePkt.IsValid () && !m_pipePkt.HasId (pkt->ns3_uid))
-                 || !m_pipePkt.IsValid (), "Packet still valid in pipeline.");
-
   // This destroyed packet is probably an old packet that was previously saved
   // into buffer and will be deleted now, freeing up space for a new packet at
   // same buffer index (that's how the library handles the buffer). So, we are
@@ -1243,41 +3752,61 @@ OFSwitch13Device::NotifyPacketDroppedByMeter (struct packet *pkt,
   NS_LOG_FUNCTION (this << pkt->ns3_uid << entry->stats->meter_id);
 
   uint32_t meterId = entry->stats->meter_id;
-  NS_ASSERT_MSG (m_pipePkt.HasId (pkt->ns3_uid), "Invalid packet ID.");
+  Ptr<PipelinePacket> pipePkt = GetPipelinePacket (pkt->ns3_uid);
+  NS_ASSERT_MSG (pipePkt, "Invalid packet ID.");
   NS_LOG_DEBUG ("OpenFlow meter id " << meterId <<
                 " dropped packet " << pkt->ns3_uid);
 
   // Increase counter and fire drop trace source.
-  m_meterDropTrace (m_pipePkt.GetPacket (), meterId);
+  m_meterDropTrace (pipePkt->GetPacket (), meterId);
 }
 
-void
+uint64_t
 OFSwitch13Device::BufferPacketSave (uint64_t packetId, time_t timeout)
 {
   NS_LOG_FUNCTION (this << packetId);
 
-  NS_ASSERT_MSG (m_pipePkt.HasId (packetId), "Invalid packet ID.");
+  Ptr<PipelinePacket> pipePkt = GetPipelinePacket (packetId);
+  NS_ASSERT_MSG (pipePkt, "Invalid packet ID.");
 
-  // Remove from pipeline and save into buffer.
-  std::pair <uint64_t, Ptr<Packet> > entry (packetId, m_pipePkt.GetPacket ());
-  auto ret = m_bufferPkts.insert (entry);
-  if (ret.second == true)
+  // The library buffer holds at most m_bufferSize packets, and older packets
+  // are deleted from our ring before their library slots are reused. So, the
+  // next ring slot is expected to be empty. If not, expire its packet now.
+  // The ring is only allocated when the first packet is saved into buffer.
+  if (m_bufferPkts.empty ())
     {
-      NS_LOG_DEBUG ("Packet " << packetId << " saved into buffer.");
-      m_bufferSaveTrace (m_pipePkt.GetPacket ());
+      m_bufferPkts.resize (m_bufferSize);
     }
-  else
+  uint64_t bufferId = BUFFER_ID_FLAG | m_bufferTail;
+  BufferSlot &slot = m_bufferPkts [m_bufferTail % m_bufferPkts.size ()];
+  if (slot.packet)
     {
-      NS_LOG_WARN ("Packet " << packetId << " already in buffer.");
+      NS_LOG_WARN ("Buffer ring full. Expiring packet " << slot.id);
+      m_bufferExpireTrace (slot.packet);
+      m_bufferUsed--;
     }
-  m_pipePkt.DelCopy (packetId);
-  NS_ASSERT_MSG (!m_pipePkt.IsValid (), "Packet copy still in pipeline.");
+  m_bufferTail++;
 
-  // Scheduling the buffer remove for expired packet. Since packet timeout
+  // Remove from pipeline and save into buffer. Since packet timeout
   // resolution is expressed in seconds, let's double it to avoid rounding
   // conflicts.
-  Simulator::Schedule (Time::FromInteger (2 * timeout, Time::S),
-                       &OFSwitch13Device::BufferPacketDelete, this, packetId);
+  slot.id = bufferId;
+  slot.packet = pipePkt->GetPacket ();
+  slot.expire = Simulator::Now () + Time::FromInteger (2 * timeout, Time::S);
+  m_bufferUsed++;
+  NS_LOG_DEBUG ("Packet " << packetId << " saved into buffer as " <<
+                (bufferId & ~BUFFER_ID_FLAG) << ".");
+  m_bufferSaveTrace (slot.packet);
+  PipelinePacketDelId (packetId);
+
+  // Scheduling the buffer expiration when there is no event pending.
+  if (!m_bufferEvent.IsRunning ())
+    {
+      m_bufferEvent = Simulator::Schedule (
+          slot.expire - Simulator::Now (),
+          &OFSwitch13Device::BufferPacketExpire, this);
+    }
+  return bufferId;
 }
 
 void
@@ -1285,19 +3814,21 @@ OFSwitch13Device::BufferPacketRetrieve (uint64_t packetId)
 {
   NS_LOG_FUNCTION (this << packetId);
 
-  NS_ASSERT_MSG (!m_pipePkt.IsValid (), "Another packet in pipeline.");
-
   // Find packet in buffer.
-  auto it = m_bufferPkts.find (packetId);
-  NS_ASSERT_MSG (it != m_bufferPkts.end (), "Packet not found in buffer.");
+  BufferSlot &slot = m_bufferPkts [(packetId & ~BUFFER_ID_FLAG)
+                                   % m_bufferPkts.size ()];
+  NS_ASSERT_MSG ((packetId & BUFFER_ID_FLAG) && slot.id == packetId
+                 && slot.packet, "Packet not found in buffer.");
 
-  // Save packet into pipeline structure.
-  m_pipePkt.SetPacket (it->first, it->second);
-  m_bufferRetrieveTrace (m_pipePkt.GetPacket ());
+  // Save packet into a new pipeline context.
+  Ptr<PipelinePacket> pipePkt = Create<PipelinePacket> (packetId, slot.packet);
+  PipelinePacketNewId (packetId, pipePkt);
+  m_bufferRetrieveTrace (pipePkt->GetPacket ());
 
-  // Delete packet from buffer.
+  // Delete packet from buffer. The empty slot will be skipped at expiration.
   NS_LOG_DEBUG ("Packet " << packetId << " removed from buffer.");
-  m_bufferPkts.erase (it);
+  slot.packet = 0;
+  m_bufferUsed--;
 }
 
 void
@@ -1305,13 +3836,74 @@ OFSwitch13Device::BufferPacketDelete (uint64_t packetId)
 {
   NS_LOG_FUNCTION (this << packetId);
 
-  // Delete from buffer map.
-  auto it = m_bufferPkts.find (packetId);
-  if (it != m_bufferPkts.end ())
+  if (!(packetId & BUFFER_ID_FLAG) || m_bufferPkts.empty ())
+    {
+      return;
+    }
+
+  // Delete from buffer ring.
+  BufferSlot &slot = m_bufferPkts [(packetId & ~BUFFER_ID_FLAG)
+                                   % m_bufferPkts.size ()];
+  if (slot.id == packetId && slot.packet)
     {
       NS_LOG_DEBUG ("Expired packet " << packetId << " deleted from buffer.");
-      m_bufferExpireTrace (it->second);
-      m_bufferPkts.erase (it);
+      m_bufferExpireTrace (slot.packet);
+      slot.packet = 0;
+      m_bufferUsed--;
+    }
+}
+
+void
+OFSwitch13Device::BufferPacketExpire (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  while (m_bufferHead < m_bufferTail)
+    {
+      BufferSlot &slot = m_bufferPkts [m_bufferHead % m_bufferPkts.size ()];
+      if (slot.id == (BUFFER_ID_FLAG | m_bufferHead) && slot.packet)
+        {
+          if (slot.expire > Simulator::Now ())
+            {
+              m_bufferEvent = Simulator::Schedule (
+                  slot.expire - Simulator::Now (),
+                  &OFSwitch13Device::BufferPacketExpire, this);
+              return;
+            }
+          NS_LOG_DEBUG ("Expired packet " << slot.id << " deleted from buffer.");
+          m_bufferExpireTrace (slot.packet);
+          slot.packet = 0;
+          m_bufferUsed--;
+        }
+      m_bufferHead++;
+    }
+}
+
+void
+OFSwitch13Device::RemoveRemoteController (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+
+  // Loop over controllers looking for the one associated to this socket and
+  // remove it from the collection. The library remote struct is removed from
+  // the datapath list of remotes and released, so the library can't send
+  // messages to this controller anymore.
+  for (auto it = m_controllers.begin (); it != m_controllers.end (); it++)
+    {
+      Ptr<RemoteController> remoteCtrl = *it;
+      if (remoteCtrl->m_socket == socket)
+        {
+          if (remoteCtrl->m_remote)
+            {
+              m_remoteCtrls.erase (remoteCtrl->m_remote);
+              list_remove (&remoteCtrl->m_remote->node);
+              free (remoteCtrl->m_remote);
+              remoteCtrl->m_remote = 0;
+            }
+          remoteCtrl->m_socket = 0;
+          m_controllers.erase (it);
+          return;
+        }
     }
 }
 
@@ -1350,14 +3942,12 @@ OFSwitch13Device::GetRemoteController (struct remote *remote)
 {
   NS_LOG_FUNCTION (this << remote);
 
-  for (auto const &ctrl : m_controllers)
+  auto it = m_remoteCtrls.find (remote);
+  if (it != m_remoteCtrls.end ())
     {
-      if (ctrl->m_remote == remote)
-        {
-          return ctrl;
-        }
+      return it->second;
     }
-  NS_ABORT_MSG ("Error returning controller for this remote pointer.");
+  return 0;
 }
 
 uint64_t
@@ -1374,11 +3964,9 @@ OFSwitch13Device::CopyTags (Ptr<const Packet> srcPkt, Ptr<const Packet> dstPkt)
   while (pktIt.HasNext ())
     {
       PacketTagIterator::Item item = pktIt.Next ();
-      Callback<ObjectBase *> constructor = item.GetTypeId ().GetConstructor ();
-      Tag *tag = dynamic_cast <Tag *> (constructor ());
+      Tag *tag = OFSwitch13Device::GetTagPrototype (item.GetTypeId ());
       item.GetTag (*tag);
       dstPkt->AddPacketTag (*tag);
-      delete tag;
     }
 
   // Copy byte tags.
@@ -1386,34 +3974,57 @@ OFSwitch13Device::CopyTags (Ptr<const Packet> srcPkt, Ptr<const Packet> dstPkt)
   while (bytIt.HasNext ())
     {
       ByteTagIterator::Item item = bytIt.Next ();
-      Callback<ObjectBase *> constructor = item.GetTypeId ().GetConstructor ();
-      Tag *tag = dynamic_cast<Tag *> (constructor ());
+      Tag *tag = OFSwitch13Device::GetTagPrototype (item.GetTypeId ());
       item.GetTag (*tag);
       dstPkt->AddByteTag (*tag);
-      delete tag;
     }
 
   return true;
 }
 
+Tag*
+OFSwitch13Device::GetTagPrototype (TypeId tid)
+{
+  uint16_t uid = tid.GetUid ();
+  if (uid >= OFSwitch13Device::m_tagPrototypes.size ())
+    {
+      OFSwitch13Device::m_tagPrototypes.resize (uid + 1);
+    }
+
+  std::unique_ptr<Tag> &tag = OFSwitch13Device::m_tagPrototypes [uid];
+  if (!tag)
+    {
+      // First time we see this tag type. The cached instance is owned by the
+      // list, and it's released at program exit.
+      Callback<ObjectBase *> constructor = tid.GetConstructor ();
+      std::unique_ptr<ObjectBase> object (constructor ());
+      Tag *instance = dynamic_cast<Tag *> (object.get ());
+      NS_ABORT_MSG_IF (!instance, "Invalid tag type " << tid.GetName ());
+      object.release ();
+      tag.reset (instance);
+    }
+  return tag.get ();
+}
+
 void
 OFSwitch13Device::RegisterDatapath (uint64_t id, Ptr<OFSwitch13Device> dev)
 {
-  std::pair<uint64_t, Ptr<OFSwitch13Device> > entry (id, dev);
-  auto ret = OFSwitch13Device::m_globalSwitchMap.insert (entry);
-  NS_ABORT_MSG_IF (ret.second == false, "Error when registering datapath.");
+  if (id >= OFSwitch13Device::m_globalSwitchList.size ())
+    {
+      OFSwitch13Device::m_globalSwitchList.resize (id + 1);
+    }
+  NS_ABORT_MSG_IF (OFSwitch13Device::m_globalSwitchList [id],
+                   "Error when registering datapath.");
+  OFSwitch13Device::m_globalSwitchList [id] = dev;
 }
 
 void
 OFSwitch13Device::UnregisterDatapath (uint64_t id)
 {
-  auto it = OFSwitch13Device::m_globalSwitchMap.find (id);
-  if (it != OFSwitch13Device::m_globalSwitchMap.end ())
-    {
-      OFSwitch13Device::m_globalSwitchMap.erase (it);
-      return;
-    }
-  NS_ABORT_MSG ("Error when removing datapath.");
+  NS_ABORT_MSG_IF (id >= OFSwitch13Device::m_globalSwitchList.size ()
+                   || !OFSwitch13Device::m_globalSwitchList [id],
+                   "Error when removing datapath.");
+  OFSwitch13Device::m_globalSwitchList [id] = 0;
 }
 
 OFSwitch13Device::RemoteController::RemoteController ()
@@ -1424,82 +4035,47 @@ OFSwitch13Device::RemoteController::RemoteController ()
   m_address = Address ();
 }
 
-OFSwitch13Device::PipelinePacket::PipelinePacket ()
-  : m_valid (false),
-  m_packet (0)
-{
-}
-
-void
-OFSwitch13Device::PipelinePacket::SetPacket (uint64_t id, Ptr<Packet> packet)
+OFSwitch13Device::PipelinePacket::PipelinePacket (uint64_t id,
+                                                  Ptr<Packet> packet)
+  : m_packet (packet),
+  m_cacheRecord (false),
+  m_cacheMaskOk (false),
+  m_keyOk (false),
+  m_keyStale (false)
 {
   NS_ASSERT_MSG (id && packet, "Invalid packet metadata values.");
-  m_valid = true;
-  m_packet = packet;
-  m_ids.push_back (id);
 }
 
 Ptr<Packet>
 OFSwitch13Device::PipelinePacket::GetPacket (void) const
 {
-  NS_ASSERT_MSG (IsValid (), "Invalid packet metadata.");
   return m_packet;
 }
 
-void
-OFSwitch13Device::PipelinePacket::Invalidate (void)
-{
-  m_valid = false;
-  m_packet = 0;
-  m_ids.clear ();
-}
-
 bool
 OFSwitch13Device::PipelinePacket::IsValid (void) const
 {
-  return m_valid;
+  return !m_ids.empty ();
 }
 
 void
 OFSwitch13Device::PipelinePacket::NewCopy (uint64_t id)
 {
-  NS_ASSERT_MSG (m_valid, "Invalid packet metadata.");
-  m_ids.push_back (id);
+  auto ret = m_ids.insert (id);
+  NS_ABORT_MSG_IF (ret.second == false, "Duplicated packet ID.");
 }
 
 bool
 OFSwitch13Device::PipelinePacket::DelCopy (uint64_t id)
 {
-  NS_ASSERT_MSG (m_valid, "Invalid packet metadata.");
-
-  for (auto it = m_ids.begin (); it != m_ids.end (); it++)
-    {
-      if (*it == id)
-        {
-          m_ids.erase (it);
-          break;
-        }
-    }
-  if (m_ids.size () == 0)
-    {
-      Invalidate ();
-    }
-  return m_valid;
+  m_ids.erase (id);
+  return IsValid ();
 }
 
 bool
-OFSwitch13Device::PipelinePacket::HasId (uint64_t id)
+OFSwitch13Device::PipelinePacket::HasId (uint64_t id) const
 {
-  NS_ASSERT_MSG (m_valid, "Invalid packet metadata.");
-
-  for (auto it = m_ids.begin (); it != m_ids.end (); it++)
-    {
-      if (*it == id)
-        {
-          return true;
-        }
-    }
-  return false;
+  return m_ids.count (id);
 }
 
 } // namespace ns3
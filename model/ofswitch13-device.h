@@ -27,8 +27,17 @@
 #include <ns3/string.h>
 #include <ns3/tcp-header.h>
 #include <ns3/traced-value.h>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include "ofswitch13-interface.h"
+#include "ofswitch13-buffer-pool.h"
+#include "ofswitch13-classifier.h"
+#include "ofswitch13-flow-cache.h"
+#include "ofswitch13-pipeline-delay-model.h"
 #include "ofswitch13-socket-handler.h"
+#include "ofswitch13-timer-wheel.h"
 
 namespace ns3 {
 
@@ -74,35 +83,34 @@ private:
 
   /**
    * \ingroup ofswitch13
-   * Structure to save packet metadata while it is under OpenFlow pipeline.
-   * This structure keeps track of packets under OpenFlow pipeline, including
-   * the ID for each packet copy (notified by the clone callback). Note that
-   * only one packet can be in pipeline at a time, but the packet can have
-   * multiple internal copies (each one will receive an unique packet ID), and
-   * can also be saved into buffer for latter usage.
-   */
-  struct PipelinePacket
+   * Inner class to save packet metadata while it is under OpenFlow pipeline.
+   * This class keeps track of a packet under OpenFlow pipeline, including the
+   * ID for each packet copy (notified by the clone callback). Many packets can
+   * be in pipeline at the same time, each one with its own PipelinePacket
+   * context. The packet can have multiple internal copies (each one will
+   * receive an unique packet ID), and can also be saved into buffer for
+   * latter usage. This context also holds the pipeline result recorded for
+   * the flow cache, and the flow key extracted from the packet headers when
+   * it entered the pipeline (used by the flow table classifiers).
+   */
+  class PipelinePacket : public SimpleRefCount<PipelinePacket>
   {
-public:
-    /** Default (empty) constructor. */
-    PipelinePacket ();
+    friend class OFSwitch13Device;
 
+public:
     /**
-     * Save packet metadata.
+     * Complete constructor.
      * \param id Packet unique ID.
      * \param packet The packet pointer.
      */
-    void SetPacket (uint64_t id, Ptr<Packet> packet);
+    PipelinePacket (uint64_t id, Ptr<Packet> packet);
 
     /** \return The packet pointer. */
     Ptr<Packet> GetPacket (void) const;
 
-    /** Invalidate packet metatada.*/
-    void Invalidate (void);
-
     /**
      * Check for valid packet metadata.
-     * \return true when valid packet metadata.
+     * \return true when valid packet metadata (at least one copy in pipeline).
      */
     bool IsValid (void) const;
 
@@ -120,19 +128,63 @@ public:
     bool DelCopy (uint64_t id);
 
     /**
-     * Check for packet id in the internal list of IDs for this packet.
+     * Check for packet id in the internal set of IDs for this packet.
      * \param id The ns-3 packet id.
      * \return true when the id is associated with this packet.
      */
-    bool HasId (uint64_t id);
+    bool HasId (uint64_t id) const;
 
 private:
-    bool                  m_valid;  //!< Valid flag.
-    Ptr<Packet>           m_packet; //!< Packet pointer.
-    std::list<uint64_t>   m_ids;    //!< Internal list of IDs for this packet.
-  }; // Struct PipelinePacket
+    Ptr<Packet>                   m_packet;       //!< Packet pointer.
+    std::unordered_set<uint64_t>  m_ids;          //!< IDs for this packet.
+    bool                          m_cacheRecord;  //!< Recording for cache.
+    OFSwitch13FlowCache::Entry    m_cacheEntry;   //!< Result recorded.
+    bool                          m_cacheMaskOk;  //!< Recording mask.
+    OFSwitch13FlowKey             m_cacheMask;    //!< Mask recorded.
+    bool                          m_keyOk;        //!< Flow key valid.
+    bool                          m_keyStale;     //!< Packet modified.
+    OFSwitch13FlowKey             m_key;          //!< Packet flow key.
+  }; // Class PipelinePacket
+
+  /**
+   * \ingroup ofswitch13
+   * Structure to save a packet waiting in the ingress batch queue or in the
+   * CPU ingress queue.
+   */
+  struct IngressPacket
+  {
+    Ptr<Packet>   packet;     //!< The packet.
+    uint32_t      portNo;     //!< The switch input port number.
+    uint64_t      tunnelId;   //!< The logical port metadata.
+    Time          dueTime;    //!< The time to send the packet to pipeline
+                              //!< (the arrival time for the CPU queue).
+  }; // Struct IngressPacket
 
 public:
+  /**
+   * Flow table eviction policy, used to select the flow entry removed to make
+   * room for a new one when a flow mod adds an entry to a full flow table.
+   */
+  enum EvictionPolicy
+  {
+    EVICT_NONE = 0,         //!< No eviction (flow mods fail on full tables).
+    EVICT_LRU = 1,          //!< Evict the least recently hit entry.
+    EVICT_PACKETS = 2,      //!< Evict the entry with the fewest packets.
+    EVICT_PRIORITY = 3      //!< Evict the entry with the lowest priority.
+  };
+
+  /**
+   * Packet classifier algorithm used for the lookups on a flow table.
+   */
+  enum ClassifierType
+  {
+    CLASSIFIER_LINEAR = 0,  //!< Linear search by the ofsoftswitch13 library.
+    CLASSIFIER_TSS = 1,     //!< Tuple space search.
+    CLASSIFIER_EXACT = 2,   //!< Exact-match hash table.
+    CLASSIFIER_LPM = 3,     //!< Longest prefix match tries.
+    CLASSIFIER_TREE = 4     //!< Decision tree.
+  };
+
   OFSwitch13Device ();            //!< Default constructor
   virtual ~OFSwitch13Device ();   //!< Dummy destructor, see DoDispose
 
@@ -175,13 +227,27 @@ public:
   uint32_t GetBufferEntries       (void) const;
   uint32_t GetBufferSize          (void) const;
   double   GetBufferUsage         (void) const;
+  uint64_t GetBufPoolHits         (void) const;
+  uint32_t GetBufPoolHighWater    (void) const;
+  uint64_t GetBufPoolMisses       (void) const;
   DataRate GetCpuCapacity         (void) const;
+  uint32_t GetCpuCores            (void) const;
   DataRate GetCpuLoad             (void) const;
   double   GetCpuUsage            (void) const;
   Time     GetDatapathTimeout     (void) const;
   uint32_t GetDftFlowTableSize    (void) const;
+  uint32_t GetDftFlowTableSlices  (void) const;
+  uint32_t GetFlowCacheEntries    (void) const;
+  uint32_t GetFlowCacheMegaflows  (void) const;
+  uint32_t GetFlowCacheMasks      (void) const;
+  uint32_t GetFlowCacheSize       (void) const;
   uint32_t GetFlowTableEntries    (uint8_t tableId) const;
   uint32_t GetFlowTableSize       (uint8_t tableId) const;
+  uint32_t GetFlowTableSlices     (uint8_t tableId) const;
+  uint32_t GetFlowTableTierSize   (uint8_t tableId) const;
+  uint32_t GetFlowTableTreeDepth  (uint8_t tableId) const;
+  uint32_t GetFlowTableTreeNodes  (uint8_t tableId) const;
+  uint32_t GetFlowTableUsedSlices (uint8_t tableId) const;
   double   GetFlowTableUsage      (uint8_t tableId) const;
   uint32_t GetGroupTableEntries   (void) const;
   uint32_t GetGroupTableSize      (void) const;
@@ -194,6 +260,12 @@ public:
   uint32_t GetNSwitchPorts        (void) const;
   Time     GetPipelineDelay       (void) const;
   uint32_t GetSumFlowEntries      (void) const;
+  uint64_t GetTierFastHits        (void) const;
+  double   GetTierFastHitRatio    (void) const;
+  uint64_t GetTierLookups         (void) const;
+  uint64_t GetTierSlowHits        (void) const;
+  double   GetTierSlowHitRatio    (void) const;
+  double   GetTreeSpaceFactor     (void) const;
   //\}
 
   /**
@@ -202,6 +274,86 @@ public:
    */
   struct datapath* GetDatapathStruct ();
 
+  /**
+   * Set the TCAM slice budget for a pipeline flow table. When positive, each
+   * flow entry in this table consumes TCAM slices according to the width of
+   * the OXM fields it matches, and flow mods adding entries that don't fit
+   * into the remaining slices fail with a table-full error.
+   * \param tableId The pipeline flow table ID.
+   * \param value The number of TCAM slices (0 disables the slice budget).
+   */
+  void SetFlowTableSlices (uint8_t tableId, uint32_t value);
+
+  /**
+   * Set the two-tier mode configuration for a pipeline flow table, overriding
+   * the TierFastSize, TierFastDelay, and TierSlowDelay attributes for this
+   * table. The lookup delay of a two-tier table is given by its tiers, which
+   * replace the table delay model. So, two-tier tables and tables with delay
+   * models can be combined in the same pipeline.
+   * \param tableId The pipeline flow table ID.
+   * \param fastSize The fast tier capacity (0 disables the two-tier mode).
+   * \param fastDelay The fast tier lookup delay.
+   * \param slowDelay The slow tier lookup delay (added on fast tier misses).
+   */
+  void SetFlowTableTiers (uint8_t tableId, uint32_t fastSize, Time fastDelay,
+                          Time slowDelay);
+
+  /**
+   * Set the lookup delay model for a pipeline flow table. When any delay model
+   * is configured (per table or by the PipelineDelayModel attribute), the
+   * packet is processed by the pipeline without the average pipeline delay,
+   * and its outputs are delayed by the sum of the lookup delays of the flow
+   * tables visited by this packet.
+   * \param tableId The pipeline flow table ID.
+   * \param model The delay model (0 to use the default device model).
+   */
+  void SetFlowTableDelayModel (uint8_t tableId,
+                               Ptr<OFSwitch13PipelineDelayModel> model);
+
+  /**
+   * Get the lookup delay model for a pipeline flow table.
+   * \param tableId The pipeline flow table ID.
+   * \return The delay model (0 when no model is configured).
+   */
+  Ptr<OFSwitch13PipelineDelayModel> GetFlowTableDelayModel (
+    uint8_t tableId) const;
+
+  /**
+   * Set the packet classifier algorithm for a pipeline flow table. With any
+   * algorithm other than the linear search, the table entries are indexed by
+   * a classifier (see OFSwitch13Classifier) that replaces the linear search
+   * performed by the ofsoftswitch13 library on flow table lookups. Flow mods
+   * adding entries with masked or unsupported fields (or with a field set
+   * other than the configured one) to exact-match tables fail with a bad
+   * match error.
+   * \param tableId The pipeline flow table ID.
+   * \param type The classifier algorithm.
+   */
+  void SetFlowTableClassifier (uint8_t tableId, ClassifierType type);
+
+  /**
+   * Set the field set of the entries indexed by the exact-match classifier
+   * of a pipeline flow table (see OFSwitch13ExactClassifier::SetFields ()).
+   * Without a field set, all entries in exact-match tables are searched
+   * linearly and flow mods are not checked.
+   * \param tableId The pipeline flow table ID.
+   * \param fields The OXM headers of the fields (e.g., OXM_OF_ETH_DST).
+   */
+  void SetFlowTableExactFields (uint8_t tableId, std::vector<uint32_t> fields);
+
+  /**
+   * Get the packet classifier algorithm for a pipeline flow table.
+   * \param tableId The pipeline flow table ID.
+   * \return The classifier algorithm.
+   */
+  ClassifierType GetFlowTableClassifier (uint8_t tableId) const;
+
+  /**
+   * Get the default packet classifier algorithm for flow tables.
+   * \return The classifier algorithm.
+   */
+  ClassifierType GetDftFlowTableClassifier (void) const;
+
   /**
    * Add a 'port' to the switch device. This method adds a new switch port to a
    * OFSwitch13Device, so that the new switch port NetDevice becomes part of
@@ -224,7 +376,9 @@ public:
 
   /**
    * Called when a packet is received on one of the switch's ports. This method
-   * will schedule the packet for OpenFlow pipeline.
+   * will schedule the packet for OpenFlow pipeline. When ingress batching is
+   * enabled, the packet is saved into the ingress batch queue and many packets
+   * are sent to the pipeline by a single event.
    * \param packet The packet.
    * \param portNo The switch input port number.
    * \param tunnelId The metadata associated with a logical port.
@@ -340,6 +494,18 @@ public:
    */
   static Ptr<OFSwitch13Device> GetDevice (uint64_t id);
 
+  /**
+   * Copy all tags (packet and byte) from srcPkt packet to dstPkt packet. Tags
+   * are deserialized into cached per-TypeId tag instances (see
+   * GetTagPrototype ()), so no tag object is created for each copied tag.
+   * \attention In the case of byte tags, the tags in dstPkt will cover the
+   * entire packet, regardless of the byte range in srcPkt.
+   * \param srcPkt The source packet.
+   * \param dstPkt The destination packet.
+   * \return true if everything's ok, false otherwise.
+   */
+  static bool CopyTags (Ptr<const Packet> srcPkt, Ptr<const Packet> dstPkt);
+
   /**
    * TracedCallback signature for packets dropped by meter bands.
    * \param packet The dropped packet.
@@ -354,6 +520,43 @@ public:
    */
   typedef void (*DeviceTracedCallback)(Ptr<const OFSwitch13Device> dev);
 
+  /**
+   * TracedCallback signature for ingress batches.
+   * \param size The number of packets sent to pipeline by a batch event.
+   */
+  typedef void (*BatchTracedCallback)(uint32_t size);
+
+  /**
+   * TracedCallback signature for flow table vacancy events.
+   * \param tableId The flow table ID.
+   * \param vacancy The current table vacancy (percent of free entries).
+   * \param down True when the vacancy went below the VacancyDown threshold,
+   *             false when it went above the VacancyUp threshold.
+   */
+  typedef void (*VacancyTracedCallback)(uint8_t tableId, uint8_t vacancy,
+                                        bool down);
+
+  /**
+   * TracedCallback signature for CPU queueing delay.
+   * \param packet The packet leaving the CPU ingress queue.
+   * \param delay The time the packet has waited in the queue.
+   */
+  typedef void (*CpuQueueDelayTracedCallback)(
+    Ptr<const Packet> packet, Time delay);
+
+  /**
+   * TracedCallback signature for CPU core utilization.
+   * \param coreId The CPU core index.
+   * \param load The fraction of time the core was busy since last timeout.
+   */
+  typedef void (*CpuCoreLoadTracedCallback)(uint32_t coreId, double load);
+
+  /**
+   * TracedCallback signature for flow mod installation.
+   * \param latency The time from the flow mod arrival until it took effect.
+   */
+  typedef void (*FlowModTracedCallback)(Time latency);
+
 protected:
   // Inherited from Object
   virtual void DoDispose (void);
@@ -377,19 +580,128 @@ private:
   //\{
   void SetFlowTableSize     (uint8_t tableId, uint32_t value);
   void SetDftFlowTableSize  (uint32_t value);
+  void SetDftFlowTableSlices (uint32_t value);
+  void SetDftFlowTableClassifier (ClassifierType value);
+  void SetTreeSpaceFactor   (double value);
   void SetGroupTableSize    (uint32_t value);
   void SetMeterTableSize    (uint32_t value);
+  void SetFlowCacheSize     (uint32_t value);
   //\}
 
   /**
-   * Check if any flow in any table is timed out and update port status. This
-   * method reschedules itself at every m_timout interval, to constantly check
-   * the pipeline for timed out flow entries and update port status.
-   * \see ofsoftswitch13 function pipeline_timeout () at udatapath/pipeline.c
+   * Set the number of CPU cores, resizing the list of cores. Busy cores
+   * can't be removed, and new cores start serving the packets waiting in the
+   * CPU ingress queue.
+   * \param value The number of CPU cores.
+   */
+  void SetCpuCores (uint32_t value);
+
+  /**
+   * Remove timed out flow entries, and update traced values.
+   * This method is periodically invoked by DatapathTimeoutGroup () at every
+   * m_timeout interval while the device has pending housekeeping work (see
+   * DatapathTimeoutPending ()). Meter buckets are not refilled here, as they are
+   * lazily refilled when packets hit the meter (see PipelineExecuteEntry ()).
+   * Port status is not polled here, as it is updated by PortLinkChanged ().
    * \param dp The datapath.
    */
   void DatapathTimeout (struct datapath *dp);
 
+  /**
+   * Check for pending housekeeping work: flow entries with timeouts, TCAM
+   * slices or timing wheel to synchronize, and CPU load to report. Changes
+   * in flow, group, and meter tables come from the controller or from
+   * packets, which wake the device up (see TimeoutGroupWake ()).
+   * \return True when the device must be visited on the next timeout.
+   */
+  bool DatapathTimeoutPending (void) const;
+
+  /**
+   * Shared housekeeping event for all devices with the same timeout interval.
+   * Instead of each device scheduling its own timeout event, a single event
+   * per distinct interval invokes DatapathTimeout () on the devices of the
+   * group with pending work and reschedules itself. Devices without pending
+   * work are put to sleep until woken up by a packet or a controller message.
+   * Devices whose m_timeout attribute has been changed are moved to the
+   * corresponding group.
+   * \param interval The timeout interval for this group.
+   */
+  static void DatapathTimeoutGroup (Time interval);
+
+  /**
+   * Register this device into the housekeeping group for its current timeout
+   * interval, scheduling the group event when necessary.
+   */
+  void TimeoutGroupRegister (void);
+
+  /**
+   * Remove this device from its housekeeping group, canceling the group event
+   * when the group becomes empty.
+   */
+  void TimeoutGroupUnregister (void);
+
+  /**
+   * Add this device to the list of devices with pending work in its
+   * housekeeping group. The skipped timeouts had nothing to do, so the device
+   * resumes as if it had been visited on the last group timeout.
+   */
+  void TimeoutGroupWake (void);
+
+  /**
+   * Remove this device from the list of devices with pending work in its
+   * housekeeping group.
+   */
+  void TimeoutGroupSleep (void);
+
+  /**
+   * Remove timed out flow entries. This replaces the ofsoftswitch13
+   * pipeline_timeout () function, which scans all entries with timeouts on
+   * every call. Here, entries are kept in a timing wheel, and only the ones
+   * due are checked, using the library functions (so FLOW_REMOVED messages
+   * are generated just as before). Idle timeouts are not re-armed on each
+   * packet hit: when an entry is due but has been used meanwhile, it is
+   * scheduled again for its updated idle deadline.
+   * \see ofsoftswitch13 function pipeline_timeout () at udatapath/pipeline.c
+   */
+  void FlowTimersExpire (void);
+
+  /**
+   * Schedule this flow entry into the timing wheel for its next deadline
+   * (earliest of hard and idle timeouts), if any.
+   * \param entry The flow entry.
+   */
+  void FlowTimerSchedule (struct flow_entry *entry);
+
+  /**
+   * Rebuild the timing wheel from the entries in all flow tables. This is
+   * necessary after control messages that may have freed unknown flow
+   * entries (non-strict flow deletions, or group and meter deletions).
+   */
+  void FlowTimersSync (void);
+
+  /**
+   * Update the timing wheel after a control message was handled. A new flow
+   * entry added by a flow mod is scheduled directly, and the entry replaced
+   * by it or removed by a strict flow deletion is cancelled. Any other change
+   * in the number of flow entries requires the timing wheel to be rebuilt.
+   * \param table The flow table for flow mod add commands, or 0 otherwise.
+   * \param idleTimeout The idle timeout for flow mod add commands.
+   * \param hardTimeout The hard timeout for flow mod add commands.
+   * \param flowEntries The number of flow entries before handling the msg.
+   * \param oldEntry The entry with the same match and priority of the flow
+   *        mod add or strict delete command, if any.
+   */
+  void FlowTimersUpdate (struct flow_table *table, uint16_t idleTimeout,
+                         uint16_t hardTimeout, uint32_t flowEntries,
+                         struct flow_entry *oldEntry);
+
+  /**
+   * Link change callback connected to the underlying NetDevice of all switch
+   * ports. Update the state of switch ports (notifying the controller when it
+   * changes), replacing the periodic port state polling.
+   */
+  void PortLinkChanged (void);
+
   /**
    * Create an OpenFlow packet in message and send the packet to all
    * controllers with open connections.
@@ -417,7 +729,55 @@ private:
                          uint32_t queueNo = 0);
 
   /**
-   * Send the packet to the OpenFlow ofsoftswitch13 pipeline.
+   * Send a batch of packets from the ingress batch queue to the pipeline.
+   * Packets are sent in due time order, up to the maximum batch size, as long
+   * as they are due within the batch window from now. If there are packets
+   * left in the queue, this method reschedules itself to the time the next
+   * packet is due.
+   */
+  void SendBatchToPipeline (void);
+
+  /**
+   * Schedule the packet to the pipeline after the pipeline delay, either
+   * directly or through the ingress batch queue.
+   * \param packet The packet.
+   * \param portNo The switch input port number.
+   * \param tunnelId The metadata associated with a logical port.
+   */
+  void ScheduleToPipeline (Ptr<Packet> packet, uint32_t portNo,
+                           uint64_t tunnelId);
+
+  /**
+   * Add the lookup delay of this flow table to the delay of the packet under
+   * pipeline processing, according to the two-tier table mode (when enabled)
+   * or to the table delay model.
+   * \param table The flow table visited by the packet.
+   * \param entry The matched entry (0 for table miss).
+   */
+  void PipelineAddTableDelay (struct flow_table *table,
+                              struct flow_entry *entry);
+
+  /**
+   * Check if the flow entry is in the fast tier of the two-tier flow table. A
+   * new entry is placed in the fast tier when there is room for it.
+   * \param table The flow table.
+   * \param entry The flow entry.
+   * \return True if the entry is in the fast tier.
+   */
+  bool TierIsFast (struct flow_table *table, struct flow_entry *entry);
+
+  /**
+   * Promote and demote flow entries between the tiers of two-tier flow
+   * tables, based on the number of hits since the last rebalance. Entries
+   * with at least TierPromoteHits hits are promoted to the fast tier, hottest
+   * first, demoting the coldest fast tier entries when it is full.
+   */
+  void TierRebalance (void);
+
+  /**
+   * Send the packet to the OpenFlow ofsoftswitch13 pipeline. When the flow
+   * cache is enabled, the packet is first looked up in the cache, and the
+   * pipeline is only executed on cache misses.
    * \param packet The packet.
    * \param portNo The switch input port number.
    * \param tunnelId The metadata associated with a logical port.
@@ -425,6 +785,139 @@ private:
   void SendToPipeline (Ptr<Packet> packet, uint32_t portNo,
                        uint64_t tunnelId = 0);
 
+  /**
+   * Process the internal packet through the OpenFlow pipeline. This code is
+   * nearly the same on ofsoftswitch13, but it also records the flow tables
+   * and flow entries visited by the packet (and the match fields of all flow
+   * entries examined on them), so the pipeline result can be saved into the
+   * flow cache.
+   * \see ofsoftswitch13 function pipeline_process_packet () at
+   *      udatapath/pipeline.c
+   * \param pl The pipeline structure.
+   * \param pkt The internal packet (the pipeline takes its ownership).
+   */
+  void PipelineProcessPacket (struct pipeline *pl, struct packet *pkt);
+
+  /**
+   * Execute the instructions of a flow entry matched by the packet.
+   * \see ofsoftswitch13 function execute_entry () at udatapath/pipeline.c
+   * \param pl The pipeline structure.
+   * \param entry The matched flow entry.
+   * \param nextTable Output parameter for the next table to visit.
+   * \param pkt The internal packet (it may be destroyed by a meter band).
+   */
+  void PipelineExecuteEntry (struct pipeline *pl, struct flow_entry *entry,
+                             struct flow_table **nextTable,
+                             struct packet **pkt);
+
+  /**
+   * Get the pipeline context for the packet with this ID.
+   * \param id The ns-3 packet id.
+   * \return The pipeline context, or 0 if the packet is not in pipeline.
+   */
+  Ptr<PipelinePacket> GetPipelinePacket (uint64_t id) const;
+
+  /**
+   * Register a new ID for a packet in pipeline.
+   * \param id The ns-3 packet id.
+   * \param pipePkt The pipeline context.
+   */
+  void PipelinePacketNewId (uint64_t id, Ptr<PipelinePacket> pipePkt);
+
+  /**
+   * Remove the ID of a packet copy that is leaving the pipeline.
+   * \param id The ns-3 packet id.
+   * \return false when no more copies of this packet remain in pipeline.
+   */
+  bool PipelinePacketDelId (uint64_t id);
+
+  /**
+   * Get the flow key for the packet in pipeline, parsing the packet headers
+   * again when they were modified after the last parsing.
+   * \param pipePkt The pipeline context (may be 0).
+   * \param pkt The internal packet.
+   * \return The packet flow key, or 0 when the key is not available.
+   */
+  const OFSwitch13FlowKey* PipelineGetFlowKey (Ptr<PipelinePacket> pipePkt,
+                                               struct packet *pkt);
+
+  /**
+   * Notify that the packet headers may be modified by the pipeline, so the
+   * flow key must be parsed again before the next table lookup.
+   * \param pkt The internal packet.
+   * \param reparse False when the key can't be parsed again from the packet
+   *        headers (i.e., the key must not be used anymore).
+   */
+  void PipelineFlowKeyStale (struct packet *pkt, bool reparse);
+
+  /**
+   * Forward the packet using the pipeline result memoized by the flow cache.
+   * Table and flow entry counters are updated just like the pipeline would.
+   * \param entry The flow cache entry.
+   * \param packet The packet.
+   * \param tunnelId The metadata associated with a logical port.
+   */
+  void FlowCacheApply (const OFSwitch13FlowCache::Entry *entry,
+                       Ptr<Packet> packet, uint64_t tunnelId);
+
+  /**
+   * Add the match fields of all flow entries examined by the table lookup to
+   * the megaflow mask of the pipeline result under recording. These are the
+   * entries with higher precedence than the matched one (or all entries, in
+   * case of table miss).
+   * \param pipePkt The pipeline context.
+   * \param table The flow table.
+   * \param entry The matched flow entry (0 for table miss).
+   */
+  void FlowCacheAddMask (Ptr<PipelinePacket> pipePkt,
+                         struct flow_table *table, struct flow_entry *entry);
+
+  /**
+   * Stop recording the pipeline result for the flow cache, as the packet
+   * processing depends on something else than its header fields and flow
+   * table entries (i.e., it can't be memoized).
+   * \param pkt The internal packet.
+   */
+  void FlowCacheUncacheable (struct packet *pkt);
+
+  /**
+   * Remove all entries from the flow cache. This must be called any time the
+   * datapath state changes in a way that may invalidate memoized results,
+   * other than flow table changes.
+   */
+  void FlowCacheFlush (void);
+
+  /**
+   * Invalidate the flow cache entries that visited this flow table. This must
+   * be called any time the flow table entries change.
+   * \param tableId The flow table ID (OFPTT_ALL for all tables).
+   */
+  void FlowCacheInvalidate (uint8_t tableId);
+
+  /**
+   * Refill the CPU bucket with tokens based on the time elapsed since the last
+   * refill (bucket capacity is set to the number of tokens for an entire
+   * second). This is called on every packet arrival, so the CPU capacity
+   * model doesn't depend on the datapath timeout interval.
+   */
+  void CpuTokensRefill (void);
+
+  /**
+   * Start processing the packet on the CPU core. The core is kept busy for
+   * the time required to process the packet at the per-core service rate.
+   * \param coreId The CPU core index.
+   * \param ingress The ingress packet.
+   */
+  void CpuCoreStart (uint32_t coreId, IngressPacket ingress);
+
+  /**
+   * Finish processing the packet on the CPU core, sending it towards the
+   * pipeline, and start processing the next packet in the CPU ingress queue.
+   * \param coreId The CPU core index.
+   * \param ingress The ingress packet.
+   */
+  void CpuCoreDone (uint32_t coreId, IngressPacket ingress);
+
   /**
    * Send a packet to the controller node.
    * \see SendOpenflowBufferToRemote ().
@@ -439,13 +932,185 @@ private:
                         Ptr<OFSwitch13Device::RemoteController> remoteCtrl);
 
   /**
-   * Receive an OpenFlow packet from controller.
-   * \see remote_rconn_run () at udatapath/datapath.c.
+   * Receive an OpenFlow packet from controller. When the rule update cost
+   * model is enabled, flow mods are saved into the control message queue, as
+   * are barrier requests behind them. Other messages are immediately
+   * processed.
    * \param packet The packet with the OpenFlow message.
    * \param from The packet sender address.
    */
   void ReceiveFromController (Ptr<Packet> packet, Address from);
 
+  /**
+   * Process an OpenFlow packet from controller.
+   * \see remote_rconn_run () at udatapath/datapath.c.
+   * \param packet The packet with the OpenFlow message.
+   * \param from The packet sender address.
+   */
+  void ProcessFromController (Ptr<Packet> packet, Address from);
+
+  /**
+   * Start the rule update for the message at the head of the control message
+   * queue. Only flow mods and the barriers behind them are queued. They are
+   * processed one at a time in arrival order, so a barrier reply is only sent
+   * after all previous flow mods took effect.
+   */
+  void CtrlQueueStart (void);
+
+  /**
+   * Finish the rule update for the message at the head of the control message
+   * queue, charging its CPU cost, processing it and starting the next one.
+   */
+  void CtrlQueueDone (void);
+
+  /**
+   * Get the time to update the flow table for this OpenFlow message. Flow
+   * mods take a fixed time, plus the time to shift each lower priority entry
+   * in the target table when a new entry is added (TCAM entries are kept in
+   * priority order). Other messages take no time.
+   * \param packet The packet with the OpenFlow message.
+   * \return The rule update time.
+   */
+  Time CtrlRuleUpdateTime (Ptr<const Packet> packet) const;
+
+  /**
+   * Remove a flow entry from the full flow table to make room for a new one,
+   * according to the eviction policy. The table-miss entry is never evicted,
+   * and ties are broken by evicting the oldest entry. The victim is taken
+   * from the table eviction index, which is rebuilt here when out of sync.
+   * \param table The flow table.
+   * \return True if an entry was evicted.
+   */
+  bool FlowTableEvict (struct flow_table *table);
+
+  /**
+   * Get the eviction key of a flow entry for the eviction policy. Entries
+   * with lower keys are evicted first.
+   * \param entry The flow entry.
+   * \return The eviction key.
+   */
+  uint64_t FlowEvictKey (struct flow_entry *entry) const;
+
+  /**
+   * Compare flow entries in the eviction index.
+   * \param a The first flow entry.
+   * \param b The second flow entry.
+   * \return True if the first entry must be evicted after the second one.
+   */
+  static bool FlowEvictAfter (const EvictItem &a, const EvictItem &b);
+
+  /**
+   * Insert a new flow entry into the eviction index of its flow table. The
+   * table-miss entry is not indexed. When the entry is unknown, the index is
+   * rebuilt on the next eviction.
+   * \param table The flow table.
+   * \param entry The flow entry (may be 0).
+   */
+  void FlowEvictIndexAdd (struct flow_table *table, struct flow_entry *entry);
+
+  /**
+   * Drop a flow entry removed from the flow table from its eviction index.
+   * This may be called after the entry is freed by the library, as only the
+   * entry pointer is used.
+   * \param tableId The flow table ID.
+   * \param entry The flow entry.
+   */
+  void FlowEvictIndexRemove (uint8_t tableId, struct flow_entry *entry);
+
+  /**
+   * Rebuild the eviction index of a flow table from the table entries.
+   * \param table The flow table.
+   */
+  void FlowEvictIndexSync (struct flow_table *table);
+
+  /** Rebuild the eviction indexes on the next eviction. */
+  void FlowEvictIndexInvalidate (void);
+
+  /**
+   * Get the number of TCAM slices consumed by a flow entry with this match.
+   * Each OXM field consumes its value width (masks are stored in the TCAM
+   * mask bits), and the entry takes as many slices as needed for the total
+   * width, at least one.
+   * \param match The flow entry match.
+   * \return The number of TCAM slices.
+   */
+  uint32_t FlowEntrySlices (struct ofl_match_header *match) const;
+
+  /**
+   * Count the TCAM slices used by the entries currently in a flow table.
+   * \param tableId The flow table ID.
+   * \return The number of TCAM slices.
+   */
+  uint32_t FlowTableSlicesCount (uint8_t tableId) const;
+
+  /**
+   * Recompute the TCAM slices used by each flow table, if necessary.
+   */
+  void FlowTableSlicesSync (void);
+
+  /**
+   * Look for the highest priority flow entry matching the packet in the flow
+   * table, using the classifier configured for this table (rebuilding it when
+   * necessary) or the library linear search. Table and entry counters are
+   * updated just like flow_table_lookup () does.
+   * \param table The flow table.
+   * \param pkt The packet.
+   * \param key The packet flow key (may be 0).
+   * \return The matching entry, or 0 on table miss.
+   * \see ofsoftswitch13 flow_table_lookup () at udatapath/flow_table.c
+   */
+  struct flow_entry* FlowTableLookup (struct flow_table *table,
+                                      struct packet *pkt,
+                                      const OFSwitch13FlowKey *key);
+
+  /**
+   * Look for the flow entry with exactly this match and priority in the flow
+   * table, using the classifier configured for this table or a linear search
+   * with the library strict match function.
+   * \param table The flow table.
+   * \param match The match structure.
+   * \param priority The entry priority.
+   * \return The flow entry, or 0 if not found.
+   */
+  struct flow_entry* FlowTableFind (struct flow_table *table,
+                                    struct ofl_match_header *match,
+                                    uint16_t priority);
+
+  /**
+   * Get the classifier for a pipeline flow table, building it if necessary.
+   * \param tableId The pipeline flow table ID.
+   * \return The classifier, or 0 for the linear search.
+   */
+  Ptr<OFSwitch13Classifier> FlowClassifierGet (uint8_t tableId);
+
+  /**
+   * Insert the new flow entry added by a flow mod into the classifier of the
+   * flow table. The new entry is identified by the flow mod priority and
+   * match, and the classifier is invalidated when it can't be found.
+   * \param table The flow table.
+   * \param priority The flow mod priority.
+   * \param value The flow key with the flow mod match values.
+   * \param mask The flow key mask with the flow mod match fields.
+   */
+  void FlowClassifierAdd (struct flow_table *table, uint16_t priority,
+                          const OFSwitch13FlowKey &value,
+                          const OFSwitch13FlowKey &mask);
+
+  /**
+   * Invalidate the classifiers of all flow tables, so they are rebuilt on the
+   * next lookup. This must be called on any flow table change other than the
+   * insertion of new entries and the removal of entries that were previously
+   * removed from the classifier.
+   */
+  void FlowClassifiersInvalidate (void);
+
+  /**
+   * Check the vacancy of all flow tables, firing the vacancy trace source
+   * when any table crosses the vacancy thresholds. As in OpenFlow 1.4, a down
+   * event is only fired again after an up event, and vice versa.
+   */
+  void FlowTableVacancyCheck (void);
+
   /**
    * Create an OpenFlow error message and send it back to the sender
    * controller. This function is used only when an error occurred while
@@ -470,6 +1135,13 @@ private:
    */
   void SocketCtrlFailed (Ptr<Socket> socket);
 
+  /**
+   * Socket callback fired when a TCP connection to controller is closed,
+   * either normally or due to an error.
+   * \param socket The TCP socket.
+   */
+  void SocketCtrlClosed (Ptr<Socket> socket);
+
   /**
    * Notify this device of a new meter entry created at meter table. This is
    * used to update the initial number of tokens for this meter. Doing this, we
@@ -502,25 +1174,43 @@ private:
 
   /**
    * Notify this device of a packet saved into buffer. This method will get the
-   * ns-3 packet in pipeline and save into buffer map.
+   * ns-3 packet in pipeline and save it into the next slot of the buffer ring.
+   * The packet gets a new buffer ID, identifying its slot in the ring, that
+   * must be used as the packet id from now on.
    * \param packetId The ns-3 packet id.
    * \param timeout The buffer timeout.
+   * \return The new packet id.
    */
-  void BufferPacketSave (uint64_t packetId, time_t timeout);
+  uint64_t BufferPacketSave (uint64_t packetId, time_t timeout);
 
   /**
    * Notify this device of a packet retrieved from buffer. This method will get
-   * the ns-3 packet from buffer map and put it back into pipeline.
+   * the ns-3 packet from buffer ring and put it back into pipeline.
    * \param packetId The ns-3 packet id.
    */
   void BufferPacketRetrieve (uint64_t packetId);
 
   /**
-   * Delete the ns-3 packet from buffer map.
+   * Delete the ns-3 packet from buffer ring.
    * \param packetId The ns-3 packet id.
    */
   void BufferPacketDelete (uint64_t packetId);
 
+  /**
+   * Remove expired packets from the head of the buffer ring. As all packets
+   * are saved with the same timeout, they expire in the same order they were
+   * saved, so a single event per device is enough. Slots already emptied by
+   * packet retrieval or deletion are just skipped.
+   */
+  void BufferPacketExpire (void);
+
+  /**
+   * Remove the remote controller for this socket, releasing the library
+   * remote struct.
+   * \param socket The connection socket.
+   */
+  void RemoveRemoteController (Ptr<Socket> socket);
+
   /**
    * Get the remote controller for this socket.
    * \param socket The connection socket.
@@ -540,7 +1230,7 @@ private:
   /**
    * Get the remote controller for this ofsoftswitch13 remote pointer.
    * \param remote The ofsoftswitch13 remote pointer.
-   * \return The remote controller.
+   * \return The remote controller, or 0 if not found.
    */
   Ptr<OFSwitch13Device::RemoteController>
   GetRemoteController (struct remote *remote);
@@ -555,14 +1245,13 @@ private:
   static uint64_t GetNewPacketId ();
 
   /**
-   * Copy all tags (packet and byte) from srcPkt packet to dstPkt packet.
-   * \attention In the case of byte tags, the tags in dstPkt will cover the
-   * entire packet, regardless of the byte range in srcPkt.
-   * \param srcPkt The source packet.
-   * \param dstPkt The destination packet.
-   * \return true if everything's ok, false otherwise.
+   * Get the cached tag instance for this tag TypeId, creating it on the first
+   * call. This instance is used as a scratch object when copying tags, as tag
+   * contents are always deserialized before usage.
+   * \param tid The tag TypeId.
+   * \return The tag instance.
    */
-  static bool CopyTags (Ptr<const Packet> srcPkt, Ptr<const Packet> dstPkt);
+  static Tag* GetTagPrototype (TypeId tid);
 
   /**
    * Insert a new OpenFlow device in global map. Called by device constructor.
@@ -583,11 +1272,130 @@ private:
   /** Structure to save the list of active controllers. */
   typedef std::vector<Ptr<OFSwitch13Device::RemoteController> > CtrlList_t;
 
-  /** Structure to map datapath id to OpenFlow device. */
-  typedef std::map<uint64_t, Ptr<OFSwitch13Device> > DpIdDevMap_t;
+  /** Structure to save tag instances, indexed by TypeId uid. */
+  typedef std::vector<std::unique_ptr<Tag> > TagList_t;
 
-  /** Structure to save packets, indexed by its id. */
-  typedef std::map<uint64_t, Ptr<Packet> > IdPacketMap_t;
+  /** Structure to map ofsoftswitch13 remote pointers to controllers. */
+  typedef std::unordered_map<struct remote*,
+                             Ptr<OFSwitch13Device::RemoteController> >
+    RemoteCtrlMap_t;
+
+  /** Structure to save the list of devices in a housekeeping group. */
+  typedef std::vector<OFSwitch13Device*> DevList_t;
+
+  /** Devices sharing the same datapath timeout interval. */
+  struct TimeoutGroup
+  {
+    EventId   event;    //!< Group timeout event.
+    DevList_t devices;  //!< Devices with pending work.
+    uint32_t  members;  //!< Number of devices in this group.
+    Time      lastTick; //!< Last group timeout.
+  };
+
+  /** Structure to map timeout intervals to housekeeping groups. */
+  typedef std::map<Time, TimeoutGroup> TimeoutGroupMap_t;
+
+  /** Structure to save OpenFlow devices, indexed by datapath id. */
+  typedef std::vector<Ptr<OFSwitch13Device> > DpIdDevList_t;
+
+  /**
+   * Flag set in the IDs of packets saved into the switch buffer. The lower
+   * bits hold the buffer sequence number, which identifies the ring slot.
+   */
+  static const uint64_t BUFFER_ID_FLAG = (static_cast<uint64_t> (1) << 63);
+
+  /** Packet saved into the switch buffer ring. */
+  struct BufferSlot
+  {
+    uint64_t    id;       //!< Packet buffer ID.
+    Ptr<Packet> packet;   //!< Packet (0 for empty slots).
+    Time        expire;   //!< Expiration time.
+  };
+
+  /** Structure to save the buffer ring. */
+  typedef std::vector<BufferSlot> BufferRing_t;
+
+  /** A CPU processing core. */
+  struct CpuCore
+  {
+    EventId     event;      //!< Service completion event (running if busy).
+    Time        busyStart;  //!< Start of the busy time not yet accounted.
+    Time        busyTime;   //!< Busy time since last timeout.
+  };
+
+  /** Structure to save the list of CPU cores. */
+  typedef std::vector<CpuCore> CpuCoreList_t;
+
+  /** A control message waiting in the control message queue. */
+  struct CtrlMessage
+  {
+    Ptr<Packet> packet;   //!< The packet with the OpenFlow message.
+    Address     from;     //!< The packet sender address.
+    Time        arrival;  //!< The message arrival time.
+    uint64_t    updateBits; //!< CPU cost of the rule update (bits).
+  };
+
+  /** Flow entry in the eviction index of a flow table. */
+  struct EvictItem
+  {
+    uint64_t    key;      //!< The eviction key when the entry was indexed.
+    uint64_t    created;  //!< The entry creation time (to break ties).
+    uint64_t    seq;      //!< The index sequence number (to detect reuse).
+    struct flow_entry* entry; //!< The flow entry.
+  };
+
+  /**
+   * Eviction index of a flow table. The heap keeps the entries ordered by
+   * the eviction key they had when indexed. As the keys of the eviction
+   * policies never decrease, an entry on top of the heap whose key has grown
+   * is reindexed with the current key, and the first entry found with an
+   * unchanged key is the victim. Entries removed from the flow table are
+   * dropped from the map of live entries, and their heap items are discarded
+   * when they reach the top.
+   */
+  struct EvictIndex
+  {
+    std::vector<EvictItem> heap;  //!< The min-heap of indexed entries.
+    std::unordered_map<struct flow_entry*, uint64_t> live; //!< Live entries
+                                  //!< and their index sequence numbers.
+    EvictionPolicy policy;        //!< The policy used for the keys.
+    uint64_t    nextSeq;          //!< The next index sequence number.
+    bool        sync;             //!< The index must be rebuilt.
+  };
+
+  /** Structure to save the eviction indexes, indexed by table ID. */
+  typedef std::vector<EvictIndex> EvictIndexList_t;
+
+  /** Two-tier flow table state of a flow entry. */
+  struct TierEntry
+  {
+    uint64_t    created;  //!< The entry creation time (to detect reuse).
+    uint64_t    packets;  //!< The entry packet count at last rebalance.
+    bool        fast;     //!< The entry is in the fast tier.
+  };
+
+  /** Structure to map flow entries to two-tier table state. */
+  typedef std::unordered_map<struct flow_entry*, TierEntry> TierEntryMap_t;
+
+  /** Two-tier mode configuration of a flow table. */
+  struct TierConfig
+  {
+    uint32_t    fastSize;   //!< The fast tier capacity (0 disables).
+    Time        fastDelay;  //!< The fast tier lookup delay.
+    Time        slowDelay;  //!< The slow tier lookup delay.
+  };
+
+  /** Structure to save the two-tier configurations, indexed by table ID. */
+  typedef std::vector<TierConfig> TierConfigList_t;
+
+  /** Structure to save the lookup delay models, indexed by table ID. */
+  typedef std::vector<Ptr<OFSwitch13PipelineDelayModel> > DelayModelList_t;
+
+  /** Structure to save the flow table classifiers, indexed by table ID. */
+  typedef std::vector<Ptr<OFSwitch13Classifier> > ClassifierList_t;
+
+  /** Structure to save pipeline contexts, indexed by packet copy id. */
+  typedef std::unordered_map<uint64_t, Ptr<PipelinePacket> > IdPipePktMap_t;
 
   /** Trace source fired when a packet in buffer expires. */
   TracedCallback<Ptr<const Packet> > m_bufferExpireTrace;
@@ -598,6 +1406,27 @@ private:
   /** Trace source fired when a packet is saved into buffer. */
   TracedCallback<Ptr<const Packet> > m_bufferSaveTrace;
 
+  /** Trace source fired when a packet hits the flow cache. */
+  TracedCallback<Ptr<const Packet> > m_cacheHitTrace;
+
+  /** Trace source fired when a packet misses the flow cache. */
+  TracedCallback<Ptr<const Packet> > m_cacheMissTrace;
+
+  /** Trace source fired when a batch of packets is sent to pipeline. */
+  TracedCallback<uint32_t> m_batchTrace;
+
+  /** Trace source fired on timeout with the utilization of each CPU core. */
+  TracedCallback<uint32_t, double> m_cpuCoreLoadTrace;
+
+  /** Trace source fired when a packet leaves the CPU ingress queue. */
+  TracedCallback<Ptr<const Packet>, Time> m_cpuQueueDelayTrace;
+
+  /** Trace source fired when a flow table crosses a vacancy threshold. */
+  TracedCallback<uint8_t, uint8_t, bool> m_vacancyTrace;
+
+  /** Trace source fired when a flow mod takes effect. */
+  TracedCallback<Time> m_flowModTrace;
+
   /** Trace source fired when the datapath timeout operation is completed. */
   TracedCallback<Ptr<const OFSwitch13Device> > m_datapathTimeoutTrace;
 
@@ -625,42 +1454,108 @@ private:
   /** Average CPU processing load. */
   TracedValue<DataRate> m_cpuLoad;
 
+  /** Number of packets in the CPU ingress queue. */
+  TracedValue<uint32_t> m_cpuQueueLen;
+
   uint64_t          m_dpId;         //!< This datapath id.
   Time              m_timeout;      //!< Datapath timeout interval.
   Time              m_lastTimeout;  //!< Datapath last timeout.
+  Time              m_groupTimeout; //!< Housekeeping group interval.
+  uint32_t          m_groupIdx;     //!< Index in housekeeping group.
+  bool              m_groupAwake;   //!< Pending housekeeping work.
   Time              m_tcamDelay;    //!< Flow Table TCAM lookup delay.
   std::string       m_libLog;       //!< The ofsoftswitch13 library log level.
   struct datapath*  m_datapath;     //!< ofsoftswitch13 datapath structure.
   PortList_t        m_ports;        //!< List of switch ports.
   CtrlList_t        m_controllers;  //!< Collection of active controllers.
+  RemoteCtrlMap_t   m_remoteCtrls;  //!< Controllers by remote pointer.
   uint32_t          m_flowTabSize;  //!< Flow table maximum entries.
   uint32_t          m_groupTabSize; //!< Group table maximum entries.
   uint32_t          m_meterTabSize; //!< Meter table maximum entries.
   uint32_t          m_numPipeTabs;  //!< Number of pipeline flow tables.
-  IdPacketMap_t     m_bufferPkts;   //!< Packets saved in switch buffer.
+  BufferRing_t      m_bufferPkts;   //!< Packets saved in switch buffer.
+  uint64_t          m_bufferHead;   //!< Oldest buffer sequence number.
+  uint64_t          m_bufferTail;   //!< Next buffer sequence number.
+  uint32_t          m_bufferUsed;   //!< Number of packets in buffer.
+  EventId           m_bufferEvent;  //!< Buffer expiration event.
   uint32_t          m_bufferSize;   //!< Buffer size in terms of packets.
-  PipelinePacket    m_pipePkt;      //!< Packet under switch pipeline.
+  IdPipePktMap_t    m_pipePkts;     //!< Packets under switch pipeline.
   DataRate          m_cpuCapacity;  //!< CPU processing capacity.
   uint64_t          m_cpuConsumed;  //!< CPU processing tokens consumed.
   uint64_t          m_cpuTokens;    //!< CPU processing tokens available.
+  double            m_cpuTokensFrac; //!< CPU fractional tokens available.
+  Time              m_cpuLastFill;  //!< CPU bucket last refill time.
+  uint32_t          m_cpuNumCores;  //!< Number of CPU cores.
+  DataRate          m_cpuCoreRate;  //!< CPU core service rate.
+  CpuCoreList_t     m_cpuCores;     //!< CPU cores.
+  uint32_t          m_cpuQueueSize; //!< CPU ingress queue maximum size.
+  std::deque<IngressPacket> m_cpuQueue; //!< CPU ingress queue.
   uint64_t          m_cFlowMod;     //!< Pipeline flow mod counter.
   uint64_t          m_cGroupMod;    //!< Pipeline group mod counter.
   uint64_t          m_cMeterMod;    //!< Pipeline meter mod counter.
   uint64_t          m_cPacketIn;    //!< Pipeline packet in counter.
   uint64_t          m_cPacketOut;   //!< Pipeline packet out counter.
+  bool              m_cacheEnable;  //!< Flow cache enabled.
+  bool              m_cacheMega;    //!< Megaflow cache layer enabled.
+  uint32_t          m_cacheSize;    //!< Flow cache maximum entries.
+  OFSwitch13FlowCache m_flowCache;  //!< Flow cache.
+  OFSwitch13BufferPool m_bufPool;   //!< Control channel buffer pool.
+  OFSwitch13TimerWheel m_flowTimers; //!< Flow entry timing wheel.
+  bool              m_flowTimersSync; //!< Flow timing wheel must be rebuilt.
+  uint32_t          m_batchSize;    //!< Ingress batch maximum size.
+  Time              m_batchWindow;  //!< Ingress batch time window.
+  EventId           m_batchEvent;   //!< Ingress batch event.
+  std::deque<IngressPacket> m_batchQueue; //!< Ingress batch queue.
+  DelayModelList_t  m_tableDelays;  //!< Per table lookup delay models.
+  Ptr<OFSwitch13PipelineDelayModel> m_dftDelay; //!< Default delay model.
+  Time              m_egressDelay;  //!< Delay for the packet in pipeline.
+  Time              m_ruleDelay;    //!< Flow mod fixed update time.
+  Time              m_ruleShift;    //!< Flow mod time per shifted entry.
+  std::deque<CtrlMessage> m_ctrlQueue; //!< Control message queue.
+  EventId           m_ctrlEvent;    //!< Rule update completion event.
+  EvictionPolicy    m_evictPolicy;  //!< Flow table eviction policy.
+  EvictIndexList_t  m_evictIndexes; //!< Per table eviction indexes.
+  uint8_t           m_vacancyDown;  //!< Vacancy down threshold.
+  uint8_t           m_vacancyUp;    //!< Vacancy up threshold.
+  std::vector<bool> m_vacancyLow;   //!< Tables with vacancy down fired.
+  uint32_t          m_tierFastSize; //!< Fast tier capacity (0 disables).
+  Time              m_tierFastDelay; //!< Fast tier lookup delay.
+  Time              m_tierSlowDelay; //!< Slow tier lookup delay.
+  uint32_t          m_tierPromote;  //!< Hits for promotion to fast tier.
+  TierConfigList_t  m_tierConfigs;  //!< Per table two-tier configuration.
+  bool              m_tierTables;   //!< Per table two-tier mode enabled.
+  TierEntryMap_t    m_tierEntries;  //!< Two-tier flow entries state.
+  std::vector<uint32_t> m_tierFastCount; //!< Fast tier entries per table.
+  uint64_t          m_tierLookups;  //!< Two-tier table lookups.
+  uint64_t          m_tierFastHits; //!< Fast tier hits.
+  uint64_t          m_tierSlowHits; //!< Slow tier hits.
+  uint32_t          m_tcamWidth;    //!< TCAM slice width (bits).
+  uint32_t          m_tcamDftSlices; //!< TCAM default slices per table.
+  std::vector<uint32_t> m_tcamSlices; //!< TCAM slices per table.
+  std::vector<uint32_t> m_tcamUsed; //!< TCAM slices used per table.
+  bool              m_tcamUsedSync; //!< TCAM used slices must be recomputed.
+  ClassifierType    m_classDftType; //!< Default classifier algorithm.
+  std::vector<ClassifierType> m_classTypes; //!< Classifier per table.
+  ClassifierList_t  m_classifiers;  //!< Flow table classifiers.
+  std::vector<std::vector<uint32_t> > m_exactFields; //!< Exact-match fields.
+  double            m_treeSpace;    //!< Decision tree space factor.
 
   static uint64_t   m_globalDpId;   //!< Global counter for datapath IDs.
   static uint64_t   m_globalPktId;  //!< Global counter for packets IDs.
+  static TagList_t  m_tagPrototypes; //!< Cached tag instances for CopyTags.
+  static TimeoutGroupMap_t m_timeoutGroups; //!< Housekeeping groups.
 
   /**
    * As the integration of ofsoftswitch13 and ns-3 involve overriding some C
-   * functions, we are using a global map to store a pointer to all
+   * functions, we are using a global list to store a pointer to all
    * OFSwitch13Device objects in simulation, and allow faster object retrieve
    * by datapath id. In this way, static functions like
    * SendOpenflowBufferToRemote, DpActionsOutputPort, and other callbacks can
-   * get the object pointer and call member functions.
+   * get the object pointer and call member functions. As datapath IDs are
+   * sequentially assigned starting at 1, the list is indexed by the datapath
+   * ID itself, and the retrieve costs a single vector access.
    */
-  static DpIdDevMap_t m_globalSwitchMap;
+  static DpIdDevList_t m_globalSwitchList;
 
 }; // Class OFSwitch13Device
 
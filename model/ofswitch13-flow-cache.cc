@@ -0,0 +1,263 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+#include "ofswitch13-flow-cache.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("OFSwitch13FlowCache");
+
+void
+OFSwitch13FlowCache::Entry::Clear (void)
+{
+  visits.clear ();
+  outputs.clear ();
+}
+
+OFSwitch13FlowCache::OFSwitch13FlowCache (uint32_t maxEntries)
+  : m_nMegaflows (0),
+  m_maxEntries (maxEntries)
+{
+  NS_LOG_FUNCTION (this << maxEntries);
+}
+
+const OFSwitch13FlowCache::Entry*
+OFSwitch13FlowCache::Lookup (const OFSwitch13FlowKey &key)
+{
+  auto it = m_entries.find (key);
+  if (it != m_entries.end ())
+    {
+      if (IsValid (it->second.entry))
+        {
+          m_microLru.splice (m_microLru.begin (), m_microLru, it->second.lru);
+          return &it->second.entry;
+        }
+      NS_LOG_DEBUG ("Removing stale microflow cache entry.");
+      m_microLru.erase (it->second.lru);
+      m_entries.erase (it);
+    }
+
+  // Search the megaflow subtables. Valid megaflow entries were generated
+  // from the current state of the tables they visited, so any matching
+  // entry holds a valid result.
+  for (auto &subtable : m_subtables)
+    {
+      OFSwitch13FlowKey maskedKey = key;
+      maskedKey.ApplyMask (subtable.mask);
+      auto mt = subtable.entries.find (maskedKey);
+      if (mt == subtable.entries.end ())
+        {
+          continue;
+        }
+      if (!IsValid (mt->second.entry))
+        {
+          NS_LOG_DEBUG ("Removing stale megaflow cache entry.");
+          RemoveMegaflow (mt->second.lru);
+          continue;
+        }
+
+      // Promote this flow to the microflow layer.
+      m_megaLru.splice (m_megaLru.begin (), m_megaLru, mt->second.lru);
+      Insert (key, mt->second.entry);
+      return &mt->second.entry;
+    }
+  return 0;
+}
+
+void
+OFSwitch13FlowCache::Insert (const OFSwitch13FlowKey &key, const Entry &entry)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_maxEntries == 0)
+    {
+      return;
+    }
+
+  auto it = m_entries.find (key);
+  if (it == m_entries.end ())
+    {
+      // When the cache is full, evict the least recently used entry to make
+      // room for the new one.
+      if (m_entries.size () >= m_maxEntries)
+        {
+          NS_LOG_DEBUG ("Flow cache full. Evicting an entry.");
+          m_entries.erase (m_microLru.back ().key);
+          m_microLru.pop_back ();
+        }
+      LruItem lruItem = {key, 0};
+      m_microLru.push_front (lruItem);
+      it = m_entries.insert (std::make_pair (key, Item ())).first;
+    }
+  else
+    {
+      m_microLru.splice (m_microLru.begin (), m_microLru, it->second.lru);
+    }
+  it->second.entry = entry;
+  it->second.lru = m_microLru.begin ();
+  for (auto &visit : it->second.entry.visits)
+    {
+      visit.revision = GetRevision (visit.table->stats->table_id);
+    }
+}
+
+void
+OFSwitch13FlowCache::Insert (const OFSwitch13FlowKey &key,
+                             const OFSwitch13FlowKey &mask, const Entry &entry)
+{
+  NS_LOG_FUNCTION (this);
+
+  Insert (key, entry);
+  if (m_maxEntries == 0)
+    {
+      return;
+    }
+
+  // Find the subtable for this mask, creating a new one when necessary.
+  uint32_t index = 0;
+  while (index < m_subtables.size () && !(m_subtables [index].mask == mask))
+    {
+      index++;
+    }
+  if (index == m_subtables.size ())
+    {
+      NS_LOG_DEBUG ("New megaflow subtable.");
+      m_subtables.push_back (Subtable ());
+      m_subtables.back ().mask = mask;
+    }
+
+  OFSwitch13FlowKey maskedKey = key;
+  maskedKey.ApplyMask (mask);
+  auto it = m_subtables [index].entries.find (maskedKey);
+  if (it != m_subtables [index].entries.end ())
+    {
+      RemoveMegaflow (it->second.lru);
+    }
+
+  // When the megaflow layer is full, evict the least recently used entry
+  // (empty subtables are only removed when the cache is flushed).
+  if (m_nMegaflows >= m_maxEntries)
+    {
+      NS_LOG_DEBUG ("Megaflow cache full. Evicting an entry.");
+      RemoveMegaflow (--m_megaLru.end ());
+    }
+  LruItem lruItem = {maskedKey, index};
+  m_megaLru.push_front (lruItem);
+  Item &item = m_subtables [index].entries [maskedKey];
+  item.entry = m_entries [key].entry;
+  item.lru = m_megaLru.begin ();
+  m_nMegaflows++;
+}
+
+void
+OFSwitch13FlowCache::Invalidate (uint8_t tableId)
+{
+  NS_LOG_FUNCTION (this << (uint16_t)tableId);
+
+  if (tableId == OFPTT_ALL)
+    {
+      Flush ();
+      return;
+    }
+  if (tableId >= m_revisions.size ())
+    {
+      m_revisions.resize (tableId + 1, 0);
+    }
+  m_revisions [tableId]++;
+}
+
+void
+OFSwitch13FlowCache::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_entries.size () || m_nMegaflows)
+    {
+      NS_LOG_DEBUG ("Flushing " << m_entries.size () << " microflow and " <<
+                    m_nMegaflows << " megaflow cache entries.");
+      m_entries.clear ();
+    }
+  m_microLru.clear ();
+  m_subtables.clear ();
+  m_megaLru.clear ();
+  m_nMegaflows = 0;
+}
+
+uint32_t
+OFSwitch13FlowCache::GetNEntries (void) const
+{
+  return m_entries.size ();
+}
+
+uint32_t
+OFSwitch13FlowCache::GetNMegaflows (void) const
+{
+  return m_nMegaflows;
+}
+
+uint32_t
+OFSwitch13FlowCache::GetNMasks (void) const
+{
+  return m_subtables.size ();
+}
+
+uint32_t
+OFSwitch13FlowCache::GetMaxEntries (void) const
+{
+  return m_maxEntries;
+}
+
+void
+OFSwitch13FlowCache::SetMaxEntries (uint32_t value)
+{
+  NS_LOG_FUNCTION (this << value);
+
+  Flush ();
+  m_maxEntries = value;
+}
+
+uint32_t
+OFSwitch13FlowCache::GetRevision (uint8_t tableId) const
+{
+  return tableId < m_revisions.size () ? m_revisions [tableId] : 0;
+}
+
+bool
+OFSwitch13FlowCache::IsValid (const Entry &entry) const
+{
+  for (auto const &visit : entry.visits)
+    {
+      if (visit.revision != GetRevision (visit.table->stats->table_id))
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+void
+OFSwitch13FlowCache::RemoveMegaflow (LruList_t::iterator lru)
+{
+  m_subtables [lru->subtable].entries.erase (lru->key);
+  m_megaLru.erase (lru);
+  m_nMegaflows--;
+}
+
+} // namespace ns3
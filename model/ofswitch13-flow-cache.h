@@ -0,0 +1,212 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+#ifndef OFSWITCH13_FLOW_CACHE_H
+#define OFSWITCH13_FLOW_CACHE_H
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "ofswitch13-interface.h"
+#include "ofswitch13-flow-key.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup ofswitch13
+ *
+ * Exact-match flow cache for the OpenFlow datapath. Each cache entry is
+ * indexed by the flow key parsed from packet headers and memoizes the result
+ * of the OpenFlow pipeline processing for that flow: the sequence of flow
+ * tables visited by the packet (and the flow entries matched on them) and the
+ * list of switch ports (and queues) where the packet was sent to. In this
+ * way, subsequent packets from the same flow can be forwarded without
+ * building the internal ofsoftswitch13 packet structures and walking through
+ * the pipeline again.
+ *
+ * The cache has two layers. The microflow layer is indexed by the exact flow
+ * key. The megaflow layer (when enabled) is indexed by the flow key masked to
+ * the header bits that were actually consulted by the pipeline while
+ * processing the first packet of the flow, so a single megaflow entry can
+ * cover many microflows. Megaflow entries with the same mask are grouped into
+ * the same subtable (tuple space search), and a megaflow hit is promoted to
+ * the microflow layer.
+ *
+ * Only pipeline results that depend exclusively on the packet header fields
+ * and on the current flow table entries can be saved into the cache. Each
+ * flow table has a revision number, saved into the cache entries for the
+ * tables they visited. A flow table change (flow modifications and flow entry
+ * expirations) invalidates the table revision, so only the cache entries that
+ * visited that table become stale, and they are dropped when found by a
+ * lookup. Any other datapath state change (group, meter, port, or table
+ * modifications) requires a cache flush.
+ *
+ * When a cache layer is full, the least recently used entry is evicted.
+ */
+class OFSwitch13FlowCache
+{
+public:
+  /** Switch output memoized by a cache entry. */
+  struct Output
+  {
+    uint32_t            portNo;   //!< The output port number.
+    uint32_t            queueNo;  //!< The output queue number.
+  };
+
+  /** Flow table visited by the packet while traversing the pipeline. */
+  struct Visit
+  {
+    struct flow_table*  table;    //!< The flow table.
+    struct flow_entry*  entry;    //!< The matched entry (0 for table miss).
+    uint32_t            revision; //!< Table revision (set by the cache).
+  };
+
+  /** Pipeline processing result memoized for a flow. */
+  struct Entry
+  {
+    /** Clear the entry content. */
+    void Clear (void);
+
+    std::vector<Visit>  visits;   //!< Visited flow tables (in order).
+    std::vector<Output> outputs;  //!< Output ports (in order).
+  };
+
+  /**
+   * Complete constructor.
+   * \param maxEntries The maximum number of entries in this cache.
+   */
+  OFSwitch13FlowCache (uint32_t maxEntries = 0);
+
+  /**
+   * Look for the cache entry associated with this flow key, first in the
+   * microflow layer and then in the megaflow layer. Stale entries found on the
+   * way are removed.
+   * \param key The flow key.
+   * \return The cache entry, or 0 if not found.
+   */
+  const Entry* Lookup (const OFSwitch13FlowKey &key);
+
+  /**
+   * Insert a new entry into the microflow layer, replacing any existing entry
+   * for the same flow key. When the layer is full, the least recently used
+   * entry is evicted. The entry is saved with the current table revisions.
+   * \param key The flow key.
+   * \param entry The cache entry.
+   */
+  void Insert (const OFSwitch13FlowKey &key, const Entry &entry);
+
+  /**
+   * Insert a new entry into both the microflow and the megaflow layers.
+   * \param key The flow key.
+   * \param mask The mask with the header bits consulted by the pipeline.
+   * \param entry The cache entry.
+   */
+  void Insert (const OFSwitch13FlowKey &key, const OFSwitch13FlowKey &mask,
+               const Entry &entry);
+
+  /**
+   * Invalidate the cache entries that visited this flow table.
+   * \param tableId The flow table ID (OFPTT_ALL flushes the cache).
+   */
+  void Invalidate (uint8_t tableId);
+
+  /** Remove all entries from the cache. */
+  void Flush (void);
+
+  /**
+   * \name Cache size accessors.
+   * \return The requested value.
+   */
+  //\{
+  uint32_t GetNEntries    (void) const;
+  uint32_t GetNMegaflows  (void) const;
+  uint32_t GetNMasks      (void) const;
+  uint32_t GetMaxEntries  (void) const;
+  //\}
+
+  /**
+   * Set the maximum number of entries in each cache layer, flushing it.
+   * \param value The value to set.
+   */
+  void SetMaxEntries (uint32_t value);
+
+private:
+  /** Cache entry in the recency list of a cache layer. */
+  struct LruItem
+  {
+    OFSwitch13FlowKey   key;      //!< The (masked) flow key.
+    uint32_t            subtable; //!< The megaflow subtable index.
+  };
+
+  /** Structure to save the recency list, most recently used first. */
+  typedef std::list<LruItem> LruList_t;
+
+  /** Cache entry and its position in the recency list. */
+  struct Item
+  {
+    Entry               entry;    //!< The cache entry.
+    LruList_t::iterator lru;      //!< The position in the recency list.
+  };
+
+  /** Structure to map flow keys to cache entries. */
+  typedef std::unordered_map<OFSwitch13FlowKey, Item,
+                             OFSwitch13FlowKey::Hasher> KeyItemMap_t;
+
+  /** Megaflow subtable, holding entries that share the same mask. */
+  struct Subtable
+  {
+    OFSwitch13FlowKey   mask;     //!< The subtable mask.
+    KeyItemMap_t        entries;  //!< Entries indexed by masked keys.
+  };
+
+  /** Structure to save the list of megaflow subtables. */
+  typedef std::vector<Subtable> SubtableList_t;
+
+  /**
+   * Get the current revision of a flow table.
+   * \param tableId The flow table ID.
+   * \return The table revision.
+   */
+  uint32_t GetRevision (uint8_t tableId) const;
+
+  /**
+   * Check if the cache entry was saved with the current table revisions.
+   * \param entry The cache entry.
+   * \return true for valid entries.
+   */
+  bool IsValid (const Entry &entry) const;
+
+  /**
+   * Remove an entry from the megaflow layer.
+   * \param lru The entry position in the megaflow recency list.
+   */
+  void RemoveMegaflow (LruList_t::iterator lru);
+
+  KeyItemMap_t        m_entries;      //!< Microflow entries.
+  LruList_t           m_microLru;     //!< Microflow recency list.
+  SubtableList_t      m_subtables;    //!< Megaflow subtables.
+  LruList_t           m_megaLru;      //!< Megaflow recency list.
+  uint32_t            m_nMegaflows;   //!< Number of megaflow entries.
+  uint32_t            m_maxEntries;   //!< Maximum number of entries.
+  std::vector<uint32_t> m_revisions;  //!< Flow table revisions.
+}; // Class OFSwitch13FlowCache
+
+} // namespace ns3
+#endif /* OFSWITCH13_FLOW_CACHE_H */
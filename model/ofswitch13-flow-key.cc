@@ -0,0 +1,695 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+#include <cstring>
+#include <ns3/log.h>
+#include "ofswitch13-flow-key.h"
+#include "ofswitch13-interface.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("OFSwitch13FlowKey");
+
+// The key is hashed and compared as an array of 64-bit words.
+static_assert (sizeof (OFSwitch13FlowKey) % sizeof (uint64_t) == 0,
+               "Flow key size must be a multiple of 64 bits");
+
+/** Read a 16-bit value in network byte order. */
+static inline uint16_t
+ReadNtohU16 (const uint8_t *p)
+{
+  return (static_cast<uint16_t> (p[0]) << 8) | p[1];
+}
+
+/** Read a 32-bit value in network byte order. */
+static inline uint32_t
+ReadNtohU32 (const uint8_t *p)
+{
+  return (static_cast<uint32_t> (p[0]) << 24)
+         | (static_cast<uint32_t> (p[1]) << 16)
+         | (static_cast<uint32_t> (p[2]) << 8) | p[3];
+}
+
+OFSwitch13FlowKey::OFSwitch13FlowKey ()
+{
+  memset (this, 0, sizeof (OFSwitch13FlowKey));
+}
+
+bool
+OFSwitch13FlowKey::Extract (Ptr<const Packet> packet, uint32_t inPort,
+                            uint64_t tunnelId)
+{
+  uint8_t data [MAX_HEADER_BYTES];
+  uint32_t size = packet->CopyData (data, MAX_HEADER_BYTES);
+  return Extract (data, size, inPort, tunnelId);
+}
+
+bool
+OFSwitch13FlowKey::Extract (const uint8_t *data, uint32_t size,
+                            uint32_t inPort, uint64_t tunnelId)
+{
+  memset (this, 0, sizeof (OFSwitch13FlowKey));
+  this->inPort = inPort;
+  this->tunnelId = tunnelId;
+
+  // Ethernet header.
+  uint32_t offset = 14;
+  if (size < offset)
+    {
+      return false;
+    }
+  memcpy (ethDst, data, 6);
+  memcpy (ethSrc, data + 6, 6);
+  uint16_t type = ReadNtohU16 (data + 12);
+
+  // VLAN tags (the VLAN fields come from the outermost tag).
+  while (type == 0x8100 || type == 0x88a8)
+    {
+      if (size < offset + 4)
+        {
+          return false;
+        }
+      if (!(layers & LAYER_VLAN))
+        {
+          uint16_t tci = ReadNtohU16 (data + offset);
+          vlanVid = (tci & 0x0fff) | OFPVID_PRESENT;
+          vlanPcp = tci >> 13;
+          layers |= LAYER_VLAN;
+        }
+      type = ReadNtohU16 (data + offset + 2);
+      offset += 4;
+    }
+  ethType = type;
+
+  switch (type)
+    {
+    case 0x8847:
+    case 0x8848:
+      {
+        // MPLS (fields from the top label, no parsing beyond the stack).
+        if (size < offset + 4)
+          {
+            return false;
+          }
+        uint32_t lse = ReadNtohU32 (data + offset);
+        if ((lse & 0xff) <= 1)
+          {
+            // Invalid TTL. Let the pipeline handle it.
+            return false;
+          }
+        mplsLabel = lse >> 12;
+        mplsTc = (lse >> 9) & 0x07;
+        mplsBos = (lse >> 8) & 0x01;
+        layers |= LAYER_MPLS;
+        return true;
+      }
+    case 0x0806:
+      {
+        // ARP (only Ethernet/IPv4 ARP is supported).
+        if (size < offset + 28)
+          {
+            return false;
+          }
+        const uint8_t *arp = data + offset;
+        if (ReadNtohU16 (arp) != 1 || ReadNtohU16 (arp + 2) != 0x0800
+            || arp[4] != 6 || arp[5] != 4)
+          {
+            return false;
+          }
+        arpOp = ReadNtohU16 (arp + 6);
+        memcpy (arpSha, arp + 8, 6);
+        memcpy (nwSrc, arp + 14, 4);
+        memcpy (arpTha, arp + 18, 6);
+        memcpy (nwDst, arp + 24, 4);
+        layers |= LAYER_ARP;
+        return true;
+      }
+    case 0x0800:
+      {
+        // IPv4.
+        if (size < offset + 20)
+          {
+            return false;
+          }
+        const uint8_t *ip = data + offset;
+        uint32_t ihl = (ip[0] & 0x0f) * 4;
+        uint16_t frag = ReadNtohU16 (ip + 6);
+        if ((ip[0] >> 4) != 4 || ihl < 20 || size < offset + ihl)
+          {
+            return false;
+          }
+        if ((frag & 0x3fff) != 0 || ip[8] <= 1)
+          {
+            // IP fragments and packets with invalid TTL are left to the
+            // pipeline.
+            return false;
+          }
+        ipDscp = ip[1] >> 2;
+        ipEcn = ip[1] & 0x03;
+        ipProto = ip[9];
+        memcpy (nwSrc, ip + 12, 4);
+        memcpy (nwDst, ip + 16, 4);
+        layers |= LAYER_IP | LAYER_IPV4;
+        offset += ihl;
+        break;
+      }
+    case 0x86dd:
+      {
+        // IPv6 (extension headers are not supported).
+        if (size < offset + 40)
+          {
+            return false;
+          }
+        const uint8_t *ip = data + offset;
+        uint32_t word = ReadNtohU32 (ip);
+        if ((word >> 28) != 6)
+          {
+            return false;
+          }
+        ipDscp = (word >> 22) & 0x3f;
+        ipEcn = (word >> 20) & 0x03;
+        ipv6Flabel = word & 0x000fffff;
+        ipProto = ip[6];
+        memcpy (ipv6Src, ip + 8, 16);
+        memcpy (ipv6Dst, ip + 24, 16);
+        layers |= LAYER_IP | LAYER_IPV6;
+        offset += 40;
+        switch (ipProto)
+          {
+          case 0:   // Hop-by-hop options.
+          case 43:  // Routing.
+          case 44:  // Fragment.
+          case 50:  // ESP.
+          case 51:  // AH.
+          case 60:  // Destination options.
+          case 135: // Mobility.
+            return false;
+          }
+        break;
+      }
+    case 0x88e7:
+      {
+        // PBB fields are not supported.
+        return false;
+      }
+    default:
+      {
+        // Other Ethernet types have no matchable fields beyond L2.
+        return true;
+      }
+    }
+
+  // Transport layer (ports, or ICMP type and code).
+  switch (ipProto)
+    {
+    case 6:
+    case 17:
+    case 132:
+      {
+        if (size < offset + 4)
+          {
+            return false;
+          }
+        l4Src = ReadNtohU16 (data + offset);
+        l4Dst = ReadNtohU16 (data + offset + 2);
+        layers |= (ipProto == 6) ? LAYER_TCP :
+          (ipProto == 17) ? LAYER_UDP : LAYER_SCTP;
+        break;
+      }
+    case 1:
+      {
+        if ((layers & LAYER_IPV4) == 0 || size < offset + 2)
+          {
+            return false;
+          }
+        icmpType = data [offset];
+        icmpCode = data [offset + 1];
+        layers |= LAYER_ICMPV4;
+        break;
+      }
+    case 58:
+      {
+        if ((layers & LAYER_IPV6) == 0 || size < offset + 2)
+          {
+            return false;
+          }
+        icmpType = data [offset];
+        icmpCode = data [offset + 1];
+        if (icmpType == 135 || icmpType == 136)
+          {
+            // Neighbor discovery fields are not supported.
+            return false;
+          }
+        layers |= LAYER_ICMPV6;
+        break;
+      }
+    }
+  return true;
+}
+
+void
+OFSwitch13FlowKey::ApplyMask (const OFSwitch13FlowKey &mask)
+{
+  uint64_t *words = reinterpret_cast<uint64_t*> (this);
+  const uint64_t *maskWords = mask.GetWords ();
+  for (size_t i = 0; i < OFS_FLOW_KEY_WORDS; i++)
+    {
+      words [i] &= maskWords [i];
+    }
+}
+
+/**
+ * Set the mask bits for a field.
+ * \param field The field pointer.
+ * \param size The field size.
+ * \param tlv The OXM TLV value (including the mask, when present).
+ * \param bytewise Use the TLV mask bytes, when present.
+ */
+static inline void
+SetMaskBits (void *field, size_t size, const struct ofl_match_tlv *tlv,
+             bool bytewise)
+{
+  uint8_t *bytes = static_cast<uint8_t*> (field);
+  if (bytewise && OXM_HASMASK (tlv->header))
+    {
+      // Address fields are saved in network byte order in both the key and
+      // the TLV, so the mask bytes can be used directly.
+      NS_ASSERT (OXM_LENGTH (tlv->header) == 2 * size);
+      const uint8_t *maskBytes = tlv->value + size;
+      for (size_t i = 0; i < size; i++)
+        {
+          bytes [i] |= maskBytes [i];
+        }
+    }
+  else
+    {
+      memset (bytes, 0xff, size);
+    }
+}
+
+bool
+OFSwitch13FlowKey::AddMatchMask (const struct ofl_match *match)
+{
+  // The presence of protocol layers is always relevant for matching.
+  layers = 0xffffffff;
+
+  struct ofl_match_tlv *tlv;
+  HMAP_FOR_EACH (tlv, struct ofl_match_tlv, hmap_node, &match->match_fields)
+  {
+    switch (OXM_TYPE (tlv->header))
+      {
+      case OXM_TYPE (OXM_OF_IN_PORT):
+      case OXM_TYPE (OXM_OF_IN_PHY_PORT):
+        SetMaskBits (&inPort, sizeof (inPort), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_METADATA):
+        break;
+      case OXM_TYPE (OXM_OF_ETH_DST):
+        SetMaskBits (ethDst, sizeof (ethDst), tlv, true);
+        break;
+      case OXM_TYPE (OXM_OF_ETH_SRC):
+        SetMaskBits (ethSrc, sizeof (ethSrc), tlv, true);
+        break;
+      case OXM_TYPE (OXM_OF_ETH_TYPE):
+        SetMaskBits (&ethType, sizeof (ethType), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_VLAN_VID):
+        SetMaskBits (&vlanVid, sizeof (vlanVid), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_VLAN_PCP):
+        SetMaskBits (&vlanPcp, sizeof (vlanPcp), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_IP_DSCP):
+        SetMaskBits (&ipDscp, sizeof (ipDscp), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_IP_ECN):
+        SetMaskBits (&ipEcn, sizeof (ipEcn), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_IP_PROTO):
+        SetMaskBits (&ipProto, sizeof (ipProto), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_IPV4_SRC):
+      case OXM_TYPE (OXM_OF_ARP_SPA):
+        SetMaskBits (nwSrc, sizeof (nwSrc), tlv, true);
+        break;
+      case OXM_TYPE (OXM_OF_IPV4_DST):
+      case OXM_TYPE (OXM_OF_ARP_TPA):
+        SetMaskBits (nwDst, sizeof (nwDst), tlv, true);
+        break;
+      case OXM_TYPE (OXM_OF_TCP_SRC):
+      case OXM_TYPE (OXM_OF_UDP_SRC):
+      case OXM_TYPE (OXM_OF_SCTP_SRC):
+        SetMaskBits (&l4Src, sizeof (l4Src), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_TCP_DST):
+      case OXM_TYPE (OXM_OF_UDP_DST):
+      case OXM_TYPE (OXM_OF_SCTP_DST):
+        SetMaskBits (&l4Dst, sizeof (l4Dst), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_ICMPV4_TYPE):
+      case OXM_TYPE (OXM_OF_ICMPV6_TYPE):
+        SetMaskBits (&icmpType, sizeof (icmpType), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_ICMPV4_CODE):
+      case OXM_TYPE (OXM_OF_ICMPV6_CODE):
+        SetMaskBits (&icmpCode, sizeof (icmpCode), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_ARP_OP):
+        SetMaskBits (&arpOp, sizeof (arpOp), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_ARP_SHA):
+        SetMaskBits (arpSha, sizeof (arpSha), tlv, true);
+        break;
+      case OXM_TYPE (OXM_OF_ARP_THA):
+        SetMaskBits (arpTha, sizeof (arpTha), tlv, true);
+        break;
+      case OXM_TYPE (OXM_OF_IPV6_SRC):
+        SetMaskBits (ipv6Src, sizeof (ipv6Src), tlv, true);
+        break;
+      case OXM_TYPE (OXM_OF_IPV6_DST):
+        SetMaskBits (ipv6Dst, sizeof (ipv6Dst), tlv, true);
+        break;
+      case OXM_TYPE (OXM_OF_IPV6_FLABEL):
+        SetMaskBits (&ipv6Flabel, sizeof (ipv6Flabel), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_MPLS_LABEL):
+        SetMaskBits (&mplsLabel, sizeof (mplsLabel), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_MPLS_TC):
+        SetMaskBits (&mplsTc, sizeof (mplsTc), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_MPLS_BOS):
+        SetMaskBits (&mplsBos, sizeof (mplsBos), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_TUNNEL_ID):
+        SetMaskBits (&tunnelId, sizeof (tunnelId), tlv, false);
+        break;
+      case OXM_TYPE (OXM_OF_IPV6_ND_TARGET):
+      case OXM_TYPE (OXM_OF_IPV6_ND_SLL):
+      case OXM_TYPE (OXM_OF_IPV6_ND_TLL):
+      case OXM_TYPE (OXM_OF_PBB_ISID):
+        // These fields are never present in packets with a valid key, so
+        // entries matching them never match and the field is irrelevant.
+        break;
+      default:
+        NS_LOG_DEBUG ("Unsupported match field " << tlv->header);
+        return false;
+      }
+  }
+  return true;
+}
+
+/**
+ * Copy the value of a field from the OXM TLV, applying the TLV mask when
+ * present, and set the field bits in the mask key.
+ * \param key The key with the field.
+ * \param field The field pointer (in key).
+ * \param size The field size.
+ * \param tlv The OXM TLV value (including the mask, when present).
+ * \param mask The mask key (may be 0).
+ * \return false if the TLV length doesn't fit the field.
+ */
+static inline bool
+SetFieldValue (OFSwitch13FlowKey *key, void *field, size_t size,
+               const struct ofl_match_tlv *tlv, OFSwitch13FlowKey *mask)
+{
+  bool hasMask = OXM_HASMASK (tlv->header);
+  if (OXM_LENGTH (tlv->header) != (hasMask ? 2 * size : size))
+    {
+      return false;
+    }
+
+  // Both the key and the TLV use the same byte order for each field, so the
+  // value and mask bytes can be used directly.
+  uint8_t *bytes = static_cast<uint8_t*> (field);
+  uint8_t *maskBytes = 0;
+  if (mask)
+    {
+      maskBytes = reinterpret_cast<uint8_t*> (mask)
+        + (bytes - reinterpret_cast<uint8_t*> (key));
+    }
+  for (size_t i = 0; i < size; i++)
+    {
+      uint8_t bits = hasMask ? tlv->value [size + i] : 0xff;
+      bytes [i] = tlv->value [i] & bits;
+      if (maskBytes)
+        {
+          maskBytes [i] |= bits;
+        }
+    }
+  return true;
+}
+
+/**
+ * Get the protocol layer that must be present in the packet for the OXM
+ * field to be found by the ofsoftswitch13 packet parser.
+ * \param header The OXM TLV header.
+ * \return The layer bit, or 0 for fields that don't depend on a layer.
+ */
+static inline uint32_t
+GetFieldLayer (uint32_t header)
+{
+  switch (OXM_TYPE (header))
+    {
+    case OXM_TYPE (OXM_OF_VLAN_PCP):
+      return OFSwitch13FlowKey::LAYER_VLAN;
+    case OXM_TYPE (OXM_OF_MPLS_LABEL):
+    case OXM_TYPE (OXM_OF_MPLS_TC):
+    case OXM_TYPE (OXM_OF_MPLS_BOS):
+      return OFSwitch13FlowKey::LAYER_MPLS;
+    case OXM_TYPE (OXM_OF_IP_DSCP):
+    case OXM_TYPE (OXM_OF_IP_ECN):
+    case OXM_TYPE (OXM_OF_IP_PROTO):
+      return OFSwitch13FlowKey::LAYER_IP;
+    case OXM_TYPE (OXM_OF_IPV4_SRC):
+    case OXM_TYPE (OXM_OF_IPV4_DST):
+      return OFSwitch13FlowKey::LAYER_IPV4;
+    case OXM_TYPE (OXM_OF_IPV6_SRC):
+    case OXM_TYPE (OXM_OF_IPV6_DST):
+    case OXM_TYPE (OXM_OF_IPV6_FLABEL):
+      return OFSwitch13FlowKey::LAYER_IPV6;
+    case OXM_TYPE (OXM_OF_ARP_OP):
+    case OXM_TYPE (OXM_OF_ARP_SPA):
+    case OXM_TYPE (OXM_OF_ARP_TPA):
+    case OXM_TYPE (OXM_OF_ARP_SHA):
+    case OXM_TYPE (OXM_OF_ARP_THA):
+      return OFSwitch13FlowKey::LAYER_ARP;
+    case OXM_TYPE (OXM_OF_TCP_SRC):
+    case OXM_TYPE (OXM_OF_TCP_DST):
+      return OFSwitch13FlowKey::LAYER_TCP;
+    case OXM_TYPE (OXM_OF_UDP_SRC):
+    case OXM_TYPE (OXM_OF_UDP_DST):
+      return OFSwitch13FlowKey::LAYER_UDP;
+    case OXM_TYPE (OXM_OF_SCTP_SRC):
+    case OXM_TYPE (OXM_OF_SCTP_DST):
+      return OFSwitch13FlowKey::LAYER_SCTP;
+    case OXM_TYPE (OXM_OF_ICMPV4_TYPE):
+    case OXM_TYPE (OXM_OF_ICMPV4_CODE):
+      return OFSwitch13FlowKey::LAYER_ICMPV4;
+    case OXM_TYPE (OXM_OF_ICMPV6_TYPE):
+    case OXM_TYPE (OXM_OF_ICMPV6_CODE):
+      return OFSwitch13FlowKey::LAYER_ICMPV6;
+    default:
+      return 0;
+    }
+}
+
+bool
+OFSwitch13FlowKey::SetMatch (const struct ofl_match *match,
+                             OFSwitch13FlowKey *mask)
+{
+  memset (this, 0, sizeof (OFSwitch13FlowKey));
+
+  bool ok = true;
+  struct ofl_match_tlv *tlv;
+  HMAP_FOR_EACH (tlv, struct ofl_match_tlv, hmap_node, &match->match_fields)
+  {
+    void *field = 0;
+    size_t size = 0;
+    switch (OXM_TYPE (tlv->header))
+      {
+      case OXM_TYPE (OXM_OF_IN_PORT):
+        field = &inPort;
+        size = sizeof (inPort);
+        break;
+      case OXM_TYPE (OXM_OF_METADATA):
+        field = &metadata;
+        size = sizeof (metadata);
+        break;
+      case OXM_TYPE (OXM_OF_TUNNEL_ID):
+        field = &tunnelId;
+        size = sizeof (tunnelId);
+        break;
+      case OXM_TYPE (OXM_OF_ETH_DST):
+        field = ethDst;
+        size = sizeof (ethDst);
+        break;
+      case OXM_TYPE (OXM_OF_ETH_SRC):
+        field = ethSrc;
+        size = sizeof (ethSrc);
+        break;
+      case OXM_TYPE (OXM_OF_ETH_TYPE):
+        field = &ethType;
+        size = sizeof (ethType);
+        break;
+      case OXM_TYPE (OXM_OF_VLAN_VID):
+        field = &vlanVid;
+        size = sizeof (vlanVid);
+        break;
+      case OXM_TYPE (OXM_OF_VLAN_PCP):
+        field = &vlanPcp;
+        size = sizeof (vlanPcp);
+        break;
+      case OXM_TYPE (OXM_OF_IP_DSCP):
+        field = &ipDscp;
+        size = sizeof (ipDscp);
+        break;
+      case OXM_TYPE (OXM_OF_IP_ECN):
+        field = &ipEcn;
+        size = sizeof (ipEcn);
+        break;
+      case OXM_TYPE (OXM_OF_IP_PROTO):
+        field = &ipProto;
+        size = sizeof (ipProto);
+        break;
+      case OXM_TYPE (OXM_OF_IPV4_SRC):
+      case OXM_TYPE (OXM_OF_ARP_SPA):
+        field = nwSrc;
+        size = sizeof (nwSrc);
+        break;
+      case OXM_TYPE (OXM_OF_IPV4_DST):
+      case OXM_TYPE (OXM_OF_ARP_TPA):
+        field = nwDst;
+        size = sizeof (nwDst);
+        break;
+      case OXM_TYPE (OXM_OF_TCP_SRC):
+      case OXM_TYPE (OXM_OF_UDP_SRC):
+      case OXM_TYPE (OXM_OF_SCTP_SRC):
+        field = &l4Src;
+        size = sizeof (l4Src);
+        break;
+      case OXM_TYPE (OXM_OF_TCP_DST):
+      case OXM_TYPE (OXM_OF_UDP_DST):
+      case OXM_TYPE (OXM_OF_SCTP_DST):
+        field = &l4Dst;
+        size = sizeof (l4Dst);
+        break;
+      case OXM_TYPE (OXM_OF_ICMPV4_TYPE):
+      case OXM_TYPE (OXM_OF_ICMPV6_TYPE):
+        field = &icmpType;
+        size = sizeof (icmpType);
+        break;
+      case OXM_TYPE (OXM_OF_ICMPV4_CODE):
+      case OXM_TYPE (OXM_OF_ICMPV6_CODE):
+        field = &icmpCode;
+        size = sizeof (icmpCode);
+        break;
+      case OXM_TYPE (OXM_OF_ARP_OP):
+        field = &arpOp;
+        size = sizeof (arpOp);
+        break;
+      case OXM_TYPE (OXM_OF_ARP_SHA):
+        field = arpSha;
+        size = sizeof (arpSha);
+        break;
+      case OXM_TYPE (OXM_OF_ARP_THA):
+        field = arpTha;
+        size = sizeof (arpTha);
+        break;
+      case OXM_TYPE (OXM_OF_IPV6_SRC):
+        field = ipv6Src;
+        size = sizeof (ipv6Src);
+        break;
+      case OXM_TYPE (OXM_OF_IPV6_DST):
+        field = ipv6Dst;
+        size = sizeof (ipv6Dst);
+        break;
+      case OXM_TYPE (OXM_OF_IPV6_FLABEL):
+        field = &ipv6Flabel;
+        size = sizeof (ipv6Flabel);
+        break;
+      case OXM_TYPE (OXM_OF_MPLS_LABEL):
+        field = &mplsLabel;
+        size = sizeof (mplsLabel);
+        break;
+      case OXM_TYPE (OXM_OF_MPLS_TC):
+        field = &mplsTc;
+        size = sizeof (mplsTc);
+        break;
+      case OXM_TYPE (OXM_OF_MPLS_BOS):
+        field = &mplsBos;
+        size = sizeof (mplsBos);
+        break;
+      }
+    if (!field || !SetFieldValue (this, field, size, tlv, mask))
+      {
+        NS_LOG_DEBUG ("Unsupported match field " << tlv->header);
+        ok = false;
+        continue;
+      }
+
+    // Fields shared by different protocols (like the transport ports) are
+    // told apart by the protocol layer.
+    uint32_t layer = GetFieldLayer (tlv->header);
+    layers |= layer;
+    if (mask)
+      {
+        mask->layers |= layer;
+      }
+  }
+  return ok;
+}
+
+size_t
+OFSwitch13FlowKey::Hash (void) const
+{
+  // 64-bit FNV-1a over words, followed by a final avalanche step.
+  const uint64_t *words = GetWords ();
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < OFS_FLOW_KEY_WORDS; i++)
+    {
+      hash ^= words [i];
+      hash *= 0x100000001b3ULL;
+    }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return static_cast<size_t> (hash);
+}
+
+const uint64_t*
+OFSwitch13FlowKey::GetWords (void) const
+{
+  return reinterpret_cast<const uint64_t*> (this);
+}
+
+size_t
+OFSwitch13FlowKey::Hasher::operator() (const OFSwitch13FlowKey &key) const
+{
+  return key.Hash ();
+}
+
+bool
+operator == (const OFSwitch13FlowKey &a, const OFSwitch13FlowKey &b)
+{
+  return memcmp (&a, &b, sizeof (OFSwitch13FlowKey)) == 0;
+}
+
+} // namespace ns3
@@ -0,0 +1,195 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+#ifndef OFSWITCH13_FLOW_KEY_H
+#define OFSWITCH13_FLOW_KEY_H
+
+#include <ns3/packet.h>
+
+struct ofl_match;
+
+namespace ns3 {
+
+/**
+ * \ingroup ofswitch13
+ * Fixed-layout packet flow key holding the header fields that can be matched
+ * by OpenFlow 1.3 flow entries. The key is parsed directly from the packet
+ * bytes once per packet, and is used by the datapath flow cache to identify
+ * packets belonging to the same flow, and by the flow table classifiers to
+ * match the packet without building the ofsoftswitch13 packet structures.
+ *
+ * Integer fields are saved in host byte order, while addresses are saved in
+ * network byte order, following the representation used by the OXM TLVs of
+ * the ofsoftswitch13 library. Header fields from absent protocol layers are
+ * left zeroed, and the layers bitmap indicates which protocol layers were
+ * found in the packet. The key is padded to a multiple of 64 bits, so it can
+ * be hashed and compared as an array of words.
+ *
+ * The same structure is also used as a bitwise mask over the key fields, to
+ * identify which header bits were consulted by the OpenFlow pipeline while
+ * processing a packet (see the megaflow layer in OFSwitch13FlowCache).
+ */
+struct OFSwitch13FlowKey
+{
+public:
+  /** Protocol layers found in the packet. */
+  enum Layer
+  {
+    LAYER_VLAN   = (1 << 0),  //!< IEEE 802.1Q tag.
+    LAYER_MPLS   = (1 << 1),  //!< MPLS label stack.
+    LAYER_IP     = (1 << 2),  //!< IPv4 or IPv6 header.
+    LAYER_IPV4   = (1 << 3),  //!< IPv4 header.
+    LAYER_IPV6   = (1 << 4),  //!< IPv6 header.
+    LAYER_ARP    = (1 << 5),  //!< ARP header.
+    LAYER_TCP    = (1 << 6),  //!< TCP header.
+    LAYER_UDP    = (1 << 7),  //!< UDP header.
+    LAYER_SCTP   = (1 << 8),  //!< SCTP header.
+    LAYER_ICMPV4 = (1 << 9),  //!< ICMPv4 header.
+    LAYER_ICMPV6 = (1 << 10)  //!< ICMPv6 header.
+  };
+
+  /** Number of packet bytes inspected when parsing the headers. */
+  static const uint32_t MAX_HEADER_BYTES = 128;
+
+  OFSwitch13FlowKey ();  //!< Default constructor (zeroed key).
+
+  /**
+   * Parse the packet headers and fill the key fields.
+   * \param packet The ns-3 packet (including the Ethernet header).
+   * \param inPort The switch input port number.
+   * \param tunnelId The metadata associated with a logical port.
+   * \return true if the packet headers were successfully parsed, false when
+   *         the packet carries headers that can't be represented by this key
+   *         (in this case, the key must not be used).
+   */
+  bool Extract (Ptr<const Packet> packet, uint32_t inPort, uint64_t tunnelId);
+
+  /**
+   * Parse the packet headers and fill the key fields.
+   * \param data The packet bytes (starting at the Ethernet header).
+   * \param size The number of available bytes.
+   * \param inPort The switch input port number.
+   * \param tunnelId The metadata associated with a logical port.
+   * \return true if the packet headers were successfully parsed.
+   */
+  bool Extract (const uint8_t *data, uint32_t size, uint32_t inPort,
+                uint64_t tunnelId);
+
+  /**
+   * Apply a bitwise mask over this key, clearing all bits not set in mask.
+   * \param mask The mask key.
+   */
+  void ApplyMask (const OFSwitch13FlowKey &mask);
+
+  /**
+   * Use this key as a mask and set the bits of all header fields matched by
+   * the OXM match structure. Masked address fields only set the masked bits,
+   * while other masked fields are fully set (conservative approach). Fields
+   * that are never present in packets with a valid key are ignored, and so
+   * are the metadata fields (they are derived from previous tables).
+   * \param match The OXM match structure from a flow entry.
+   * \return false if the match has fields that can't be represented by this
+   *         mask (in this case, the mask must not be used).
+   */
+  bool AddMatchMask (const struct ofl_match *match);
+
+  /**
+   * Set the key fields to the values of the OXM match structure. When a mask
+   * is given, the bits of all header fields in the match are set in the mask
+   * (only the masked bits for masked fields, so the mask is exact) and the
+   * key values are saved already masked. Otherwise, the match is taken as the
+   * header fields parsed from a packet. Fields not in the match are left
+   * zeroed. The layers bitmap holds the protocol layers of the fields in the
+   * match (also set in the mask), so a masked key comparison only succeeds
+   * for packets carrying these layers, just like the library match function.
+   * \param match The OXM match structure.
+   * \param mask The mask key (may be 0).
+   * \return false if the match has fields that can't be represented by this
+   *         key (the other fields are set anyway).
+   */
+  bool SetMatch (const struct ofl_match *match, OFSwitch13FlowKey *mask);
+
+  /**
+   * Compute the hash value for this key.
+   * \return The hash value.
+   */
+  size_t Hash (void) const;
+
+  /**
+   * Get the key as an array of 64-bit words.
+   * \return The pointer to the first word.
+   */
+  const uint64_t* GetWords (void) const;
+
+  /** Hash function object for using the key with unordered containers. */
+  struct Hasher
+  {
+    /**
+     * Compute the hash value for this key.
+     * \param key The flow key.
+     * \return The hash value.
+     */
+    size_t operator() (const OFSwitch13FlowKey &key) const;
+  };
+
+  uint64_t  tunnelId;     //!< Logical port tunnel ID.
+  uint64_t  metadata;     //!< Pipeline metadata.
+  uint32_t  inPort;       //!< Switch input port.
+  uint32_t  layers;       //!< Bitmap of protocol layers found in packet.
+  uint8_t   ethDst [6];   //!< Ethernet destination address.
+  uint8_t   ethSrc [6];   //!< Ethernet source address.
+  uint16_t  ethType;      //!< Ethernet type (after VLAN tags).
+  uint16_t  vlanVid;      //!< VLAN ID with OFPVID_PRESENT bit (or OFPVID_NONE).
+  uint8_t   vlanPcp;      //!< VLAN priority.
+  uint8_t   ipProto;      //!< IP protocol (or IPv6 next header).
+  uint8_t   ipDscp;       //!< IP DSCP (6 bits).
+  uint8_t   ipEcn;        //!< IP ECN (2 bits).
+  uint8_t   icmpType;     //!< ICMPv4 or ICMPv6 type.
+  uint8_t   icmpCode;     //!< ICMPv4 or ICMPv6 code.
+  uint16_t  arpOp;        //!< ARP opcode.
+  uint32_t  mplsLabel;    //!< MPLS label (top of stack).
+  uint8_t   mplsTc;       //!< MPLS traffic class (top of stack).
+  uint8_t   mplsBos;      //!< MPLS bottom of stack bit (top of stack).
+  uint16_t  l4Src;        //!< TCP, UDP, or SCTP source port.
+  uint16_t  l4Dst;        //!< TCP, UDP, or SCTP destination port.
+  uint16_t  pad0;         //!< Padding (always zero).
+  uint32_t  ipv6Flabel;   //!< IPv6 flow label (20 bits).
+  uint8_t   nwSrc [4];    //!< IPv4 source address or ARP SPA.
+  uint8_t   nwDst [4];    //!< IPv4 destination address or ARP TPA.
+  uint8_t   arpSha [6];   //!< ARP source hardware address.
+  uint8_t   arpTha [6];   //!< ARP target hardware address.
+  uint8_t   pad1 [4];     //!< Padding (always zero).
+  uint8_t   ipv6Src [16]; //!< IPv6 source address.
+  uint8_t   ipv6Dst [16]; //!< IPv6 destination address.
+};
+
+/** Number of 64-bit words in the flow key. */
+#define OFS_FLOW_KEY_WORDS (sizeof (OFSwitch13FlowKey) / sizeof (uint64_t))
+
+/**
+ * Compare two flow keys for equality.
+ * \param a The first key.
+ * \param b The second key.
+ * \return true if both keys are equal.
+ */
+bool operator == (const OFSwitch13FlowKey &a, const OFSwitch13FlowKey &b);
+
+} // namespace ns3
+#endif /* OFSWITCH13_FLOW_KEY_H */
@@ -21,6 +21,7 @@
 #include "ofswitch13-interface.h"
 #include "ofswitch13-device.h"
 #include "ofswitch13-controller.h"
+#include "raw-header.h"
 
 NS_LOG_COMPONENT_DEFINE ("OFSwitch13Interface");
 
@@ -85,16 +86,14 @@ PacketFromMsg (struct ofl_msg_header *msg, uint32_t xid)
   uint8_t *buf;
   size_t buf_size;
   Ptr<Packet> packet;
-  struct ofpbuf *buffer;
 
-  buffer = ofpbuf_new (0);
+  // The packed message is copied straight into the ns-3 packet, without
+  // wrapping it into an intermediate ofpbuf structure.
   error = ofl_msg_pack (msg, xid, &buf, &buf_size, 0);
   if (!error)
     {
-      ofpbuf_use (buffer, buf, buf_size);
-      ofpbuf_put_uninit (buffer, buf_size);
-      packet = Create<Packet> ((uint8_t*)buffer->data, buffer->size);
-      ofpbuf_delete (buffer);
+      packet = Create<Packet> (buf, buf_size);
+      free (buf);
     }
   return packet;
 }
@@ -107,6 +106,53 @@ PacketFromBuffer (struct ofpbuf *buffer)
   return Create<Packet> ((uint8_t*)buffer->data, buffer->size);
 }
 
+Ptr<Packet>
+PacketFromBuffer (Ptr<const Packet> packet, struct ofpbuf *buffer)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  // Number of leading bytes replaced in the original packet. It must cover
+  // all headers that can be modified by OpenFlow actions. Some bytes after
+  // this region are compared to check that the payload was not changed. For
+  // small packets, we replace everything but the last few bytes, so byte tags
+  // are not lost.
+  static const uint32_t headBytes = 192;
+  static const uint32_t checkBytes = 32;
+  static const uint32_t minCheckBytes = 4;
+
+  uint32_t origSize = packet->GetSize ();
+  if (origSize <= minCheckBytes)
+    {
+      return 0;
+    }
+  uint32_t headSize = std::min (headBytes, origSize - minCheckBytes);
+  uint32_t checkSize = std::min (checkBytes, origSize - headSize);
+  int32_t delta = static_cast<int32_t> (buffer->size) -
+    static_cast<int32_t> (origSize);
+  if (static_cast<int32_t> (headSize) + delta < 0
+      || headSize + delta > RawHeader::MAX_SIZE)
+    {
+      return 0;
+    }
+
+  uint8_t origData [headBytes + checkBytes];
+  packet->CopyData (origData, headSize + checkSize);
+  const uint8_t *newData = (const uint8_t*)buffer->data;
+  if (memcmp (origData + headSize, newData + headSize + delta, checkSize))
+    {
+      NS_LOG_WARN ("Packet modified beyond the header bytes.");
+      return 0;
+    }
+
+  // Replace the leading bytes, keeping all tags. The packet buffer is copied
+  // by ns-3 when adding the header, as it's shared with the original packet.
+  Ptr<Packet> newPacket = packet->Copy ();
+  newPacket->RemoveAtStart (headSize);
+  RawHeader header (newData, headSize + delta);
+  newPacket->AddHeader (header);
+  return newPacket;
+}
+
 } // namespace ofs
 } // namespace ns3
 
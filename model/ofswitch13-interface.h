@@ -54,6 +54,7 @@ extern "C"
 #include "udatapath/dp_actions.h"
 #include "udatapath/dp_buffers.h"
 #include "udatapath/dp_control.h"
+#include "udatapath/dp_exp.h"
 #include "udatapath/dp_ports.h"
 #include "udatapath/flow_table.h"
 #include "udatapath/flow_entry.h"
@@ -72,6 +73,8 @@ extern "C"
 #include "oflib/ofl-structs.h"
 #include "oflib/oxm-match.h"
 
+#include "lib/hash.h"
+#include "lib/hmap.h"
 #include "lib/ofpbuf.h"
 #include "lib/timeval.h"
 #include "lib/vlog.h"
@@ -152,6 +155,23 @@ Ptr<Packet> PacketFromMsg (struct ofl_msg_header *msg, uint32_t xid = 0);
  */
 Ptr<Packet> PacketFromBuffer (struct ofpbuf *buffer);
 
+/**
+ * \ingroup ofswitch13
+ * Create a new ns3::Packet from the original ns3::Packet and the internal
+ * ofsoftswitch13 buffer holding a modified copy of it. As OpenFlow actions
+ * only modify packet headers, the leading header bytes of a copy of the
+ * original packet are replaced by the ones from the buffer, keeping all tags
+ * and packet metadata (so they don't have to be copied one by one). Note that
+ * ns-3 still copies the entire packet buffer when the new header bytes are
+ * added, as this buffer is shared with the original packet.
+ * \param packet The original ns-3 packet.
+ * \param buffer The internal buffer with the modified packet.
+ * \return The ns3::Packet created, or 0 when the modified bytes can't be
+ *         confined to the leading header bytes (in this case, the entire
+ *         packet must be created from the buffer).
+ */
+Ptr<Packet> PacketFromBuffer (Ptr<const Packet> packet, struct ofpbuf *buffer);
+
 } // namespace ofs
 } // namespace ns3
 #endif /* OFSWITCH13_INTERFACE_H */
@@ -0,0 +1,200 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+
+#include <cmath>
+#include <ns3/log.h>
+#include "ofswitch13-pipeline-delay-model.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("OFSwitch13PipelineDelayModel");
+NS_OBJECT_ENSURE_REGISTERED (OFSwitch13PipelineDelayModel);
+NS_OBJECT_ENSURE_REGISTERED (OFSwitch13TcamDelayModel);
+NS_OBJECT_ENSURE_REGISTERED (OFSwitch13HashDelayModel);
+NS_OBJECT_ENSURE_REGISTERED (OFSwitch13SoftwareDelayModel);
+NS_OBJECT_ENSURE_REGISTERED (OFSwitch13CallbackDelayModel);
+
+TypeId
+OFSwitch13PipelineDelayModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::OFSwitch13PipelineDelayModel")
+    .SetParent<Object> ()
+    .SetGroupName ("OFSwitch13")
+  ;
+  return tid;
+}
+
+OFSwitch13PipelineDelayModel::OFSwitch13PipelineDelayModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+OFSwitch13PipelineDelayModel::~OFSwitch13PipelineDelayModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+/********** OFSwitch13TcamDelayModel **********/
+TypeId
+OFSwitch13TcamDelayModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::OFSwitch13TcamDelayModel")
+    .SetParent<OFSwitch13PipelineDelayModel> ()
+    .SetGroupName ("OFSwitch13")
+    .AddConstructor<OFSwitch13TcamDelayModel> ()
+    .AddAttribute ("Delay",
+                   "The time to perform a TCAM lookup.",
+                   TimeValue (MicroSeconds (20)),
+                   MakeTimeAccessor (&OFSwitch13TcamDelayModel::m_delay),
+                   MakeTimeChecker (Time (0)))
+  ;
+  return tid;
+}
+
+OFSwitch13TcamDelayModel::OFSwitch13TcamDelayModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+OFSwitch13TcamDelayModel::~OFSwitch13TcamDelayModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+Time
+OFSwitch13TcamDelayModel::GetDelay (uint8_t tableId, uint32_t nEntries,
+                                    uint32_t maxEntries) const
+{
+  return m_delay;
+}
+
+/********** OFSwitch13HashDelayModel **********/
+TypeId
+OFSwitch13HashDelayModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::OFSwitch13HashDelayModel")
+    .SetParent<OFSwitch13PipelineDelayModel> ()
+    .SetGroupName ("OFSwitch13")
+    .AddConstructor<OFSwitch13HashDelayModel> ()
+    .AddAttribute ("AccessDelay",
+                   "The time to perform a single SRAM memory access.",
+                   TimeValue (NanoSeconds (100)),
+                   MakeTimeAccessor (&OFSwitch13HashDelayModel::m_accessDelay),
+                   MakeTimeChecker (Time (0)))
+  ;
+  return tid;
+}
+
+OFSwitch13HashDelayModel::OFSwitch13HashDelayModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+OFSwitch13HashDelayModel::~OFSwitch13HashDelayModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+Time
+OFSwitch13HashDelayModel::GetDelay (uint8_t tableId, uint32_t nEntries,
+                                    uint32_t maxEntries) const
+{
+  double load = maxEntries ? static_cast<double> (nEntries) / maxEntries : 0;
+  return m_accessDelay * (1 + load / 2);
+}
+
+/********** OFSwitch13SoftwareDelayModel **********/
+TypeId
+OFSwitch13SoftwareDelayModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::OFSwitch13SoftwareDelayModel")
+    .SetParent<OFSwitch13PipelineDelayModel> ()
+    .SetGroupName ("OFSwitch13")
+    .AddConstructor<OFSwitch13SoftwareDelayModel> ()
+    .AddAttribute ("StepDelay",
+                   "The time to perform a single lookup step.",
+                   TimeValue (MicroSeconds (20)),
+                   MakeTimeAccessor (&OFSwitch13SoftwareDelayModel::m_stepDelay),
+                   MakeTimeChecker (Time (0)))
+  ;
+  return tid;
+}
+
+OFSwitch13SoftwareDelayModel::OFSwitch13SoftwareDelayModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+OFSwitch13SoftwareDelayModel::~OFSwitch13SoftwareDelayModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+Time
+OFSwitch13SoftwareDelayModel::GetDelay (uint8_t tableId, uint32_t nEntries,
+                                        uint32_t maxEntries) const
+{
+  return nEntries < 2U ? m_stepDelay :
+         m_stepDelay * (int64_t)ceil (log2 (nEntries));
+}
+
+/********** OFSwitch13CallbackDelayModel **********/
+TypeId
+OFSwitch13CallbackDelayModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::OFSwitch13CallbackDelayModel")
+    .SetParent<OFSwitch13PipelineDelayModel> ()
+    .SetGroupName ("OFSwitch13")
+    .AddConstructor<OFSwitch13CallbackDelayModel> ()
+  ;
+  return tid;
+}
+
+OFSwitch13CallbackDelayModel::OFSwitch13CallbackDelayModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+OFSwitch13CallbackDelayModel::~OFSwitch13CallbackDelayModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+OFSwitch13CallbackDelayModel::SetDelayCallback (DelayCallback cb)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_delayCb = cb;
+}
+
+Time
+OFSwitch13CallbackDelayModel::GetDelay (uint8_t tableId, uint32_t nEntries,
+                                        uint32_t maxEntries) const
+{
+  if (m_delayCb.IsNull ())
+    {
+      return Time (0);
+    }
+  return m_delayCb (tableId, nEntries, maxEntries);
+}
+
+} // namespace ns3
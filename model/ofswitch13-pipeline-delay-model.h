@@ -0,0 +1,188 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+
+#ifndef OFSWITCH13_PIPELINE_DELAY_MODEL_H
+#define OFSWITCH13_PIPELINE_DELAY_MODEL_H
+
+#include <ns3/callback.h>
+#include <ns3/nstime.h>
+#include <ns3/object.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup ofswitch13
+ *
+ * Base class for the lookup delay model of an OpenFlow flow table. The model
+ * is configured per table in the OFSwitch13Device and evaluated for each
+ * packet on every flow table actually visited by the packet, so the total
+ * pipeline delay reflects the lookup latency of multi-table pipelines.
+ */
+class OFSwitch13PipelineDelayModel : public Object
+{
+public:
+  /**
+   * Register this type.
+   * \return The object TypeId.
+   */
+  static TypeId GetTypeId (void);
+
+  OFSwitch13PipelineDelayModel ();          //!< Default constructor.
+  virtual ~OFSwitch13PipelineDelayModel (); //!< Dummy destructor.
+
+  /**
+   * Get the time to perform a lookup on the flow table.
+   * \param tableId The flow table ID.
+   * \param nEntries The current number of entries in the flow table.
+   * \param maxEntries The maximum number of entries in the flow table.
+   * \return The lookup delay.
+   */
+  virtual Time GetDelay (uint8_t tableId, uint32_t nEntries,
+                         uint32_t maxEntries) const = 0;
+};
+
+
+/**
+ * \ingroup ofswitch13
+ *
+ * Lookup delay model for a flow table implemented on TCAM hardware. All the
+ * entries are searched in parallel, so the lookup delay is constant,
+ * regardless of the number of entries in the table.
+ */
+class OFSwitch13TcamDelayModel : public OFSwitch13PipelineDelayModel
+{
+public:
+  /**
+   * Register this type.
+   * \return The object TypeId.
+   */
+  static TypeId GetTypeId (void);
+
+  OFSwitch13TcamDelayModel ();          //!< Default constructor.
+  virtual ~OFSwitch13TcamDelayModel (); //!< Dummy destructor.
+
+  // Inherited from OFSwitch13PipelineDelayModel.
+  Time GetDelay (uint8_t tableId, uint32_t nEntries,
+                 uint32_t maxEntries) const;
+
+private:
+  Time m_delay;   //!< The TCAM lookup delay.
+};
+
+
+/**
+ * \ingroup ofswitch13
+ *
+ * Lookup delay model for an exact-match flow table implemented as a hash
+ * table on SRAM memory. The lookup delay is given by the memory access delay
+ * times the expected number of memory accesses for a successful search on a
+ * chained hash table with as many buckets as the maximum number of entries in
+ * the flow table (1 + a/2, where a is the table load factor).
+ */
+class OFSwitch13HashDelayModel : public OFSwitch13PipelineDelayModel
+{
+public:
+  /**
+   * Register this type.
+   * \return The object TypeId.
+   */
+  static TypeId GetTypeId (void);
+
+  OFSwitch13HashDelayModel ();          //!< Default constructor.
+  virtual ~OFSwitch13HashDelayModel (); //!< Dummy destructor.
+
+  // Inherited from OFSwitch13PipelineDelayModel.
+  Time GetDelay (uint8_t tableId, uint32_t nEntries,
+                 uint32_t maxEntries) const;
+
+private:
+  Time m_accessDelay;   //!< The SRAM memory access delay.
+};
+
+
+/**
+ * \ingroup ofswitch13
+ *
+ * Lookup delay model for a flow table implemented in software. The lookup
+ * delay is estimated as k * log (n), where 'k' is the time for a single
+ * lookup step, and 'n' is the current number of entries in the table. This is
+ * the same estimation used by the OFSwitch13Device when no delay model is
+ * configured, but here it's applied to each visited table.
+ */
+class OFSwitch13SoftwareDelayModel : public OFSwitch13PipelineDelayModel
+{
+public:
+  /**
+   * Register this type.
+   * \return The object TypeId.
+   */
+  static TypeId GetTypeId (void);
+
+  OFSwitch13SoftwareDelayModel ();          //!< Default constructor.
+  virtual ~OFSwitch13SoftwareDelayModel (); //!< Dummy destructor.
+
+  // Inherited from OFSwitch13PipelineDelayModel.
+  Time GetDelay (uint8_t tableId, uint32_t nEntries,
+                 uint32_t maxEntries) const;
+
+private:
+  Time m_stepDelay;   //!< The time for a single lookup step.
+};
+
+
+/**
+ * \ingroup ofswitch13
+ *
+ * User-defined lookup delay model. The lookup delay is given by a callback
+ * function invoked with the same arguments of the GetDelay () method. When no
+ * callback is set, the lookup delay is zero.
+ */
+class OFSwitch13CallbackDelayModel : public OFSwitch13PipelineDelayModel
+{
+public:
+  /**
+   * Register this type.
+   * \return The object TypeId.
+   */
+  static TypeId GetTypeId (void);
+
+  OFSwitch13CallbackDelayModel ();          //!< Default constructor.
+  virtual ~OFSwitch13CallbackDelayModel (); //!< Dummy destructor.
+
+  /** Callback signature for the user-defined lookup delay. */
+  typedef Callback<Time, uint8_t, uint32_t, uint32_t> DelayCallback;
+
+  /**
+   * Set the callback used to compute the lookup delay.
+   * \param cb The callback.
+   */
+  void SetDelayCallback (DelayCallback cb);
+
+  // Inherited from OFSwitch13PipelineDelayModel.
+  Time GetDelay (uint8_t tableId, uint32_t nEntries,
+                 uint32_t maxEntries) const;
+
+private:
+  DelayCallback m_delayCb;  //!< The user-defined delay callback.
+};
+
+} // namespace ns3
+#endif /* OFSWITCH13_PIPELINE_DELAY_MODEL_H */
@@ -0,0 +1,224 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+
+#include "ofswitch13-timer-wheel.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("OFSwitch13TimerWheel");
+
+OFSwitch13TimerWheel::OFSwitch13TimerWheel ()
+  : m_next (0),
+  m_nItems (0),
+  m_lastId (0)
+{
+  NS_LOG_FUNCTION (this);
+
+  Clear (0);
+}
+
+void
+OFSwitch13TimerWheel::Schedule (struct flow_entry *entry, uint64_t deadline)
+{
+  NS_LOG_FUNCTION (this << entry << deadline);
+
+  Item item = {entry, std::max (deadline, m_next), ++m_lastId};
+  Insert (item);
+  m_nItems++;
+  m_ids [entry] = item.id;
+}
+
+void
+OFSwitch13TimerWheel::Cancel (struct flow_entry *entry)
+{
+  NS_LOG_FUNCTION (this << entry);
+
+  if (m_ids.erase (entry) && m_nItems > 2 * m_ids.size () + N_SLOTS)
+    {
+      Compact ();
+    }
+}
+
+void
+OFSwitch13TimerWheel::Advance (uint64_t now, EntryList_t &expired)
+{
+  NS_LOG_FUNCTION (this << now);
+
+  // When the wheel is empty there is nothing to cascade, so just jump ahead
+  // (dropping any remaining tombstones).
+  if (m_ids.empty ())
+    {
+      if (m_nItems)
+        {
+          Clear (m_next);
+        }
+      m_next = std::max (m_next, now + 1);
+      return;
+    }
+
+  while (m_next <= now)
+    {
+      // Cascade upper levels every time a lower level completes a full turn.
+      uint32_t index = m_next & (N_SLOTS - 1);
+      for (uint32_t level = 1; index == 0 && level < N_LEVELS; level++)
+        {
+          index = Cascade (level, (m_next >> (level * SLOT_BITS))
+                           & (N_SLOTS - 1));
+        }
+
+      // Skip the remaining slots of the first level when it is empty.
+      if (m_nLevel [0] == 0)
+        {
+          uint64_t turn = (m_next | (N_SLOTS - 1)) + 1;
+          m_next = std::min (turn, now + 1);
+          continue;
+        }
+
+      ItemList_t &slot = GetSlot (0, m_next & (N_SLOTS - 1));
+      for (auto const &item : slot)
+        {
+          if (IsLive (item))
+            {
+              expired.push_back (item.entry);
+              m_ids.erase (item.entry);
+            }
+        }
+      m_nLevel [0] -= slot.size ();
+      m_nItems -= slot.size ();
+      slot.clear ();
+      m_next++;
+    }
+}
+
+void
+OFSwitch13TimerWheel::Clear (uint64_t now)
+{
+  NS_LOG_FUNCTION (this << now);
+
+  for (auto &slot : m_slots)
+    {
+      slot.clear ();
+    }
+  for (uint32_t level = 0; level < N_LEVELS; level++)
+    {
+      m_nLevel [level] = 0;
+    }
+  m_nItems = 0;
+  m_ids.clear ();
+  m_next = now;
+}
+
+uint32_t
+OFSwitch13TimerWheel::GetNEntries (void) const
+{
+  return m_ids.size ();
+}
+
+void
+OFSwitch13TimerWheel::Insert (const Item &item)
+{
+  // Select the level based on the distance to the deadline, and the slot in
+  // that level based on the deadline bits for that level. Deadlines beyond
+  // the wheel range are saved in the last slot reachable in the top level,
+  // and will be inserted again when cascaded.
+  uint64_t delta = item.deadline - m_next;
+  uint32_t level = 0;
+  while (level + 1 < N_LEVELS
+         && delta >= (static_cast<uint64_t> (1) << ((level + 1) * SLOT_BITS)))
+    {
+      level++;
+    }
+
+  uint64_t deadline = item.deadline;
+  uint64_t range = static_cast<uint64_t> (1) << (N_LEVELS * SLOT_BITS);
+  if (delta >= range)
+    {
+      deadline = m_next + range - 1;
+    }
+  uint32_t index = (deadline >> (level * SLOT_BITS)) & (N_SLOTS - 1);
+  if (m_slots.empty ())
+    {
+      m_slots.resize (N_LEVELS * N_SLOTS);
+    }
+  GetSlot (level, index).push_back (item);
+  m_nLevel [level]++;
+}
+
+OFSwitch13TimerWheel::ItemList_t&
+OFSwitch13TimerWheel::GetSlot (uint32_t level, uint32_t index)
+{
+  return m_slots [level * N_SLOTS + index];
+}
+
+uint32_t
+OFSwitch13TimerWheel::Cascade (uint32_t level, uint32_t index)
+{
+  ItemList_t items;
+  items.swap (GetSlot (level, index));
+  m_nLevel [level] -= items.size ();
+  for (auto const &item : items)
+    {
+      if (IsLive (item))
+        {
+          Insert (item);
+        }
+      else
+        {
+          m_nItems--;
+        }
+    }
+  return index;
+}
+
+bool
+OFSwitch13TimerWheel::IsLive (const Item &item) const
+{
+  auto it = m_ids.find (item.entry);
+  return it != m_ids.end () && it->second == item.id;
+}
+
+void
+OFSwitch13TimerWheel::Compact (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  for (uint32_t level = 0; level < N_LEVELS; level++)
+    {
+      m_nLevel [level] = 0;
+      for (uint32_t index = 0; index < N_SLOTS; index++)
+        {
+          ItemList_t &slot = GetSlot (level, index);
+          size_t live = 0;
+          for (size_t i = 0; i < slot.size (); i++)
+            {
+              if (IsLive (slot [i]))
+                {
+                  slot [live++] = slot [i];
+                }
+            }
+          slot.resize (live);
+          m_nLevel [level] += live;
+        }
+    }
+  m_nItems = m_ids.size ();
+}
+
+} // namespace ns3
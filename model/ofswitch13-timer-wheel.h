@@ -0,0 +1,158 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+
+#ifndef OFSWITCH13_TIMER_WHEEL_H
+#define OFSWITCH13_TIMER_WHEEL_H
+
+#include <unordered_map>
+#include <vector>
+#include "ofswitch13-interface.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup ofswitch13
+ *
+ * Hierarchical timing wheel for flow entry expirations. Each flow entry with
+ * idle or hard timeout is registered with the time (in milliseconds, as
+ * returned by time_msec ()) at which it should be checked for expiration.
+ * The wheel has four levels of 256 slots each: the first one has a 1 ms
+ * resolution, and each upper level covers the full range of the level below
+ * it. Entries in upper levels are cascaded down as time advances, so the cost
+ * of advancing the wheel is proportional to the elapsed time and to the
+ * number of entries due, not to the total number of registered entries.
+ *
+ * The wheel never dereferences the saved entry pointers. It is up to the
+ * caller to cancel entries before the library frees them (see
+ * OFSwitch13Device::FlowTimersExpire ()). Cancelled entries are left in their
+ * slots as tombstones (each scheduling has an unique ID, so the same pointer
+ * can be reused by a new entry) and are skipped when the wheel advances. The
+ * wheel is compacted when tombstones outnumber the scheduled entries.
+ */
+class OFSwitch13TimerWheel
+{
+public:
+  /** Structure to save a list of flow entries. */
+  typedef std::vector<struct flow_entry*> EntryList_t;
+
+  OFSwitch13TimerWheel ();  //!< Default constructor.
+
+  /**
+   * Register a flow entry to be returned when the wheel is advanced up to
+   * this deadline. Deadlines in the past are handled in the next advance. A
+   * previous deadline for the same entry is cancelled.
+   * \param entry The flow entry.
+   * \param deadline The deadline (in milliseconds).
+   */
+  void Schedule (struct flow_entry *entry, uint64_t deadline);
+
+  /**
+   * Cancel the deadline of a flow entry. This must be called before the
+   * library frees a flow entry registered into the wheel.
+   * \param entry The flow entry (entries not in the wheel are ignored).
+   */
+  void Cancel (struct flow_entry *entry);
+
+  /**
+   * Advance the wheel up to this time, collecting all entries with deadlines
+   * not later than it. Collected entries are removed from the wheel.
+   * \param now The current time (in milliseconds).
+   * \param expired The list to append the collected entries.
+   */
+  void Advance (uint64_t now, EntryList_t &expired);
+
+  /**
+   * Remove all entries from the wheel.
+   * \param now The current time (in milliseconds).
+   */
+  void Clear (uint64_t now);
+
+  /**
+   * Get the number of entries in the wheel.
+   * \return The number of entries.
+   */
+  uint32_t GetNEntries (void) const;
+
+private:
+  /** Flow entry saved into a wheel slot. */
+  struct Item
+  {
+    struct flow_entry*  entry;    //!< The flow entry.
+    uint64_t            deadline; //!< The deadline.
+    uint64_t            id;       //!< The scheduling ID.
+  };
+
+  /** Structure to save the items in a wheel slot. */
+  typedef std::vector<Item> ItemList_t;
+
+  static const uint32_t N_LEVELS = 4;   //!< Number of wheel levels.
+  static const uint32_t SLOT_BITS = 8;  //!< Bits for slot index.
+  static const uint32_t N_SLOTS = (1 << SLOT_BITS); //!< Slots per level.
+
+  /**
+   * Insert the item into the proper slot, based on its deadline.
+   * \param item The item.
+   */
+  void Insert (const Item &item);
+
+  /**
+   * Move all items in this slot to lower levels.
+   * \param level The wheel level.
+   * \param index The slot index.
+   * \return The slot index.
+   */
+  uint32_t Cascade (uint32_t level, uint32_t index);
+
+  /**
+   * Get the wheel slot at this level and index.
+   * \param level The wheel level.
+   * \param index The slot index.
+   * \return The wheel slot.
+   */
+  ItemList_t& GetSlot (uint32_t level, uint32_t index);
+
+  /**
+   * Check if the item is a live scheduling (not a tombstone).
+   * \param item The item.
+   * \return true for live items.
+   */
+  bool IsLive (const Item &item) const;
+
+  /** Remove all tombstones from the wheel slots. */
+  void Compact (void);
+
+  /**
+   * Wheel slots, indexed by level and slot index. Slots are only allocated
+   * when the first entry is scheduled, as most switches in large topologies
+   * never have flow entries with timeouts.
+   */
+  std::vector<ItemList_t> m_slots;
+  uint32_t            m_nLevel [N_LEVELS];          //!< Items per level.
+  uint64_t            m_next;       //!< Next time slot to process.
+  uint32_t            m_nItems;     //!< Number of items (with tombstones).
+  uint64_t            m_lastId;     //!< Last scheduling ID.
+
+  /** Scheduling ID of the live item for each entry in the wheel. */
+  std::unordered_map<struct flow_entry*, uint64_t> m_ids;
+}; // Class OFSwitch13TimerWheel
+
+} // namespace ns3
+#endif /* OFSWITCH13_TIMER_WHEEL_H */
@@ -0,0 +1,116 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+#include <cstring>
+#include "raw-header.h"
+#include <ns3/log.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("RawHeader");
+NS_OBJECT_ENSURE_REGISTERED (RawHeader);
+
+RawHeader::RawHeader ()
+  : m_size (0)
+{
+}
+
+RawHeader::RawHeader (const uint8_t *data, uint32_t size)
+{
+  SetData (data, size);
+}
+
+TypeId
+RawHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::RawHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("OFSwitch13")
+    .AddConstructor<RawHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+RawHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+RawHeader::SetData (const uint8_t *data, uint32_t size)
+{
+  NS_ASSERT_MSG (size <= MAX_SIZE, "Header size exceeds the maximum value.");
+  memcpy (m_data, data, size);
+  m_size = size;
+}
+
+const uint8_t*
+RawHeader::GetData (void) const
+{
+  return m_data;
+}
+
+uint32_t
+RawHeader::GetSize (void) const
+{
+  return m_size;
+}
+
+uint32_t
+RawHeader::GetSerializedSize (void) const
+{
+  return m_size;
+}
+
+void
+RawHeader::Serialize (Buffer::Iterator start) const
+{
+  start.Write (m_data, m_size);
+}
+
+uint32_t
+RawHeader::Deserialize (Buffer::Iterator start)
+{
+  // The number of bytes to read must be set in advance.
+  start.Read (m_data, m_size);
+  return m_size;
+}
+
+uint32_t
+RawHeader::Deserialize (Buffer::Iterator start, Buffer::Iterator end)
+{
+  // All bytes in the given range belong to this header.
+  m_size = end.GetDistanceFrom (start);
+  if (m_size > MAX_SIZE)
+    {
+      m_size = MAX_SIZE;
+    }
+  start.Read (m_data, m_size);
+  return m_size;
+}
+
+void
+RawHeader::Print (std::ostream &os) const
+{
+  os << " RawHeader size=" << m_size;
+}
+
+} // namespace ns3
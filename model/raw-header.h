@@ -0,0 +1,84 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+#ifndef RAW_HEADER_H
+#define RAW_HEADER_H
+
+#include <ns3/header.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup ofswitch13
+ * Header holding a raw sequence of bytes. This header is used to replace the
+ * header bytes of a packet modified by the OpenFlow pipeline, keeping the
+ * packet tags and metadata. The number of bytes is not serialized, so it
+ * must be set in advance when deserializing the header from the start
+ * iterator only.
+ */
+class RawHeader : public Header
+{
+public:
+  /** The maximum number of bytes in this header. */
+  static const uint32_t MAX_SIZE = 512;
+
+  /**
+   * Register this type.
+   * \return The object TypeId.
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  RawHeader ();            //!< Default constructor
+
+  /**
+   * Complete constructor.
+   * \param data The header bytes.
+   * \param size The number of header bytes.
+   */
+  RawHeader (const uint8_t *data, uint32_t size);
+
+  /**
+   * Set the header bytes.
+   * \param data The header bytes.
+   * \param size The number of header bytes.
+   */
+  void SetData (const uint8_t *data, uint32_t size);
+
+  /** \return The header bytes. */
+  const uint8_t* GetData (void) const;
+
+  /** \return The number of header bytes. */
+  uint32_t GetSize (void) const;
+
+  // Inherited from Header
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+  virtual uint32_t Deserialize (Buffer::Iterator start, Buffer::Iterator end);
+  virtual uint32_t GetSerializedSize () const;
+  virtual void Print (std::ostream &os) const;
+
+private:
+  uint8_t  m_data [MAX_SIZE]; //!< Header bytes.
+  uint32_t m_size;            //!< Number of header bytes.
+};
+
+} // namespace ns3
+#endif // RAW_HEADER_H
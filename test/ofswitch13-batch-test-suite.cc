@@ -0,0 +1,253 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+#include <map>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/csma-module.h>
+#include <ns3/internet-module.h>
+#include <ns3/applications-module.h>
+#include <ns3/ofswitch13-module.h>
+#include <ns3/test.h>
+
+using namespace ns3;
+
+/**
+ * Compare the time each packet leaves the switch with and without the
+ * ingress batching mode. Two hosts are connected to a single switch, and
+ * host 0 sends UDP packets with sequence numbers to host 1. The TCAM delay
+ * alternates between a high and a low value, so packets received after the
+ * pipeline delay decreases are due before the ones received earlier. With a
+ * zero batch window, the packets must be received at the same times.
+ * Otherwise, each packet may be received up to the batch window in advance.
+ */
+class OFSwitch13BatchTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor.
+   * \param window The ingress batching time window.
+   */
+  OFSwitch13BatchTestCase (Time window);
+
+private:
+  virtual void DoRun (void);
+
+  /** Map packet sequence numbers to receive times. */
+  typedef std::map<uint32_t, Time> RxTimes_t;
+
+  /**
+   * Simulate the network and get the packet receive times.
+   * \param batchSize The ingress batch maximum size.
+   * \param batchWindow The ingress batching time window.
+   * \param rxTimes The packet receive times.
+   * \return The number of batch events.
+   */
+  uint32_t Simulate (uint32_t batchSize, Time batchWindow, RxTimes_t &rxTimes);
+
+  void SendPacket (Ptr<Socket> socket);
+  void ReceivePacket (Ptr<Socket> socket);
+  void NotifyBatch (uint32_t count);
+  void ToggleTcamDelay (Ptr<OFSwitch13Device> device);
+
+  Time        m_window;     //!< Ingress batching time window.
+  uint32_t    m_sent;       //!< Packets sent by host 0.
+  uint32_t    m_batches;    //!< Batch events.
+  bool        m_highDelay;  //!< High TCAM delay is in use.
+  uint32_t    m_packets;    //!< Packets to send.
+  RxTimes_t  *m_rxTimes;    //!< Packet receive times.
+};
+
+OFSwitch13BatchTestCase::OFSwitch13BatchTestCase (Time window)
+  : TestCase ("Ingress batching with " + std::to_string (
+                window.GetMicroSeconds ()) + "us window"),
+  m_window (window),
+  m_sent (0),
+  m_batches (0),
+  m_highDelay (false),
+  m_packets (2000),
+  m_rxTimes (0)
+{
+}
+
+void
+OFSwitch13BatchTestCase::DoRun (void)
+{
+  GlobalValue::Bind ("ChecksumEnabled", BooleanValue (true));
+
+  RxTimes_t single;
+  RxTimes_t batched;
+  Simulate (1, Time (0), single);
+  uint32_t batches = Simulate (16, m_window, batched);
+
+  NS_TEST_ASSERT_MSG_EQ (single.size (), m_packets, "Missing packets.");
+  NS_TEST_ASSERT_MSG_EQ (batched.size (), m_packets, "Missing packets.");
+  for (auto const &rx : single)
+    {
+      Time diff = batched [rx.first] - rx.second;
+      if (m_window.IsZero ())
+        {
+          NS_TEST_EXPECT_MSG_EQ (diff, Time (0), "Packet " << rx.first <<
+                                 " received at a different time.");
+        }
+      else
+        {
+          NS_TEST_EXPECT_MSG_LT (Abs (diff), m_window + TimeStep (1),
+                                 "Packet " << rx.first <<
+                                 " out of batch window.");
+        }
+    }
+  if (m_window.IsStrictlyPositive ())
+    {
+      NS_TEST_EXPECT_MSG_LT (batches, m_packets, "Packets not batched.");
+    }
+}
+
+uint32_t
+OFSwitch13BatchTestCase::Simulate (uint32_t batchSize, Time batchWindow,
+                                   RxTimes_t &rxTimes)
+{
+  m_sent = 0;
+  m_batches = 0;
+  m_highDelay = false;
+  m_rxTimes = &rxTimes;
+
+  NodeContainer hosts;
+  hosts.Create (2);
+  Ptr<Node> switchNode = CreateObject<Node> ();
+
+  CsmaHelper csmaHelper;
+  csmaHelper.SetChannelAttribute ("DataRate", DataRateValue (DataRate ("1Gbps")));
+  NetDeviceContainer hostDevices;
+  NetDeviceContainer switchPorts;
+  for (size_t i = 0; i < hosts.GetN (); i++)
+    {
+      NodeContainer pair (hosts.Get (i), switchNode);
+      NetDeviceContainer link = csmaHelper.Install (pair);
+      hostDevices.Add (link.Get (0));
+      switchPorts.Add (link.Get (1));
+    }
+
+  // Dedicated control channels avoid random backoffs on a shared channel.
+  Ptr<Node> controllerNode = CreateObject<Node> ();
+  Ptr<OFSwitch13InternalHelper> of13Helper = CreateObject<OFSwitch13InternalHelper> ();
+  of13Helper->SetChannelType (OFSwitch13Helper::DEDICATEDP2P);
+  of13Helper->SetDeviceAttribute ("BatchSize", UintegerValue (batchSize));
+  of13Helper->SetDeviceAttribute ("BatchWindow", TimeValue (batchWindow));
+  of13Helper->SetDeviceAttribute ("TimeoutInterval", TimeValue (MilliSeconds (1)));
+  of13Helper->InstallController (controllerNode);
+  Ptr<OFSwitch13Device> device = of13Helper->InstallSwitch (switchNode, switchPorts);
+  of13Helper->CreateOpenFlowChannels ();
+  device->TraceConnectWithoutContext (
+    "BatchSize", MakeCallback (&OFSwitch13BatchTestCase::NotifyBatch, this));
+
+  InternetStackHelper internet;
+  internet.Install (hosts);
+  Ipv4AddressHelper ipv4helpr;
+  ipv4helpr.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer hostIpIfaces = ipv4helpr.Assign (hostDevices);
+
+  TypeId udpFactory = UdpSocketFactory::GetTypeId ();
+  Ptr<Socket> rxSocket = Socket::CreateSocket (hosts.Get (1), udpFactory);
+  rxSocket->Bind (InetSocketAddress (Ipv4Address::GetAny (), 9));
+  rxSocket->SetRecvCallback (
+    MakeCallback (&OFSwitch13BatchTestCase::ReceivePacket, this));
+  Ptr<Socket> txSocket = Socket::CreateSocket (hosts.Get (0), udpFactory);
+  txSocket->Connect (InetSocketAddress (hostIpIfaces.GetAddress (1), 9));
+
+  // The first packet resolves the host addresses and installs the flow
+  // entries, so the others are forwarded by the switch.
+  Simulator::Schedule (Seconds (1), &OFSwitch13BatchTestCase::SendPacket,
+                       this, txSocket);
+  Simulator::Schedule (Seconds (2), &OFSwitch13BatchTestCase::ToggleTcamDelay,
+                       this, device);
+  Simulator::Stop (Seconds (3));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  m_rxTimes = 0;
+  return m_batches;
+}
+
+void
+OFSwitch13BatchTestCase::SendPacket (Ptr<Socket> socket)
+{
+  SeqTsHeader seqTs;
+  seqTs.SetSeq (m_sent);
+  Ptr<Packet> packet = Create<Packet> (64);
+  packet->AddHeader (seqTs);
+  socket->Send (packet);
+
+  Time next = m_sent ? MicroSeconds (10) : Seconds (1);
+  if (++m_sent < m_packets)
+    {
+      Simulator::Schedule (next, &OFSwitch13BatchTestCase::SendPacket,
+                           this, socket);
+    }
+}
+
+void
+OFSwitch13BatchTestCase::ReceivePacket (Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      SeqTsHeader seqTs;
+      packet->RemoveHeader (seqTs);
+      (*m_rxTimes) [seqTs.GetSeq ()] = Simulator::Now ();
+    }
+}
+
+void
+OFSwitch13BatchTestCase::NotifyBatch (uint32_t count)
+{
+  m_batches++;
+}
+
+void
+OFSwitch13BatchTestCase::ToggleTcamDelay (Ptr<OFSwitch13Device> device)
+{
+  // The pipeline delay is updated on the next datapath timeout.
+  m_highDelay = !m_highDelay;
+  device->SetAttribute ("TcamDelay", TimeValue (
+                          MicroSeconds (m_highDelay ? 100 : 5)));
+  Simulator::Schedule (MilliSeconds (3),
+                       &OFSwitch13BatchTestCase::ToggleTcamDelay,
+                       this, device);
+}
+
+/**
+ * TestSuite for the ingress batching mode.
+ */
+class OFSwitch13BatchTestSuite : public TestSuite
+{
+public:
+  OFSwitch13BatchTestSuite ();
+};
+
+OFSwitch13BatchTestSuite::OFSwitch13BatchTestSuite ()
+  : TestSuite ("ofswitch13-batch", UNIT)
+{
+  AddTestCase (new OFSwitch13BatchTestCase (Time (0)), TestCase::QUICK);
+  AddTestCase (new OFSwitch13BatchTestCase (MicroSeconds (50)),
+               TestCase::QUICK);
+}
+
+static OFSwitch13BatchTestSuite g_ofswitch13BatchTestSuite;
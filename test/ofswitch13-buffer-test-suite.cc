@@ -0,0 +1,319 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+#include <map>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/csma-module.h>
+#include <ns3/internet-module.h>
+#include <ns3/ofswitch13-module.h>
+#include <ns3/test.h>
+
+using namespace ns3;
+
+/**
+ * Controller forwarding ARP packets between hosts and sending the other
+ * packets to the controller, buffered by the switch. The controller sends
+ * back one out of every few buffered packets to host 1, and ignores the
+ * others, which must expire in the switch buffer.
+ */
+class BufferTestController : public OFSwitch13Controller
+{
+public:
+  /**
+   * Constructor.
+   * \param retrieveEvery Retrieve one out of this many buffered packets.
+   */
+  BufferTestController (uint32_t retrieveEvery);
+
+protected:
+  // Inherited from OFSwitch13Controller
+  void HandshakeSuccessful (Ptr<const RemoteSwitch> swtch);
+  ofl_err HandlePacketIn (struct ofl_msg_packet_in *msg,
+                          Ptr<const RemoteSwitch> swtch, uint32_t xid);
+
+private:
+  uint32_t m_retrieveEvery; //!< Retrieve one out of this many packets.
+  uint32_t m_packetIns;     //!< Packet-in messages received.
+};
+
+BufferTestController::BufferTestController (uint32_t retrieveEvery)
+  : m_retrieveEvery (retrieveEvery),
+  m_packetIns (0)
+{
+}
+
+void
+BufferTestController::HandshakeSuccessful (Ptr<const RemoteSwitch> swtch)
+{
+  DpctlExecute (swtch, "flow-mod cmd=add,table=0,prio=10 "
+                "in_port=1,eth_type=0x0806 write:output=2");
+  DpctlExecute (swtch, "flow-mod cmd=add,table=0,prio=10 "
+                "in_port=2,eth_type=0x0806 write:output=1");
+  DpctlExecute (swtch, "flow-mod cmd=add,table=0,prio=0 "
+                "apply:output=ctrl:128");
+  DpctlExecute (swtch, "set-config miss=128");
+}
+
+ofl_err
+BufferTestController::HandlePacketIn (
+  struct ofl_msg_packet_in *msg, Ptr<const RemoteSwitch> swtch,
+  uint32_t xid)
+{
+  if (msg->buffer_id != NO_BUFFER && ++m_packetIns % m_retrieveEvery == 0)
+    {
+      // Send the buffered packet out to host 1.
+      struct ofl_msg_packet_out reply;
+      reply.header.type = OFPT_PACKET_OUT;
+      reply.buffer_id = msg->buffer_id;
+      reply.in_port = 1;
+      reply.data_length = 0;
+      reply.data = 0;
+
+      struct ofl_action_output *a =
+        (struct ofl_action_output*)xmalloc (sizeof (struct ofl_action_output));
+      a->header.type = OFPAT_OUTPUT;
+      a->port = 2;
+      a->max_len = 0;
+
+      reply.actions_num = 1;
+      reply.actions = (struct ofl_action_header**)&a;
+
+      SendToSwitch (swtch, (struct ofl_msg_header*)&reply, xid);
+      free (a);
+    }
+
+  // All handlers must free the message when everything is ok
+  ofl_msg_free ((struct ofl_msg_header*)msg, 0);
+  return 0;
+}
+
+/**
+ * Check the packets saved into the switch buffer ring. Host 0 sends UDP
+ * packets to host 1, which are buffered by the switch and sent to the
+ * controller. The controller retrieves some of them, and the others must
+ * expire. Each buffered packet must be either retrieved or expired, exactly
+ * once, and all packets are saved with the same timeout, so they must expire
+ * the same time after they were saved. The buffer must be empty at the end.
+ */
+class OFSwitch13BufferTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor.
+   * \param interval The interval between packets sent by host 0.
+   */
+  OFSwitch13BufferTestCase (Time interval);
+
+private:
+  virtual void DoRun (void);
+
+  void SendPacket (Ptr<Socket> socket);
+  void ReceivePacket (Ptr<Socket> socket);
+  void NotifySave (Ptr<const Packet> packet);
+  void NotifyRetrieve (Ptr<const Packet> packet);
+  void NotifyExpire (Ptr<const Packet> packet);
+  void CheckEmpty (Ptr<OFSwitch13Device> device);
+
+  /** Map packet UIDs to times. */
+  typedef std::map<uint64_t, Time> PacketTimes_t;
+
+  Time          m_interval;   //!< Interval between packets.
+  uint32_t      m_sent;       //!< Packets sent by host 0.
+  uint32_t      m_received;   //!< Packets received by host 1.
+  uint32_t      m_packets;    //!< Packets to send.
+  uint32_t      m_empty;      //!< Packets left in buffer at the end.
+  PacketTimes_t m_saved;      //!< Save times of buffered packets.
+  PacketTimes_t m_retrieved;  //!< Retrieve times.
+  PacketTimes_t m_expired;    //!< Expire times.
+  uint32_t      m_duplicates; //!< Packets retrieved or expired twice.
+};
+
+OFSwitch13BufferTestCase::OFSwitch13BufferTestCase (Time interval)
+  : TestCase ("Buffer ring with packets every " +
+              std::to_string (interval.GetMilliSeconds ()) + "ms"),
+  m_interval (interval),
+  m_sent (0),
+  m_received (0),
+  m_packets (1000),
+  m_empty (0),
+  m_duplicates (0)
+{
+}
+
+void
+OFSwitch13BufferTestCase::DoRun (void)
+{
+  GlobalValue::Bind ("ChecksumEnabled", BooleanValue (true));
+
+  NodeContainer hosts;
+  hosts.Create (2);
+  Ptr<Node> switchNode = CreateObject<Node> ();
+
+  CsmaHelper csmaHelper;
+  csmaHelper.SetChannelAttribute ("DataRate", DataRateValue (DataRate ("1Gbps")));
+  NetDeviceContainer hostDevices;
+  NetDeviceContainer switchPorts;
+  for (size_t i = 0; i < hosts.GetN (); i++)
+    {
+      NodeContainer pair (hosts.Get (i), switchNode);
+      NetDeviceContainer link = csmaHelper.Install (pair);
+      hostDevices.Add (link.Get (0));
+      switchPorts.Add (link.Get (1));
+    }
+
+  Ptr<Node> controllerNode = CreateObject<Node> ();
+  Ptr<OFSwitch13InternalHelper> of13Helper = CreateObject<OFSwitch13InternalHelper> ();
+  of13Helper->SetChannelType (OFSwitch13Helper::DEDICATEDP2P);
+  of13Helper->InstallController (
+    controllerNode, CreateObject<BufferTestController> (3));
+  Ptr<OFSwitch13Device> device = of13Helper->InstallSwitch (switchNode, switchPorts);
+  of13Helper->CreateOpenFlowChannels ();
+  device->TraceConnectWithoutContext (
+    "BufferSave", MakeCallback (&OFSwitch13BufferTestCase::NotifySave, this));
+  device->TraceConnectWithoutContext (
+    "BufferRetrieve",
+    MakeCallback (&OFSwitch13BufferTestCase::NotifyRetrieve, this));
+  device->TraceConnectWithoutContext (
+    "BufferExpire", MakeCallback (&OFSwitch13BufferTestCase::NotifyExpire, this));
+
+  InternetStackHelper internet;
+  internet.Install (hosts);
+  Ipv4AddressHelper ipv4helpr;
+  ipv4helpr.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer hostIpIfaces = ipv4helpr.Assign (hostDevices);
+
+  TypeId udpFactory = UdpSocketFactory::GetTypeId ();
+  Ptr<Socket> rxSocket = Socket::CreateSocket (hosts.Get (1), udpFactory);
+  rxSocket->Bind (InetSocketAddress (Ipv4Address::GetAny (), 9));
+  rxSocket->SetRecvCallback (
+    MakeCallback (&OFSwitch13BufferTestCase::ReceivePacket, this));
+  Ptr<Socket> txSocket = Socket::CreateSocket (hosts.Get (0), udpFactory);
+  txSocket->Connect (InetSocketAddress (hostIpIfaces.GetAddress (1), 9));
+
+  // All packets are sent by 1 + 1000 * interval seconds, and the buffer must
+  // be empty long after that.
+  Time stop = Seconds (1) + m_interval * m_packets + Seconds (20);
+  Simulator::Schedule (Seconds (1), &OFSwitch13BufferTestCase::SendPacket,
+                       this, txSocket);
+  Simulator::Schedule (stop - MilliSeconds (1),
+                       &OFSwitch13BufferTestCase::CheckEmpty, this, device);
+  Simulator::Stop (stop);
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_saved.size (), m_packets,
+                         "Packets not saved into buffer.");
+  NS_TEST_EXPECT_MSG_EQ (m_duplicates, 0,
+                         "Packets retrieved or expired twice.");
+  NS_TEST_EXPECT_MSG_EQ (m_retrieved.size () + m_expired.size (),
+                         m_saved.size (), "Packets lost in buffer.");
+  NS_TEST_ASSERT_MSG_GT (m_retrieved.size (), 0, "No packets retrieved.");
+  NS_TEST_ASSERT_MSG_GT (m_expired.size (), 0, "No packets expired.");
+  NS_TEST_EXPECT_MSG_EQ (m_received, m_retrieved.size (),
+                         "Retrieved packets not delivered.");
+  NS_TEST_EXPECT_MSG_EQ (m_empty, 0, "Packets left in buffer.");
+
+  // All expired packets were saved with the same timeout.
+  Time timeout = m_expired.begin ()->second -
+    m_saved [m_expired.begin ()->first];
+  NS_TEST_EXPECT_MSG_GT (timeout, Time (0), "Packet expired when saved.");
+  for (auto const &expired : m_expired)
+    {
+      NS_TEST_EXPECT_MSG_EQ (m_retrieved.count (expired.first), 0,
+                             "Packet both retrieved and expired.");
+      NS_TEST_EXPECT_MSG_EQ (expired.second - m_saved [expired.first], timeout,
+                             "Packet expired at the wrong time.");
+    }
+}
+
+void
+OFSwitch13BufferTestCase::SendPacket (Ptr<Socket> socket)
+{
+  socket->Send (Create<Packet> (64));
+  if (++m_sent < m_packets)
+    {
+      Simulator::Schedule (m_interval, &OFSwitch13BufferTestCase::SendPacket,
+                           this, socket);
+    }
+}
+
+void
+OFSwitch13BufferTestCase::ReceivePacket (Ptr<Socket> socket)
+{
+  while (socket->Recv ())
+    {
+      m_received++;
+    }
+}
+
+void
+OFSwitch13BufferTestCase::NotifySave (Ptr<const Packet> packet)
+{
+  m_saved [packet->GetUid ()] = Simulator::Now ();
+}
+
+void
+OFSwitch13BufferTestCase::NotifyRetrieve (Ptr<const Packet> packet)
+{
+  if (!m_retrieved.insert (
+        std::make_pair (packet->GetUid (), Simulator::Now ())).second)
+    {
+      m_duplicates++;
+    }
+}
+
+void
+OFSwitch13BufferTestCase::NotifyExpire (Ptr<const Packet> packet)
+{
+  if (!m_expired.insert (
+        std::make_pair (packet->GetUid (), Simulator::Now ())).second)
+    {
+      m_duplicates++;
+    }
+}
+
+void
+OFSwitch13BufferTestCase::CheckEmpty (Ptr<OFSwitch13Device> device)
+{
+  m_empty = device->GetBufferEntries ();
+}
+
+/**
+ * TestSuite for the switch buffer.
+ */
+class OFSwitch13BufferTestSuite : public TestSuite
+{
+public:
+  OFSwitch13BufferTestSuite ();
+};
+
+OFSwitch13BufferTestSuite::OFSwitch13BufferTestSuite ()
+  : TestSuite ("ofswitch13-buffer", UNIT)
+{
+  // A few packets in buffer at a time, and the buffer ring wrapping around
+  // several times with many packets in buffer.
+  AddTestCase (new OFSwitch13BufferTestCase (MilliSeconds (100)),
+               TestCase::QUICK);
+  AddTestCase (new OFSwitch13BufferTestCase (MilliSeconds (10)),
+               TestCase::QUICK);
+}
+
+static OFSwitch13BufferTestSuite g_ofswitch13BufferTestSuite;
@@ -0,0 +1,549 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/ofswitch13-module.h>
+#include <ns3/test.h>
+
+using namespace ns3;
+
+/** Classifier names, indexed by type. */
+static const char *g_classifierNames [] = {"Linear", "TupleSpace",
+                                           "ExactMatch", "LongestPrefix",
+                                           "DecisionTree"};
+
+/**
+ * Compare the lookups of a packet classifier against a linear search over
+ * random rules and packet keys. The rules fit the classifier under test:
+ * exact IPv4 destinations for the exact-match classifier, IPv4 destination
+ * prefixes for the longest prefix match classifier, and multi-field ACL rules
+ * for the others. The linear search checks all entries by masked flow key
+ * comparisons (the same criterion the classifiers use for indexed entries)
+ * and keeps the highest priority one. As the order among matching entries
+ * with the same priority is undefined, only the priority of the entries found
+ * is compared. The classifier is checked after the initial build, after a
+ * number of insertions and removals, and after the deferred update performed
+ * on datapath timeouts.
+ */
+class OFSwitch13ClassifierTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor.
+   * \param type The classifier algorithm.
+   * \param entries The number of rules in the initial build.
+   */
+  OFSwitch13ClassifierTestCase (OFSwitch13Device::ClassifierType type,
+                                uint32_t entries);
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Create a flow entry with a random rule for the classifier.
+   * \return The flow entry.
+   */
+  struct flow_entry* NewEntry (void);
+
+  /**
+   * Free a flow entry created by NewEntry ().
+   * \param entry The flow entry.
+   */
+  static void FreeEntry (struct flow_entry *entry);
+
+  /**
+   * Get a random IPv4 address from the address pool, in network byte order.
+   * \return The address.
+   */
+  uint32_t GetAddress (void);
+
+  /**
+   * Get a random flow key for a packet from the address and port pools.
+   * \return The flow key.
+   */
+  OFSwitch13FlowKey GetKey (void);
+
+  /**
+   * Compare the classifier lookups with the linear search for random keys.
+   * \param phase The test phase, for error messages.
+   */
+  void CheckLookups (std::string phase);
+
+  OFSwitch13Device::ClassifierType  m_type;     //!< Classifier algorithm.
+  uint32_t                    m_entries;        //!< Initial rules.
+  Ptr<OFSwitch13Classifier>   m_classifier;     //!< Classifier under test.
+  std::vector<struct flow_entry*> m_live;       //!< Rules in the classifier.
+  Ptr<UniformRandomVariable>  m_rng;            //!< Random generator.
+};
+
+OFSwitch13ClassifierTestCase::OFSwitch13ClassifierTestCase (
+  OFSwitch13Device::ClassifierType type, uint32_t entries)
+  : TestCase (std::string (g_classifierNames [type]) + " classifier with " +
+              std::to_string (entries) + " random entries"),
+  m_type (type),
+  m_entries (entries)
+{
+}
+
+void
+OFSwitch13ClassifierTestCase::DoRun (void)
+{
+  m_rng = CreateObject<UniformRandomVariable> ();
+  m_rng->SetStream (1);
+  switch (m_type)
+    {
+    case OFSwitch13Device::CLASSIFIER_TSS:
+      m_classifier = Create<OFSwitch13TssClassifier> ();
+      break;
+    case OFSwitch13Device::CLASSIFIER_EXACT:
+      {
+        Ptr<OFSwitch13ExactClassifier> exact =
+          Create<OFSwitch13ExactClassifier> ();
+        std::vector<uint32_t> fields;
+        fields.push_back (OXM_OF_ETH_TYPE);
+        fields.push_back (OXM_OF_IPV4_DST);
+        NS_TEST_ASSERT_MSG_EQ (exact->SetFields (fields), true,
+                               "Field set not supported.");
+        m_classifier = exact;
+        break;
+      }
+    case OFSwitch13Device::CLASSIFIER_LPM:
+      m_classifier = Create<OFSwitch13LpmClassifier> ();
+      break;
+    case OFSwitch13Device::CLASSIFIER_TREE:
+      m_classifier = Create<OFSwitch13TreeClassifier> ();
+      break;
+    default:
+      NS_FATAL_ERROR ("Classifier type not supported by this test.");
+    }
+
+  // The classifier is built from a flow table holding the initial rules.
+  struct ofl_table_stats stats;
+  memset (&stats, 0, sizeof (stats));
+  struct flow_table table;
+  memset (&table, 0, sizeof (table));
+  table.stats = &stats;
+  list_init (&table.match_entries);
+  for (uint32_t i = 0; i < m_entries; i++)
+    {
+      struct flow_entry *entry = NewEntry ();
+      list_push_back (&table.match_entries, &entry->match_node);
+      m_live.push_back (entry);
+    }
+  m_classifier->Build (&table);
+  NS_TEST_ASSERT_MSG_EQ (m_classifier->GetNLinear (), 0,
+                         "Entries not indexed by the classifier.");
+  CheckLookups ("build");
+
+  // Insert and remove some rules.
+  uint32_t changes = m_entries / 4;
+  for (uint32_t i = 0; i < changes; i++)
+    {
+      struct flow_entry *entry = NewEntry ();
+      m_classifier->Insert (entry);
+      m_live.push_back (entry);
+
+      uint32_t idx = m_rng->GetInteger (0, m_live.size () - 1);
+      m_classifier->Remove (m_live [idx]);
+      FreeEntry (m_live [idx]);
+      m_live [idx] = m_live.back ();
+      m_live.pop_back ();
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_classifier->GetNEntries (), m_live.size (),
+                         "Wrong number of entries.");
+  CheckLookups ("changes");
+
+  // The deferred update rebuilds the decision tree.
+  m_classifier->Update ();
+  if (m_type == OFSwitch13Device::CLASSIFIER_TREE)
+    {
+      OFSwitch13TreeClassifier *tree = static_cast<OFSwitch13TreeClassifier*> (
+          PeekPointer (m_classifier));
+      NS_TEST_EXPECT_MSG_EQ (tree->GetNPending (), 0, "Tree not rebuilt.");
+    }
+  CheckLookups ("update");
+
+  m_classifier = 0;
+  for (auto const &entry : m_live)
+    {
+      FreeEntry (entry);
+    }
+  m_live.clear ();
+}
+
+struct flow_entry*
+OFSwitch13ClassifierTestCase::NewEntry (void)
+{
+  struct ofl_match *match =
+    (struct ofl_match*)xmalloc (sizeof (struct ofl_match));
+  ofl_structs_match_init (match);
+  struct flow_entry *entry =
+    (struct flow_entry*)xcalloc (1, sizeof (struct flow_entry));
+  entry->stats =
+    (struct ofl_flow_stats*)xcalloc (1, sizeof (struct ofl_flow_stats));
+  entry->stats->priority = m_rng->GetInteger (1, 1000);
+  entry->stats->match = (struct ofl_match_header*)match;
+  entry->match = (struct ofl_match_header*)match;
+
+  // Routing entries with exact addresses or prefixes.
+  if (m_type == OFSwitch13Device::CLASSIFIER_EXACT
+      || m_type == OFSwitch13Device::CLASSIFIER_LPM)
+    {
+      ofl_structs_match_put16 (match, OXM_OF_ETH_TYPE, 0x0800);
+      uint32_t prefixes [] = {8, 16, 20, 24, 32};
+      uint32_t len = m_type == OFSwitch13Device::CLASSIFIER_EXACT ?
+        32 : prefixes [m_rng->GetInteger (0, 4)];
+      if (len == 32)
+        {
+          ofl_structs_match_put32 (match, OXM_OF_IPV4_DST, GetAddress ());
+        }
+      else
+        {
+          uint8_t bytes [4];
+          Ipv4Address (~0U << (32 - len)).Serialize (bytes);
+          uint32_t mask;
+          memcpy (&mask, bytes, 4);
+          ofl_structs_match_put32m (match, OXM_OF_IPV4_DST_W,
+                                    GetAddress () & mask, mask);
+        }
+      return entry;
+    }
+
+  // ACL rules over the fields cut by the decision tree, with random prefix
+  // lengths and wildcards, drawn from the same pools of the packet keys.
+  if (m_rng->GetInteger (0, 3) == 0)
+    {
+      ofl_structs_match_put32 (match, OXM_OF_IN_PORT, m_rng->GetInteger (1, 4));
+    }
+  ofl_structs_match_put16 (match, OXM_OF_ETH_TYPE, 0x0800);
+  uint32_t fields [] = {OXM_OF_IPV4_SRC, OXM_OF_IPV4_DST};
+  uint32_t masked [] = {OXM_OF_IPV4_SRC_W, OXM_OF_IPV4_DST_W};
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      uint32_t prefixes [] = {0, 8, 16, 20, 24, 32};
+      uint32_t len = prefixes [m_rng->GetInteger (0, 5)];
+      if (len == 32)
+        {
+          ofl_structs_match_put32 (match, fields [i], GetAddress ());
+        }
+      else if (len)
+        {
+          uint8_t bytes [4];
+          Ipv4Address (~0U << (32 - len)).Serialize (bytes);
+          uint32_t mask;
+          memcpy (&mask, bytes, 4);
+          ofl_structs_match_put32m (match, masked [i],
+                                    GetAddress () & mask, mask);
+        }
+    }
+  if (m_rng->GetInteger (0, 2))
+    {
+      bool tcp = m_rng->GetInteger (0, 1);
+      ofl_structs_match_put8 (match, OXM_OF_IP_PROTO, tcp ? 6 : 17);
+      if (m_rng->GetInteger (0, 2))
+        {
+          uint16_t ports [] = {22, 53, 80, 443, 8080};
+          ofl_structs_match_put16 (match, tcp ? OXM_OF_TCP_DST : OXM_OF_UDP_DST,
+                                   ports [m_rng->GetInteger (0, 4)]);
+        }
+      if (m_rng->GetInteger (0, 3) == 0)
+        {
+          ofl_structs_match_put16 (match, tcp ? OXM_OF_TCP_SRC : OXM_OF_UDP_SRC,
+                                   m_rng->GetInteger (1024, 1031));
+        }
+    }
+  return entry;
+}
+
+void
+OFSwitch13ClassifierTestCase::FreeEntry (struct flow_entry *entry)
+{
+  ofl_structs_free_match (entry->match, 0);
+  free (entry->stats);
+  free (entry);
+}
+
+uint32_t
+OFSwitch13ClassifierTestCase::GetAddress (void)
+{
+  // Addresses in 10.0.0.0/14 with few distinct values in the last bytes, so
+  // rules overlap and packets hit them.
+  uint8_t bytes [4];
+  Ipv4Address (Ipv4Address ("10.0.0.0").Get () |
+               (m_rng->GetInteger (0, 3) << 16) |
+               (m_rng->GetInteger (0, 15) << 8) |
+               m_rng->GetInteger (0, 15)).Serialize (bytes);
+  uint32_t address;
+  memcpy (&address, bytes, 4);
+  return address;
+}
+
+OFSwitch13FlowKey
+OFSwitch13ClassifierTestCase::GetKey (void)
+{
+  // The key is built from the packet match, just like the classifier does
+  // for packets whose flow key was not extracted.
+  struct ofl_match *match =
+    (struct ofl_match*)xmalloc (sizeof (struct ofl_match));
+  ofl_structs_match_init (match);
+  ofl_structs_match_put32 (match, OXM_OF_IN_PORT, m_rng->GetInteger (1, 4));
+  ofl_structs_match_put16 (match, OXM_OF_ETH_TYPE, 0x0800);
+  ofl_structs_match_put32 (match, OXM_OF_IPV4_SRC, GetAddress ());
+  ofl_structs_match_put32 (match, OXM_OF_IPV4_DST, GetAddress ());
+  bool tcp = m_rng->GetInteger (0, 1);
+  uint16_t ports [] = {22, 53, 80, 443, 8080};
+  ofl_structs_match_put8 (match, OXM_OF_IP_PROTO, tcp ? 6 : 17);
+  ofl_structs_match_put16 (match, tcp ? OXM_OF_TCP_SRC : OXM_OF_UDP_SRC,
+                           m_rng->GetInteger (1024, 1031));
+  ofl_structs_match_put16 (match, tcp ? OXM_OF_TCP_DST : OXM_OF_UDP_DST,
+                           ports [m_rng->GetInteger (0, 4)]);
+
+  OFSwitch13FlowKey key;
+  key.SetMatch (match, 0);
+  ofl_structs_free_match ((struct ofl_match_header*)match, 0);
+  return key;
+}
+
+void
+OFSwitch13ClassifierTestCase::CheckLookups (std::string phase)
+{
+  // The entry keys for the linear search.
+  std::vector<OFSwitch13FlowKey> values (m_live.size ());
+  std::vector<OFSwitch13FlowKey> masks (m_live.size ());
+  for (uint32_t i = 0; i < m_live.size (); i++)
+    {
+      values [i].SetMatch ((struct ofl_match*)m_live [i]->match, &masks [i]);
+    }
+
+  uint32_t hits = 0;
+  for (uint32_t k = 0; k < 2000; k++)
+    {
+      OFSwitch13FlowKey key = GetKey ();
+      struct flow_entry *linear = 0;
+      for (uint32_t i = 0; i < m_live.size (); i++)
+        {
+          OFSwitch13FlowKey masked = key;
+          masked.ApplyMask (masks [i]);
+          if (masked == values [i] && (!linear || m_live [i]->stats->priority
+                                       > linear->stats->priority))
+            {
+              linear = m_live [i];
+            }
+        }
+
+      // All entries are indexed, so the packet is never used.
+      struct flow_entry *found = m_classifier->Lookup (0, key);
+      NS_TEST_ASSERT_MSG_EQ ((found != 0), (linear != 0),
+                             "Lookup mismatch after " << phase << ".");
+      if (linear)
+        {
+          NS_TEST_ASSERT_MSG_EQ (found->stats->priority,
+                                 linear->stats->priority,
+                                 "Wrong priority after " << phase << ".");
+          OFSwitch13FlowKey value;
+          OFSwitch13FlowKey mask;
+          value.SetMatch ((struct ofl_match*)found->match, &mask);
+          key.ApplyMask (mask);
+          NS_TEST_ASSERT_MSG_EQ ((key == value), true,
+                                 "Entry doesn't match after " << phase << ".");
+          hits++;
+        }
+    }
+  NS_TEST_EXPECT_MSG_GT (hits, 0, "No lookups hit the rules.");
+}
+
+/**
+ * Check the longest prefix match classifier with a large forwarding table,
+ * with the prefix length mix of a public IPv4 BGP table. All entries have
+ * the same priority, so the classifier must return the longest prefix
+ * matching each address, which is checked against the set of prefixes for
+ * each length. To save memory, the entry matches are released once the
+ * entries are inserted (they are not removed).
+ */
+class OFSwitch13LpmScaleTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor.
+   * \param prefixes The number of prefixes.
+   */
+  OFSwitch13LpmScaleTestCase (uint32_t prefixes);
+
+private:
+  virtual void DoRun (void);
+
+  uint32_t m_prefixes;  //!< Number of prefixes.
+};
+
+OFSwitch13LpmScaleTestCase::OFSwitch13LpmScaleTestCase (uint32_t prefixes)
+  : TestCase ("LongestPrefix classifier with " + std::to_string (prefixes) +
+              " IPv4 prefixes"),
+  m_prefixes (prefixes)
+{
+}
+
+void
+OFSwitch13LpmScaleTestCase::DoRun (void)
+{
+  // Prefix length mix of a public IPv4 BGP table (prefixes per thousand).
+  static const uint32_t mix [][2] = {
+    {12, 1}, {13, 2}, {14, 4}, {15, 6}, {16, 14}, {17, 8}, {18, 14},
+    {19, 25}, {20, 40}, {21, 45}, {22, 100}, {23, 85}, {24, 650}, {25, 2},
+    {26, 2}, {27, 1}, {28, 1}};
+  const uint32_t nLengths = sizeof (mix) / sizeof (mix [0]);
+
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  rng->SetStream (1);
+  Ptr<OFSwitch13LpmClassifier> lpm = Create<OFSwitch13LpmClassifier> ();
+  std::vector<struct flow_entry> entries (m_prefixes);
+  std::vector<struct ofl_flow_stats> stats (m_prefixes);
+  std::vector<uint32_t> lengths (m_prefixes);
+  std::vector<std::unordered_set<uint32_t> > used (33);
+  std::vector<uint32_t> prefixes;
+  uint32_t i = 0;
+  for (uint32_t l = 0; l < nLengths; l++)
+    {
+      uint32_t len = mix [l][0];
+      uint32_t count = static_cast<uint64_t> (m_prefixes) * mix [l][1] / 1000;
+      if (len == 24)
+        {
+          count = m_prefixes - i;
+          for (uint32_t r = l + 1; r < nLengths; r++)
+            {
+              count -= static_cast<uint64_t> (m_prefixes) * mix [r][1] / 1000;
+            }
+        }
+      uint32_t mask = ~0U << (32 - len);
+      for (uint32_t k = 0; k < count; k++, i++)
+        {
+          uint32_t addr;
+          do
+            {
+              addr = rng->GetInteger (0x01000000, 0xdfffffff) & mask;
+            }
+          while (!used [len].insert (addr).second);
+          prefixes.push_back (addr);
+          lengths [i] = len;
+
+          uint8_t addrBytes [4];
+          uint8_t maskBytes [4];
+          Ipv4Address (addr).Serialize (addrBytes);
+          Ipv4Address (mask).Serialize (maskBytes);
+          uint32_t addrValue;
+          uint32_t maskValue;
+          memcpy (&addrValue, addrBytes, 4);
+          memcpy (&maskValue, maskBytes, 4);
+          struct ofl_match *match =
+            (struct ofl_match*)xmalloc (sizeof (struct ofl_match));
+          ofl_structs_match_init (match);
+          ofl_structs_match_put16 (match, OXM_OF_ETH_TYPE, 0x0800);
+          ofl_structs_match_put32m (match, OXM_OF_IPV4_DST_W, addrValue,
+                                    maskValue);
+
+          stats [i].priority = 100;
+          entries [i].stats = &stats [i];
+          entries [i].match = (struct ofl_match_header*)match;
+          lpm->Insert (&entries [i]);
+          ofl_structs_free_match (entries [i].match, 0);
+          entries [i].match = 0;
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (i, m_prefixes, "Wrong number of prefixes.");
+  NS_TEST_ASSERT_MSG_EQ (lpm->GetNPrefixes (), m_prefixes,
+                         "Prefixes not indexed by the tries.");
+
+  // Half of the addresses fall into some random prefix, and the other half
+  // are random.
+  for (uint32_t k = 0; k < 100000; k++)
+    {
+      uint32_t addr = rng->GetInteger (0x01000000, 0xdfffffff);
+      if (k % 2)
+        {
+          uint32_t p = rng->GetInteger (0, m_prefixes - 1);
+          uint32_t mask = ~0U << (32 - lengths [p]);
+          addr = prefixes [p] | (addr & ~mask);
+        }
+      uint32_t longest = 0;
+      for (uint32_t len = 32; len > 0 && !longest; len--)
+        {
+          if (used [len].count (addr & (~0U << (32 - len))))
+            {
+              longest = len;
+            }
+        }
+
+      uint8_t addrBytes [4];
+      Ipv4Address (addr).Serialize (addrBytes);
+      uint32_t addrValue;
+      memcpy (&addrValue, addrBytes, 4);
+      struct ofl_match *match =
+        (struct ofl_match*)xmalloc (sizeof (struct ofl_match));
+      ofl_structs_match_init (match);
+      ofl_structs_match_put16 (match, OXM_OF_ETH_TYPE, 0x0800);
+      ofl_structs_match_put32 (match, OXM_OF_IPV4_DST, addrValue);
+      OFSwitch13FlowKey key;
+      key.SetMatch (match, 0);
+      ofl_structs_free_match ((struct ofl_match_header*)match, 0);
+
+      struct flow_entry *found = lpm->Lookup (0, key);
+      NS_TEST_ASSERT_MSG_EQ ((found != 0), (longest != 0),
+                             "Lookup mismatch for " << Ipv4Address (addr));
+      if (found)
+        {
+          NS_TEST_ASSERT_MSG_EQ (lengths [found - &entries [0]], longest,
+                                 "Wrong prefix for " << Ipv4Address (addr));
+        }
+    }
+}
+
+/**
+ * TestSuite for the packet classifiers.
+ */
+class OFSwitch13ClassifierTestSuite : public TestSuite
+{
+public:
+  OFSwitch13ClassifierTestSuite ();
+};
+
+OFSwitch13ClassifierTestSuite::OFSwitch13ClassifierTestSuite ()
+  : TestSuite ("ofswitch13-classifier", UNIT)
+{
+  // Small tables keep the rules in the tree root, and larger ones need cuts.
+  AddTestCase (new OFSwitch13ClassifierTestCase (
+                 OFSwitch13Device::CLASSIFIER_TREE, 50), TestCase::QUICK);
+  AddTestCase (new OFSwitch13ClassifierTestCase (
+                 OFSwitch13Device::CLASSIFIER_TREE, 2000), TestCase::QUICK);
+  AddTestCase (new OFSwitch13ClassifierTestCase (
+                 OFSwitch13Device::CLASSIFIER_TSS, 2000), TestCase::QUICK);
+  AddTestCase (new OFSwitch13ClassifierTestCase (
+                 OFSwitch13Device::CLASSIFIER_EXACT, 2000), TestCase::QUICK);
+  AddTestCase (new OFSwitch13ClassifierTestCase (
+                 OFSwitch13Device::CLASSIFIER_LPM, 2000), TestCase::QUICK);
+
+  // A large forwarding table with the prefix length mix of the Internet.
+  AddTestCase (new OFSwitch13LpmScaleTestCase (900000), TestCase::EXTENSIVE);
+}
+
+static OFSwitch13ClassifierTestSuite g_ofswitch13ClassifierTestSuite;
@@ -0,0 +1,305 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+#include <set>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/csma-module.h>
+#include <ns3/internet-module.h>
+#include <ns3/applications-module.h>
+#include <ns3/ofswitch13-module.h>
+#include <ns3/test.h>
+
+using namespace ns3;
+
+/**
+ * Controller installing a two-table pipeline: table 0 forwards ARP packets
+ * and sends UDP packets to table 1, which forwards them by the UDP
+ * destination port. The rule for port 10 is shadowed by a dropping rule with
+ * a hard timeout, and there is no rule for port 12.
+ */
+class FlowCacheTestController : public OFSwitch13Controller
+{
+protected:
+  // Inherited from OFSwitch13Controller
+  void HandshakeSuccessful (Ptr<const RemoteSwitch> swtch);
+};
+
+void
+FlowCacheTestController::HandshakeSuccessful (Ptr<const RemoteSwitch> swtch)
+{
+  DpctlExecute (swtch, "flow-mod cmd=add,table=0,prio=10 "
+                "in_port=1,eth_type=0x0806 write:output=2");
+  DpctlExecute (swtch, "flow-mod cmd=add,table=0,prio=10 "
+                "in_port=2,eth_type=0x0806 write:output=1");
+  DpctlExecute (swtch, "flow-mod cmd=add,table=0,prio=5 "
+                "eth_type=0x0800,ip_proto=17 goto:1");
+  DpctlExecute (swtch, "flow-mod cmd=add,table=1,prio=10 "
+                "eth_type=0x0800,ip_proto=17,udp_dst=9 write:output=2");
+  DpctlExecute (swtch, "flow-mod cmd=add,table=1,prio=10 "
+                "eth_type=0x0800,ip_proto=17,udp_dst=10 write:output=2");
+  DpctlExecute (swtch, "flow-mod cmd=add,table=1,prio=10 "
+                "eth_type=0x0800,ip_proto=17,udp_dst=11");
+  DpctlExecute (swtch, "flow-mod cmd=add,table=1,hard=2,prio=30 "
+                "eth_type=0x0800,ip_proto=17,udp_dst=10");
+}
+
+/**
+ * Compare the packets delivered by the switch with and without the flow
+ * cache. Host 0 sends UDP packets with sequence numbers to host 1, from
+ * several source ports and to several destination ports, while the
+ * controller changes the flow tables: it adds and deletes entries on both
+ * tables, and an entry expires. The cached results for the changed tables
+ * must be invalidated, so the same packets must be delivered in both runs. A
+ * small cache forces the least recently used flows to be evicted as well.
+ */
+class OFSwitch13FlowCacheTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor.
+   * \param megaflow Enable the megaflow layer.
+   * \param cacheSize The flow cache size.
+   */
+  OFSwitch13FlowCacheTestCase (bool megaflow, uint32_t cacheSize);
+
+private:
+  virtual void DoRun (void);
+
+  /** Set of packet sequence numbers. */
+  typedef std::set<uint32_t> SeqSet_t;
+
+  /**
+   * Simulate the network and get the packets received by host 1.
+   * \param cache Enable the flow cache.
+   * \param received The sequence numbers of the received packets.
+   * \return The number of flow cache hits.
+   */
+  uint32_t Simulate (bool cache, SeqSet_t &received);
+
+  void SendPacket (void);
+  void ReceivePacket (Ptr<Socket> socket);
+  void NotifyHit (Ptr<const Packet> packet);
+  void UpdateRules (Ptr<OFSwitch13Controller> controller, uint64_t dpId,
+                    std::string cmd);
+
+  bool        m_megaflow;   //!< Megaflow layer enabled.
+  uint32_t    m_cacheSize;  //!< Flow cache size.
+  uint32_t    m_sent;       //!< Packets sent by host 0.
+  uint32_t    m_hits;       //!< Flow cache hits.
+  uint32_t    m_packets;    //!< Packets to send.
+  Ipv4Address m_dstAddr;    //!< Host 1 address.
+  SeqSet_t   *m_received;   //!< Packets received by host 1.
+  std::vector<Ptr<Socket> > m_txSockets;  //!< Host 0 sockets.
+};
+
+OFSwitch13FlowCacheTestCase::OFSwitch13FlowCacheTestCase (bool megaflow,
+                                                          uint32_t cacheSize)
+  : TestCase (std::string ("Flow cache with ") +
+              (megaflow ? "megaflows" : "microflows only") + " and " +
+              std::to_string (cacheSize) + " entries"),
+  m_megaflow (megaflow),
+  m_cacheSize (cacheSize),
+  m_sent (0),
+  m_hits (0),
+  m_packets (4000),
+  m_received (0)
+{
+}
+
+void
+OFSwitch13FlowCacheTestCase::DoRun (void)
+{
+  GlobalValue::Bind ("ChecksumEnabled", BooleanValue (true));
+
+  SeqSet_t uncached;
+  SeqSet_t cached;
+  Simulate (false, uncached);
+  uint32_t hits = Simulate (true, cached);
+
+  NS_TEST_ASSERT_MSG_GT (uncached.size (), 0, "No packets delivered.");
+  NS_TEST_ASSERT_MSG_LT (uncached.size (), m_packets, "No packets dropped.");
+  NS_TEST_EXPECT_MSG_EQ (cached.size (), uncached.size (),
+                         "Different number of packets delivered.");
+  for (auto const &seq : uncached)
+    {
+      NS_TEST_EXPECT_MSG_EQ (cached.count (seq), 1, "Packet " << seq <<
+                             " not delivered with the flow cache.");
+    }
+  NS_TEST_EXPECT_MSG_GT (hits, 0, "No flow cache hits.");
+}
+
+uint32_t
+OFSwitch13FlowCacheTestCase::Simulate (bool cache, SeqSet_t &received)
+{
+  m_sent = 0;
+  m_hits = 0;
+  m_received = &received;
+
+  NodeContainer hosts;
+  hosts.Create (2);
+  Ptr<Node> switchNode = CreateObject<Node> ();
+
+  CsmaHelper csmaHelper;
+  csmaHelper.SetChannelAttribute ("DataRate", DataRateValue (DataRate ("1Gbps")));
+  NetDeviceContainer hostDevices;
+  NetDeviceContainer switchPorts;
+  for (size_t i = 0; i < hosts.GetN (); i++)
+    {
+      NodeContainer pair (hosts.Get (i), switchNode);
+      NetDeviceContainer link = csmaHelper.Install (pair);
+      hostDevices.Add (link.Get (0));
+      switchPorts.Add (link.Get (1));
+    }
+
+  // Dedicated control channels avoid random backoffs on a shared channel.
+  Ptr<Node> controllerNode = CreateObject<Node> ();
+  Ptr<FlowCacheTestController> controller =
+    CreateObject<FlowCacheTestController> ();
+  Ptr<OFSwitch13InternalHelper> of13Helper = CreateObject<OFSwitch13InternalHelper> ();
+  of13Helper->SetChannelType (OFSwitch13Helper::DEDICATEDP2P);
+  of13Helper->SetDeviceAttribute ("FlowCache", BooleanValue (cache));
+  of13Helper->SetDeviceAttribute ("FlowCacheMegaflow", BooleanValue (m_megaflow));
+  of13Helper->SetDeviceAttribute ("FlowCacheSize", UintegerValue (m_cacheSize));
+  of13Helper->InstallController (controllerNode, controller);
+  Ptr<OFSwitch13Device> device = of13Helper->InstallSwitch (switchNode, switchPorts);
+  of13Helper->CreateOpenFlowChannels ();
+  device->TraceConnectWithoutContext (
+    "FlowCacheHit", MakeCallback (&OFSwitch13FlowCacheTestCase::NotifyHit, this));
+
+  InternetStackHelper internet;
+  internet.Install (hosts);
+  Ipv4AddressHelper ipv4helpr;
+  ipv4helpr.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer hostIpIfaces = ipv4helpr.Assign (hostDevices);
+  m_dstAddr = hostIpIfaces.GetAddress (1);
+
+  // Host 1 listens on all destination ports, and host 0 sends packets from
+  // several source ports.
+  TypeId udpFactory = UdpSocketFactory::GetTypeId ();
+  for (uint16_t port = 9; port <= 12; port++)
+    {
+      Ptr<Socket> rxSocket = Socket::CreateSocket (hosts.Get (1), udpFactory);
+      rxSocket->Bind (InetSocketAddress (Ipv4Address::GetAny (), port));
+      rxSocket->SetRecvCallback (
+        MakeCallback (&OFSwitch13FlowCacheTestCase::ReceivePacket, this));
+    }
+  m_txSockets.clear ();
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      Ptr<Socket> txSocket = Socket::CreateSocket (hosts.Get (0), udpFactory);
+      txSocket->Bind ();
+      m_txSockets.push_back (txSocket);
+    }
+
+  // Flow table changes on both tables while packets are flowing. The
+  // dropping rule for port 10 expires about 2 seconds after the handshake.
+  uint64_t dpId = device->GetDatapathId ();
+  Simulator::Schedule (
+    MilliSeconds (2000), &OFSwitch13FlowCacheTestCase::UpdateRules, this,
+    controller, dpId, "flow-mod cmd=add,table=1,prio=20 "
+    "eth_type=0x0800,ip_proto=17,udp_dst=11 write:output=2");
+  Simulator::Schedule (
+    MilliSeconds (2500), &OFSwitch13FlowCacheTestCase::UpdateRules, this,
+    controller, dpId, "flow-mod cmd=dels,table=1,prio=10 "
+    "eth_type=0x0800,ip_proto=17,udp_dst=9");
+  Simulator::Schedule (
+    MilliSeconds (3000), &OFSwitch13FlowCacheTestCase::UpdateRules, this,
+    controller, dpId, "flow-mod cmd=add,table=0,prio=20 "
+    "eth_type=0x0800,ip_proto=17,udp_dst=12 write:output=2");
+  Simulator::Schedule (
+    MilliSeconds (3500), &OFSwitch13FlowCacheTestCase::UpdateRules, this,
+    controller, dpId, "flow-mod cmd=add,table=1,prio=10 "
+    "eth_type=0x0800,ip_proto=17,udp_dst=9 write:output=2");
+
+  Simulator::Schedule (Seconds (1), &OFSwitch13FlowCacheTestCase::SendPacket,
+                       this);
+  Simulator::Stop (Seconds (6));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  m_txSockets.clear ();
+  m_received = 0;
+  return m_hits;
+}
+
+void
+OFSwitch13FlowCacheTestCase::SendPacket (void)
+{
+  SeqTsHeader seqTs;
+  seqTs.SetSeq (m_sent);
+  Ptr<Packet> packet = Create<Packet> (64);
+  packet->AddHeader (seqTs);
+  Ptr<Socket> socket = m_txSockets [m_sent % m_txSockets.size ()];
+  socket->SendTo (packet, 0, InetSocketAddress (m_dstAddr, 9 + m_sent % 4));
+
+  if (++m_sent < m_packets)
+    {
+      Simulator::Schedule (MilliSeconds (1),
+                           &OFSwitch13FlowCacheTestCase::SendPacket, this);
+    }
+}
+
+void
+OFSwitch13FlowCacheTestCase::ReceivePacket (Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      SeqTsHeader seqTs;
+      packet->RemoveHeader (seqTs);
+      m_received->insert (seqTs.GetSeq ());
+    }
+}
+
+void
+OFSwitch13FlowCacheTestCase::NotifyHit (Ptr<const Packet> packet)
+{
+  m_hits++;
+}
+
+void
+OFSwitch13FlowCacheTestCase::UpdateRules (
+  Ptr<OFSwitch13Controller> controller, uint64_t dpId, std::string cmd)
+{
+  controller->DpctlExecute (dpId, cmd);
+}
+
+/**
+ * TestSuite for the flow cache.
+ */
+class OFSwitch13FlowCacheTestSuite : public TestSuite
+{
+public:
+  OFSwitch13FlowCacheTestSuite ();
+};
+
+OFSwitch13FlowCacheTestSuite::OFSwitch13FlowCacheTestSuite ()
+  : TestSuite ("ofswitch13-flow-cache", UNIT)
+{
+  AddTestCase (new OFSwitch13FlowCacheTestCase (true, 4096), TestCase::QUICK);
+  AddTestCase (new OFSwitch13FlowCacheTestCase (false, 4096), TestCase::QUICK);
+
+  // Fewer entries than microflows, so microflows are evicted, while the four
+  // megaflows (one per destination port) still fit the cache.
+  AddTestCase (new OFSwitch13FlowCacheTestCase (true, 4), TestCase::QUICK);
+}
+
+static OFSwitch13FlowCacheTestSuite g_ofswitch13FlowCacheTestSuite;
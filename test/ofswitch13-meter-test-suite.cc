@@ -0,0 +1,217 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+#include <sstream>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/csma-module.h>
+#include <ns3/internet-module.h>
+#include <ns3/ofswitch13-module.h>
+#include <ns3/test.h>
+
+using namespace ns3;
+
+/** Controller installing a meter for the traffic from host 0. */
+class MeterTestController : public OFSwitch13Controller
+{
+public:
+  /**
+   * Constructor.
+   * \param bandRate The meter drop band rate.
+   */
+  MeterTestController (DataRate bandRate);
+
+protected:
+  // Inherited from OFSwitch13Controller
+  void HandshakeSuccessful (Ptr<const RemoteSwitch> swtch);
+
+private:
+  DataRate m_bandRate;  //!< Meter drop band rate.
+};
+
+MeterTestController::MeterTestController (DataRate bandRate)
+  : m_bandRate (bandRate)
+{
+}
+
+void
+MeterTestController::HandshakeSuccessful (Ptr<const RemoteSwitch> swtch)
+{
+  std::ostringstream meterCmd;
+  meterCmd << "meter-mod cmd=add,flags=1,meter=1 drop:rate="
+           << m_bandRate.GetBitRate () / 1000;
+  DpctlExecute (swtch, meterCmd.str ());
+  DpctlExecute (swtch, "flow-mod cmd=add,table=0,prio=1 in_port=1 "
+                "meter:1 write:output=2");
+  DpctlExecute (swtch, "flow-mod cmd=add,table=0,prio=1 in_port=2 "
+                "write:output=1");
+}
+
+/**
+ * Drive a meter at a constant rate and check the rate passed by it. The
+ * meter buckets are lazily refilled when packets hit the meter, so the rate
+ * passed must match the one given by the periodic refill: the drop band rate
+ * for traffic above it, or the offered rate otherwise. The rate is measured
+ * after the initial burst allowed by the full bucket.
+ */
+class OFSwitch13MeterTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor.
+   * \param bandRate The meter drop band rate.
+   * \param offered The rate offered by host 0.
+   */
+  OFSwitch13MeterTestCase (DataRate bandRate, DataRate offered);
+
+private:
+  virtual void DoRun (void);
+
+  void SendPacket (Ptr<Socket> socket);
+  void ReceivePacket (Ptr<Socket> socket);
+
+  DataRate  m_bandRate;   //!< Meter drop band rate.
+  DataRate  m_offered;    //!< Offered rate.
+  Time      m_interval;   //!< Interval between packets.
+  uint64_t  m_received;   //!< Packets received in the measurement window.
+  Time      m_start;      //!< Measurement window start.
+  Time      m_stop;       //!< Measurement window stop.
+
+  /** UDP payload size. */
+  static const uint32_t m_payload = 1000;
+  /** Frame size processed by the meter (Ethernet, IPv4, and UDP headers). */
+  static const uint32_t m_frameSize = m_payload + 42;
+};
+
+OFSwitch13MeterTestCase::OFSwitch13MeterTestCase (DataRate bandRate,
+                                                  DataRate offered)
+  : TestCase ("Meter with " + std::to_string (bandRate.GetBitRate ()) +
+              "bps band and " + std::to_string (offered.GetBitRate ()) +
+              "bps offered rate"),
+  m_bandRate (bandRate),
+  m_offered (offered),
+  m_received (0),
+  m_start (Seconds (3)),
+  m_stop (Seconds (5))
+{
+  m_interval = m_offered.CalculateBytesTxTime (m_frameSize);
+}
+
+void
+OFSwitch13MeterTestCase::DoRun (void)
+{
+  GlobalValue::Bind ("ChecksumEnabled", BooleanValue (true));
+
+  NodeContainer hosts;
+  hosts.Create (2);
+  Ptr<Node> switchNode = CreateObject<Node> ();
+
+  CsmaHelper csmaHelper;
+  csmaHelper.SetChannelAttribute ("DataRate", DataRateValue (DataRate ("1Gbps")));
+  NetDeviceContainer hostDevices;
+  NetDeviceContainer switchPorts;
+  for (size_t i = 0; i < hosts.GetN (); i++)
+    {
+      NodeContainer pair (hosts.Get (i), switchNode);
+      NetDeviceContainer link = csmaHelper.Install (pair);
+      hostDevices.Add (link.Get (0));
+      switchPorts.Add (link.Get (1));
+    }
+
+  Ptr<Node> controllerNode = CreateObject<Node> ();
+  Ptr<OFSwitch13InternalHelper> of13Helper = CreateObject<OFSwitch13InternalHelper> ();
+  of13Helper->InstallController (
+    controllerNode, CreateObject<MeterTestController> (m_bandRate));
+  of13Helper->InstallSwitch (switchNode, switchPorts);
+  of13Helper->CreateOpenFlowChannels ();
+
+  InternetStackHelper internet;
+  internet.Install (hosts);
+  Ipv4AddressHelper ipv4helpr;
+  ipv4helpr.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer hostIpIfaces = ipv4helpr.Assign (hostDevices);
+
+  TypeId udpFactory = UdpSocketFactory::GetTypeId ();
+  Ptr<Socket> rxSocket = Socket::CreateSocket (hosts.Get (1), udpFactory);
+  rxSocket->Bind (InetSocketAddress (Ipv4Address::GetAny (), 9));
+  rxSocket->SetRecvCallback (
+    MakeCallback (&OFSwitch13MeterTestCase::ReceivePacket, this));
+  Ptr<Socket> txSocket = Socket::CreateSocket (hosts.Get (0), udpFactory);
+  txSocket->Connect (InetSocketAddress (hostIpIfaces.GetAddress (1), 9));
+
+  Simulator::Schedule (Seconds (1), &OFSwitch13MeterTestCase::SendPacket,
+                       this, txSocket);
+  Simulator::Stop (m_stop);
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  double expected = std::min (m_bandRate.GetBitRate (), m_offered.GetBitRate ());
+  double measured = static_cast<double> (m_received) * m_frameSize * 8
+    / (m_stop - m_start).GetSeconds ();
+  NS_TEST_EXPECT_MSG_EQ_TOL (measured, expected, expected * 0.02,
+                             "Unexpected rate passed by the meter.");
+}
+
+void
+OFSwitch13MeterTestCase::SendPacket (Ptr<Socket> socket)
+{
+  socket->Send (Create<Packet> (m_payload));
+  Simulator::Schedule (m_interval, &OFSwitch13MeterTestCase::SendPacket,
+                       this, socket);
+}
+
+void
+OFSwitch13MeterTestCase::ReceivePacket (Ptr<Socket> socket)
+{
+  while (socket->Recv ())
+    {
+      if (Simulator::Now () >= m_start)
+        {
+          m_received++;
+        }
+    }
+}
+
+/**
+ * TestSuite for the meter bands.
+ */
+class OFSwitch13MeterTestSuite : public TestSuite
+{
+public:
+  OFSwitch13MeterTestSuite ();
+};
+
+OFSwitch13MeterTestSuite::OFSwitch13MeterTestSuite ()
+  : TestSuite ("ofswitch13-meter", UNIT)
+{
+  // Traffic above the band rate is limited to it, and traffic below it
+  // passes unchanged.
+  AddTestCase (new OFSwitch13MeterTestCase (DataRate ("10Mbps"),
+                                            DataRate ("20Mbps")),
+               TestCase::QUICK);
+  AddTestCase (new OFSwitch13MeterTestCase (DataRate ("10Mbps"),
+                                            DataRate ("40Mbps")),
+               TestCase::QUICK);
+  AddTestCase (new OFSwitch13MeterTestCase (DataRate ("10Mbps"),
+                                            DataRate ("5Mbps")),
+               TestCase::QUICK);
+}
+
+static OFSwitch13MeterTestSuite g_ofswitch13MeterTestSuite;
@@ -0,0 +1,170 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2019 University of Campinas (Unicamp)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Luciano Chaves <luciano@lrc.ic.unicamp.br>
+ */
+
+#include <algorithm>
+#include <vector>
+#include <ns3/core-module.h>
+#include <ns3/ofswitch13-module.h>
+#include <ns3/test.h>
+
+using namespace ns3;
+
+/**
+ * Check the flow entries returned by the timing wheel against their
+ * deadlines. Entries are scheduled with random deadlines spread over all
+ * wheel levels (some beyond the wheel range, and some already in the past),
+ * while the wheel is advanced in random steps. Some entries are cancelled,
+ * and others are rescheduled. Each live entry must be returned exactly once,
+ * by the first advance reaching its deadline, and cancelled entries must
+ * never be returned. The wheel never dereferences the entries, so fake entry
+ * pointers are used.
+ */
+class OFSwitch13TimerWheelTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor.
+   * \param maxDelay The maximum distance to the deadlines (in milliseconds).
+   */
+  OFSwitch13TimerWheelTestCase (uint64_t maxDelay);
+
+private:
+  virtual void DoRun (void);
+
+  uint64_t m_maxDelay;  //!< Maximum distance to the deadlines.
+};
+
+OFSwitch13TimerWheelTestCase::OFSwitch13TimerWheelTestCase (uint64_t maxDelay)
+  : TestCase ("Timing wheel with deadlines up to " +
+              std::to_string (maxDelay) + "ms ahead"),
+  m_maxDelay (maxDelay)
+{
+}
+
+void
+OFSwitch13TimerWheelTestCase::DoRun (void)
+{
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  rng->SetStream (1);
+
+  // Deadlines of the entries in the wheel (0 for entries not in the wheel).
+  const uint32_t nEntries = 5000;
+  std::vector<uint64_t> deadlines (nEntries, 0);
+  std::vector<struct flow_entry> entries (nEntries);
+  struct flow_entry *base = &entries [0];
+
+  OFSwitch13TimerWheel wheel;
+  OFSwitch13TimerWheel::EntryList_t expired;
+  uint64_t now = 1000;
+  wheel.Advance (now, expired);
+  uint32_t live = 0;
+  uint32_t returned = 0;
+  for (uint32_t round = 0; round < 2000; round++)
+    {
+      // Schedule, reschedule or cancel some random entries.
+      for (uint32_t k = 0; k < 20; k++)
+        {
+          uint32_t i = rng->GetInteger (0, nEntries - 1);
+          if (deadlines [i] && rng->GetInteger (0, 3) == 0)
+            {
+              wheel.Cancel (base + i);
+              deadlines [i] = 0;
+              live--;
+              continue;
+            }
+
+          // A few deadlines are already in the past, and are due on the next
+          // advance.
+          uint64_t deadline = now + 1 + static_cast<uint64_t> (
+              rng->GetValue (0, 1) * rng->GetValue (0, 1) * m_maxDelay);
+          if (rng->GetInteger (0, 19) == 0)
+            {
+              deadline = now - rng->GetInteger (0, 10);
+            }
+          wheel.Schedule (base + i, deadline);
+          if (!deadlines [i])
+            {
+              live++;
+            }
+          deadlines [i] = std::max (deadline, now + 1);
+        }
+      NS_TEST_ASSERT_MSG_EQ (wheel.GetNEntries (), live,
+                             "Wrong number of entries in the wheel.");
+
+      // Advance the wheel, usually by a few milliseconds, sometimes by a
+      // large step (the advance cost grows with the elapsed time, so large
+      // steps are bounded).
+      uint64_t step = rng->GetInteger (0, 9) ? rng->GetInteger (1, 300) :
+        rng->GetInteger (1, std::min<uint64_t> (m_maxDelay / 4, 1 << 24));
+      now += step;
+      expired.clear ();
+      wheel.Advance (now, expired);
+      for (auto const &entry : expired)
+        {
+          uint32_t i = entry - base;
+          NS_TEST_ASSERT_MSG_NE (deadlines [i], 0,
+                                 "Entry " << i << " returned while not in "
+                                 "the wheel.");
+          NS_TEST_ASSERT_MSG_GT (deadlines [i], now - step,
+                                 "Entry " << i << " returned too late.");
+          NS_TEST_ASSERT_MSG_LT (deadlines [i], now + 1,
+                                 "Entry " << i << " returned too early.");
+          deadlines [i] = 0;
+          live--;
+          returned++;
+        }
+      for (uint32_t i = 0; i < nEntries; i++)
+        {
+          NS_TEST_ASSERT_MSG_EQ ((deadlines [i] && deadlines [i] <= now), false,
+                                 "Entry " << i << " not returned.");
+        }
+      NS_TEST_ASSERT_MSG_EQ (wheel.GetNEntries (), live,
+                             "Wrong number of entries in the wheel.");
+    }
+  NS_TEST_EXPECT_MSG_GT (returned, 0, "No entries returned.");
+
+  // Clearing the wheel drops all entries.
+  wheel.Clear (now);
+  NS_TEST_ASSERT_MSG_EQ (wheel.GetNEntries (), 0, "Wheel not cleared.");
+  expired.clear ();
+  wheel.Advance (now + 2 * m_maxDelay, expired);
+  NS_TEST_EXPECT_MSG_EQ (expired.size (), 0, "Entries returned after clear.");
+}
+
+/**
+ * TestSuite for the flow entry timing wheel.
+ */
+class OFSwitch13TimerWheelTestSuite : public TestSuite
+{
+public:
+  OFSwitch13TimerWheelTestSuite ();
+};
+
+OFSwitch13TimerWheelTestSuite::OFSwitch13TimerWheelTestSuite ()
+  : TestSuite ("ofswitch13-timer-wheel", UNIT)
+{
+  // Deadlines within the first levels, and across all levels (some of them
+  // beyond the 2^32 ms wheel range).
+  AddTestCase (new OFSwitch13TimerWheelTestCase (60000), TestCase::QUICK);
+  AddTestCase (new OFSwitch13TimerWheelTestCase (8000000000ULL),
+               TestCase::QUICK);
+}
+
+static OFSwitch13TimerWheelTestSuite g_ofswitch13TimerWheelTestSuite;